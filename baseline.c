@@ -2,6 +2,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "trmm_layout.h"
+
 #ifndef COMPUTE_OP
 #define COMPUTE_OP baseline
 #endif
@@ -22,13 +24,25 @@
 #define FREE_MEMORY baseline_free
 #endif
 
+#ifndef TRMM_OP
+#define TRMM_OP baseline_trmm
+#endif
+
+#ifndef STRIDED_OP
+#define STRIDED_OP baseline_strided
+#endif
+
+#ifndef INPLACE_OP
+#define INPLACE_OP baseline_inplace
+#endif
+
 /*
 This operation focuses on Lower Triangular Matrix Multiplication
 The operation is C = A * B
 where A is a Lower Triangular Matrix
       B is a Matrix
       C is the result of the operation
-A is a m0 x n0 matrix
+A is a m0 x m0 matrix
 B is a m0 x n0 matrix
 C is a m0 x n0 matrix
 
@@ -39,24 +53,23 @@ void COMPUTE_OP(int m0, int n0, float *A, float *B, float *C) {
   int root_id = 0;
   int num_ranks;
   int rid;
-  MPI_Status status;
-  int tag = 0;
   // query the number of ranks from MPI using the default communicator
-  num_ranks = MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
+  MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
   // query the rank of the current process
-  rid = MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
 
   if (rid == root_id) {
     // Matrices Row and Column Strides
     // Matrices are stored in Row Major Order
-    int rs_A = m0;
-    int CS_A = 1;
+    // (size_t, so that the offsets do not overflow past 2^31 elements)
+    size_t rs_A = m0;
+    size_t CS_A = 1;
 
-    int rs_B = m0;
-    int CS_B = 1;
+    size_t rs_B = n0;
+    size_t CS_B = 1;
 
-    int rs_C = m0;
-    int CS_C = 1;
+    size_t rs_C = n0;
+    size_t CS_C = 1;
 
     float result;
     // Lower Triangular Matrix Multiplication algorithm
@@ -64,9 +77,11 @@ void COMPUTE_OP(int m0, int n0, float *A, float *B, float *C) {
       for (int j0 = 0; j0 < n0; j0++) {
         result = 0.0f;
         for (int k0 = 0; k0 < m0; k0++) {
-          if (k0 <= i0) result += A[i0 * rs_A + k0] * B[k0 * rs_B + j0];
+          if (k0 <= i0) {
+            result += A[i0 * rs_A + k0 * CS_A] * B[k0 * rs_B + j0 * CS_B];
+          }
         }
-        C[i0 * rs_C + j0] = result;
+        C[i0 * rs_C + j0 * CS_C] = result;
       }
     }
   }
@@ -77,52 +92,55 @@ void DISTRIBUTE_ALLOCATION(int m0, int n0, float **A_dist, float **B_dist,
   int root_id = 0;
   int num_ranks;
   int rid;
-  MPI_Status status;
-  int tag = 0;
   // query the number of ranks from MPI using the default communicator
-  num_ranks = MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
+  MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
   // query the rank of the current process
-  rid = MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
 
   if (rid == root_id) {
     // Allocate memory for the matrices
-    *A_dist = (float *)malloc(m0 * m0 * sizeof(float));
-    *B_dist = (float *)malloc(m0 * n0 * sizeof(float));
-    *C_dist = (float *)malloc(m0 * n0 * sizeof(float));
-    // Check if memory allocation was successful
-    if (*A_dist == NULL || *B_dist == NULL || *C_dist == NULL) {
-      printf("Memory allocation failed\n");
-      exit(1);
-    }
+    *A_dist = (float *)malloc((size_t)m0 * m0 * sizeof(float));
+    *B_dist = (float *)malloc((size_t)m0 * n0 * sizeof(float));
+    *C_dist = (float *)malloc((size_t)m0 * n0 * sizeof(float));
+  } else {
+    // Only the root holds data, the other ranks get placeholders
+    *A_dist = (float *)malloc(sizeof(float));
+    *B_dist = (float *)malloc(sizeof(float));
+    *C_dist = (float *)malloc(sizeof(float));
+  }
+  // Check if memory allocation was successful
+  if (*A_dist == NULL || *B_dist == NULL || *C_dist == NULL) {
+    printf("Memory allocation failed\n");
+    exit(1);
   }
 }
 
 void DISTRIBUTE_DATA(int m0, int n0, float *A_seq, float *B_seq, float *C_seq,
                      float *A_dist, float *B_dist, float *C_dist) {
+  // C is not an input: COMPUTE_OP overwrites it
+  (void)C_seq;
+  (void)C_dist;
+
   int root_id = 0;
   int num_ranks;
   int rid;
-  MPI_Status status;
-  int tag = 0;
   // query the number of ranks from MPI using the default communicator
-  num_ranks = MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
+  MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
   // query the rank of the current process
-  rid = MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
 
   // Matrices Row and Column Strides
-  int rs_A = m0;
-  int CS_A = 1;
-
-  int rs_B = m0;
-  int CS_B = 1;
+  size_t rs_A = m0;
+  size_t CS_A = 1;
 
-  int rs_C = m0;
-  int CS_C = 1;
+  size_t rs_B = n0;
+  size_t CS_B = 1;
 
   if (rid == root_id) {
     // Copy the data from the sequential matrices to the distributed matrices
+    // (C is overwritten by COMPUTE_OP, so it is not copied)
     for (int i0 = 0; i0 < m0; i0++) {
-      for (int j0 = 0; j0 < n0; j0++) {
+      for (int j0 = 0; j0 < m0; j0++) {
         A_dist[i0 * rs_A + j0 * CS_A] = A_seq[i0 * rs_A + j0 * CS_A];
       }
     }
@@ -132,12 +150,6 @@ void DISTRIBUTE_DATA(int m0, int n0, float *A_seq, float *B_seq, float *C_seq,
         B_dist[i0 * rs_B + j0 * CS_B] = B_seq[i0 * rs_B + j0 * CS_B];
       }
     }
-
-    for (int i0 = 0; i0 < m0; i0++) {
-      for (int j0 = 0; j0 < n0; j0++) {
-        C_dist[i0 * rs_C + j0 * CS_C] = C_seq[i0 * rs_C + j0 * CS_C];
-      }
-    }
   }
 }
 
@@ -145,38 +157,148 @@ void COLLECTION(int m0, int n0, float *C_seq, float *C_dist) {
   int root_id = 0;
   int num_ranks;
   int rid;
-  MPI_Status status;
-  int tag = 0;
   // query the number of ranks from MPI using the default communicator
-  num_ranks = MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
+  MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
   // query the rank of the current process
-  rid = MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
 
   if (rid == root_id) {
     // Copy the data from the distributed matrix to the sequential matrix
     for (int i0 = 0; i0 < m0; i0++) {
       for (int j0 = 0; j0 < n0; j0++) {
-        C_seq[i0 * m0 + j0] = C_dist[i0 * m0 + j0];
+        C_seq[(size_t)i0 * n0 + j0] = C_dist[(size_t)i0 * n0 + j0];
       }
     }
   }
 }
 
 void FREE_MEMORY(float *A_dist, float *B_dist, float *C_dist) {
+  // Free the memory allocated for the matrices (placeholders off the root)
+  free(A_dist);
+  free(B_dist);
+  free(C_dist);
+}
+
+/*
+Reference for the BLAS-style multiply (see trmm_blas.h for the parameters)
+
+side 0: C = alpha * op(A) * B with A m0 x m0
+side 1: C = alpha * B * op(A) with A n0 x n0
+uplo 0/1: A lower/upper, trans 0/1: op(A) = A / A^T, diag 1: unit diagonal
+layout and leading dimensions as in trmm_layout.h
+
+Computed on the root only, element by element.
+*/
+void TRMM_OP(int layout, int side, int uplo, int trans, int diag, int m0,
+             int n0, float alpha, float *A, int lda, float *B, int ldb,
+             float *C, int ldc) {
   int root_id = 0;
-  int num_ranks;
   int rid;
-  MPI_Status status;
-  int tag = 0;
-  // query the number of ranks from MPI using the default communicator
-  num_ranks = MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
   // query the rank of the current process
-  rid = MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
 
   if (rid == root_id) {
-    // Free the memory allocated for the matrices
-    free(A_dist);
-    free(B_dist);
-    free(C_dist);
+    // Matrices Row and Column Strides
+    size_t rs_A, cs_A, rs_B, cs_B, rs_C, cs_C;
+    trmm_layout_strides(layout, lda, &rs_A, &cs_A);
+    trmm_layout_strides(layout, ldb, &rs_B, &cs_B);
+    trmm_layout_strides(layout, ldc, &rs_C, &cs_C);
+    int k_dim = side == 0 ? m0 : n0;
+
+    for (int i0 = 0; i0 < m0; i0++) {
+      for (int j0 = 0; j0 < n0; j0++) {
+        float result = 0.0f;
+        for (int k0 = 0; k0 < k_dim; k0++) {
+          // element (row, col) of op(A) for this term
+          int row = side == 0 ? i0 : k0;
+          int col = side == 0 ? k0 : j0;
+          int a_row = trans ? col : row;
+          int a_col = trans ? row : col;
+          float a;
+          if (uplo == 0 ? a_col > a_row : a_col < a_row) {
+            a = 0.0f;
+          } else if (a_row == a_col && diag) {
+            a = 1.0f;
+          } else {
+            a = A[a_row * rs_A + a_col * cs_A];
+          }
+          float b = side == 0 ? B[k0 * rs_B + j0 * cs_B]
+                              : B[i0 * rs_B + k0 * cs_B];
+          result += a * b;
+        }
+        C[i0 * rs_C + j0 * cs_C] = alpha * result;
+      }
+    }
   }
-}
\ No newline at end of file
+}
+
+/*
+Reference for C = A * B on the caller's matrices, with the layout and
+leading dimensions of trmm_layout.h. Computed on the root only.
+*/
+void STRIDED_OP(int layout, int m0, int n0, float *A, int lda, float *B,
+                int ldb, float *C, int ldc) {
+  int root_id = 0;
+  int rid;
+  // query the rank of the current process
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+
+  if (rid == root_id) {
+    // Matrices Row and Column Strides
+    size_t rs_A, cs_A, rs_B, cs_B, rs_C, cs_C;
+    trmm_layout_strides(layout, lda, &rs_A, &cs_A);
+    trmm_layout_strides(layout, ldb, &rs_B, &cs_B);
+    trmm_layout_strides(layout, ldc, &rs_C, &cs_C);
+
+    for (int i0 = 0; i0 < m0; i0++) {
+      for (int j0 = 0; j0 < n0; j0++) {
+        float result = 0.0f;
+        for (int k0 = 0; k0 <= i0; k0++) {
+          result += A[i0 * rs_A + k0 * cs_A] * B[k0 * rs_B + j0 * cs_B];
+        }
+        C[i0 * rs_C + j0 * cs_C] = result;
+      }
+    }
+  }
+}
+
+/*
+Reference for B := A * B (layout and leading dimensions as in
+trmm_layout.h). Computed on the root only, through a copy of B.
+*/
+void INPLACE_OP(int layout, int m0, int n0, float *A, int lda, float *B,
+                int ldb) {
+  int root_id = 0;
+  int rid;
+  // query the rank of the current process
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+
+  if (rid == root_id) {
+    // Matrices Row and Column Strides
+    size_t rs_A, cs_A, rs_B, cs_B;
+    trmm_layout_strides(layout, lda, &rs_A, &cs_A);
+    trmm_layout_strides(layout, ldb, &rs_B, &cs_B);
+
+    float *B_copy = (float *)malloc((size_t)m0 * n0 * sizeof(float));
+    if (B_copy == NULL) {
+      printf("Memory allocation failed\n");
+      exit(1);
+    }
+    for (int i0 = 0; i0 < m0; i0++) {
+      for (int j0 = 0; j0 < n0; j0++) {
+        B_copy[(size_t)i0 * n0 + j0] = B[i0 * rs_B + j0 * cs_B];
+      }
+    }
+
+    for (int i0 = 0; i0 < m0; i0++) {
+      for (int j0 = 0; j0 < n0; j0++) {
+        float result = 0.0f;
+        for (int k0 = 0; k0 <= i0; k0++) {
+          result += A[i0 * rs_A + k0 * cs_A] * B_copy[(size_t)k0 * n0 + j0];
+        }
+        B[i0 * rs_B + j0 * cs_B] = result;
+      }
+    }
+    free(B_copy);
+  }
+}
@@ -8,6 +8,15 @@ echo $BASELINE_VARIANT
 echo $VARIANT_1
 echo $VARIANT_2
 echo $VARIANT_3
+echo $VARIANT_4
+echo $VARIANT_5
+echo $VARIANT_6
+echo $VARIANT_7
+echo $VARIANT_8
+echo $VARIANT_9
+echo $VARIANT_10
+echo $VARIANT_11
+echo $ARENA
 echo $CC
 echo $CFLAGS
 
@@ -21,21 +30,39 @@ COMPUTE_NAME_TST="test"
 DISTRIBUTED_ALLOCATE_NAME_TST="test_allocate"
 DISTRIBUTED_FREE_NAME_TST="test_free"
 DISTRIBUTED_DATA_NAME_TST="test_dist"
+DISTRIBUTE_PACKED_NAME_TST="test_dist_packed"
 COLLECT_DATA_NAME_TST="test_collect_data"
+REPORT_STATS_NAME_TST="test_report_stats"
+BATCH_NAME_TST="test_batch"
+TRMM_NAME_TST="test_trmm"
+STRIDED_NAME_TST="test_strided"
+INPLACE_NAME_TST="test_inplace"
+INPUT_EPSILON_NAME_TST="test_input_epsilon"
+IO_BYTES_NAME_TST="test_io_bytes"
+DISTRIBUTE_FILE_NAME_TST="test_distribute_file"
+COLLECTION_FILE_NAME_TST="test_collect_file"
 
 TEST_RIG="timer_op.c"
 
 #BUILD VERIFICATION TEST
-${CC} -std=c99 -c \
+${CC} ${CFLAGS} -c \
     -DCOMPUTE_OP_TEST=${COMPUTE_NAME_TST} \
     -DDISTRIBUTE_ALLOCATION_TEST=${DISTRIBUTED_ALLOCATE_NAME_TST} \
     -DDISTRIBUTE_DATA_TEST=${DISTRIBUTED_DATA_NAME_TST} \
+    -DDISTRIBUTE_PACKED_TEST=${DISTRIBUTE_PACKED_NAME_TST} \
     -DCOLLECTION_TEST=${COLLECT_DATA_NAME_TST} \
     -DFREE_MEMORY_TEST=${DISTRIBUTED_FREE_NAME_TST} \
+    -DREPORT_STATS_TEST=${REPORT_STATS_NAME_TST} \
+    -DBATCH_OP_TEST=${BATCH_NAME_TST} \
+    -DIO_BYTES_TEST=${IO_BYTES_NAME_TST} \
+    -DTRMM_BUILD_CC="\"${CC}\"" \
+    -DTRMM_BUILD_CFLAGS="\"${CFLAGS}\"" \
+    -DDISTRIBUTE_FILE_TEST=${DISTRIBUTE_FILE_NAME_TST} \
+    -DCOLLECTION_FILE_TEST=${COLLECTION_FILE_NAME_TST} \
     ${TEST_RIG} -o ${TEST_RIG}.o
 
 # #BUILD REFERENCE BASELINE 
-# ${CC} -std=c99 -c\
+# ${CC} ${CFLAGS} -c\
 #     -DCOMPUTE_OP=${COMPUTE_NAME_REF} \
 #     -DDISTRIBUTE_ALLOCATION=${DISTRIBUTED_ALLOCATE_NAME_REF} \
 #     -DFREE_MEMORY=${DISTRIBUTED_FREE_NAME_REF} \
@@ -44,37 +71,229 @@ ${CC} -std=c99 -c \
 #     ${BASELINE_VARIANT} -o ${BASELINE_VARIANT}.ref.o
 
 
+#BUILD ARENA ALLOCATOR
+${CC} ${CFLAGS} -c ${ARENA} -o ${ARENA}.o
+
 #BUILD VARIANT 1
-${CC} -std=c99 -c\
+${CC} ${CFLAGS} -c\
     -DCOMPUTE_OP=${COMPUTE_NAME_TST} \
     -DDISTRIBUTE_ALLOCATION=${DISTRIBUTED_ALLOCATE_NAME_TST} \
     -DFREE_MEMORY=${DISTRIBUTED_FREE_NAME_TST} \
     -DDISTRIBUTE_DATA=${DISTRIBUTED_DATA_NAME_TST} \
+    -DDISTRIBUTE_PACKED=${DISTRIBUTE_PACKED_NAME_TST} \
     -DCOLLECTION=${COLLECT_DATA_NAME_TST} \
+    -DREPORT_STATS=${REPORT_STATS_NAME_TST} \
+    -DBATCH_OP=${BATCH_NAME_TST} \
+    -DTRMM_OP=${TRMM_NAME_TST} \
+    -DSTRIDED_OP=${STRIDED_NAME_TST} \
+    -DINPLACE_OP=${INPLACE_NAME_TST} \
+    -DINPUT_EPSILON=${INPUT_EPSILON_NAME_TST} \
+    -DIO_BYTES=${IO_BYTES_NAME_TST} \
+    -DDISTRIBUTE_FILE=${DISTRIBUTE_FILE_NAME_TST} \
+    -DCOLLECTION_FILE=${COLLECTION_FILE_NAME_TST} \
     ${VARIANT_1} -o ${VARIANT_1}.o
 
 #BUILD VARIANT 2
-${CC} -std=c99 -c\
+${CC} ${CFLAGS} -c\
     -DCOMPUTE_OP=${COMPUTE_NAME_TST} \
     -DDISTRIBUTE_ALLOCATION=${DISTRIBUTED_ALLOCATE_NAME_TST} \
     -DFREE_MEMORY=${DISTRIBUTED_FREE_NAME_TST} \
     -DDISTRIBUTE_DATA=${DISTRIBUTED_DATA_NAME_TST} \
+    -DDISTRIBUTE_PACKED=${DISTRIBUTE_PACKED_NAME_TST} \
     -DCOLLECTION=${COLLECT_DATA_NAME_TST} \
+    -DREPORT_STATS=${REPORT_STATS_NAME_TST} \
+    -DBATCH_OP=${BATCH_NAME_TST} \
+    -DTRMM_OP=${TRMM_NAME_TST} \
+    -DSTRIDED_OP=${STRIDED_NAME_TST} \
+    -DINPLACE_OP=${INPLACE_NAME_TST} \
+    -DINPUT_EPSILON=${INPUT_EPSILON_NAME_TST} \
+    -DIO_BYTES=${IO_BYTES_NAME_TST} \
+    -DDISTRIBUTE_FILE=${DISTRIBUTE_FILE_NAME_TST} \
+    -DCOLLECTION_FILE=${COLLECTION_FILE_NAME_TST} \
     ${VARIANT_2} -o ${VARIANT_2}.o
 
 #BUILD VARIANT 3
-${CC} -std=c99 -c\
+${CC} ${CFLAGS} -c\
     -DCOMPUTE_OP=${COMPUTE_NAME_TST} \
     -DDISTRIBUTE_ALLOCATION=${DISTRIBUTED_ALLOCATE_NAME_TST} \
     -DFREE_MEMORY=${DISTRIBUTED_FREE_NAME_TST} \
     -DDISTRIBUTE_DATA=${DISTRIBUTED_DATA_NAME_TST} \
+    -DDISTRIBUTE_PACKED=${DISTRIBUTE_PACKED_NAME_TST} \
     -DCOLLECTION=${COLLECT_DATA_NAME_TST} \
+    -DREPORT_STATS=${REPORT_STATS_NAME_TST} \
+    -DBATCH_OP=${BATCH_NAME_TST} \
+    -DTRMM_OP=${TRMM_NAME_TST} \
+    -DSTRIDED_OP=${STRIDED_NAME_TST} \
+    -DINPLACE_OP=${INPLACE_NAME_TST} \
+    -DINPUT_EPSILON=${INPUT_EPSILON_NAME_TST} \
+    -DIO_BYTES=${IO_BYTES_NAME_TST} \
+    -DDISTRIBUTE_FILE=${DISTRIBUTE_FILE_NAME_TST} \
+    -DCOLLECTION_FILE=${COLLECTION_FILE_NAME_TST} \
     ${VARIANT_3} -o ${VARIANT_3}.o
 
+#BUILD VARIANT 4
+${CC} ${CFLAGS} -c\
+    -DCOMPUTE_OP=${COMPUTE_NAME_TST} \
+    -DDISTRIBUTE_ALLOCATION=${DISTRIBUTED_ALLOCATE_NAME_TST} \
+    -DFREE_MEMORY=${DISTRIBUTED_FREE_NAME_TST} \
+    -DDISTRIBUTE_DATA=${DISTRIBUTED_DATA_NAME_TST} \
+    -DDISTRIBUTE_PACKED=${DISTRIBUTE_PACKED_NAME_TST} \
+    -DCOLLECTION=${COLLECT_DATA_NAME_TST} \
+    -DREPORT_STATS=${REPORT_STATS_NAME_TST} \
+    -DBATCH_OP=${BATCH_NAME_TST} \
+    -DTRMM_OP=${TRMM_NAME_TST} \
+    -DSTRIDED_OP=${STRIDED_NAME_TST} \
+    -DINPLACE_OP=${INPLACE_NAME_TST} \
+    -DINPUT_EPSILON=${INPUT_EPSILON_NAME_TST} \
+    -DIO_BYTES=${IO_BYTES_NAME_TST} \
+    -DDISTRIBUTE_FILE=${DISTRIBUTE_FILE_NAME_TST} \
+    -DCOLLECTION_FILE=${COLLECTION_FILE_NAME_TST} \
+    ${VARIANT_4} -o ${VARIANT_4}.o
+
+#BUILD VARIANT 5
+${CC} ${CFLAGS} -c\
+    -DCOMPUTE_OP=${COMPUTE_NAME_TST} \
+    -DDISTRIBUTE_ALLOCATION=${DISTRIBUTED_ALLOCATE_NAME_TST} \
+    -DFREE_MEMORY=${DISTRIBUTED_FREE_NAME_TST} \
+    -DDISTRIBUTE_DATA=${DISTRIBUTED_DATA_NAME_TST} \
+    -DDISTRIBUTE_PACKED=${DISTRIBUTE_PACKED_NAME_TST} \
+    -DCOLLECTION=${COLLECT_DATA_NAME_TST} \
+    -DREPORT_STATS=${REPORT_STATS_NAME_TST} \
+    -DBATCH_OP=${BATCH_NAME_TST} \
+    -DTRMM_OP=${TRMM_NAME_TST} \
+    -DSTRIDED_OP=${STRIDED_NAME_TST} \
+    -DINPLACE_OP=${INPLACE_NAME_TST} \
+    -DINPUT_EPSILON=${INPUT_EPSILON_NAME_TST} \
+    -DIO_BYTES=${IO_BYTES_NAME_TST} \
+    -DDISTRIBUTE_FILE=${DISTRIBUTE_FILE_NAME_TST} \
+    -DCOLLECTION_FILE=${COLLECTION_FILE_NAME_TST} \
+    ${VARIANT_5} -o ${VARIANT_5}.o
+
+#BUILD VARIANT 6
+${CC} ${CFLAGS} -c\
+    -DCOMPUTE_OP=${COMPUTE_NAME_TST} \
+    -DDISTRIBUTE_ALLOCATION=${DISTRIBUTED_ALLOCATE_NAME_TST} \
+    -DFREE_MEMORY=${DISTRIBUTED_FREE_NAME_TST} \
+    -DDISTRIBUTE_DATA=${DISTRIBUTED_DATA_NAME_TST} \
+    -DCOLLECTION=${COLLECT_DATA_NAME_TST} \
+    -DREPORT_STATS=${REPORT_STATS_NAME_TST} \
+    -DBATCH_OP=${BATCH_NAME_TST} \
+    -DTRMM_OP=${TRMM_NAME_TST} \
+    -DSTRIDED_OP=${STRIDED_NAME_TST} \
+    -DINPLACE_OP=${INPLACE_NAME_TST} \
+    -DINPUT_EPSILON=${INPUT_EPSILON_NAME_TST} \
+    -DIO_BYTES=${IO_BYTES_NAME_TST} \
+    -DDISTRIBUTE_FILE=${DISTRIBUTE_FILE_NAME_TST} \
+    -DCOLLECTION_FILE=${COLLECTION_FILE_NAME_TST} \
+    ${VARIANT_6} -o ${VARIANT_6}.o
+
+#BUILD VARIANT 7
+${CC} ${CFLAGS} -c\
+    -DCOMPUTE_OP=${COMPUTE_NAME_TST} \
+    -DDISTRIBUTE_ALLOCATION=${DISTRIBUTED_ALLOCATE_NAME_TST} \
+    -DFREE_MEMORY=${DISTRIBUTED_FREE_NAME_TST} \
+    -DDISTRIBUTE_DATA=${DISTRIBUTED_DATA_NAME_TST} \
+    -DDISTRIBUTE_PACKED=${DISTRIBUTE_PACKED_NAME_TST} \
+    -DCOLLECTION=${COLLECT_DATA_NAME_TST} \
+    -DREPORT_STATS=${REPORT_STATS_NAME_TST} \
+    -DBATCH_OP=${BATCH_NAME_TST} \
+    -DTRMM_OP=${TRMM_NAME_TST} \
+    -DSTRIDED_OP=${STRIDED_NAME_TST} \
+    -DINPLACE_OP=${INPLACE_NAME_TST} \
+    -DINPUT_EPSILON=${INPUT_EPSILON_NAME_TST} \
+    -DIO_BYTES=${IO_BYTES_NAME_TST} \
+    -DDISTRIBUTE_FILE=${DISTRIBUTE_FILE_NAME_TST} \
+    -DCOLLECTION_FILE=${COLLECTION_FILE_NAME_TST} \
+    ${VARIANT_7} -o ${VARIANT_7}.o
+
+#BUILD VARIANT 8
+${CC} ${CFLAGS} -c\
+    -DCOMPUTE_OP=${COMPUTE_NAME_TST} \
+    -DDISTRIBUTE_ALLOCATION=${DISTRIBUTED_ALLOCATE_NAME_TST} \
+    -DFREE_MEMORY=${DISTRIBUTED_FREE_NAME_TST} \
+    -DDISTRIBUTE_DATA=${DISTRIBUTED_DATA_NAME_TST} \
+    -DDISTRIBUTE_PACKED=${DISTRIBUTE_PACKED_NAME_TST} \
+    -DCOLLECTION=${COLLECT_DATA_NAME_TST} \
+    -DREPORT_STATS=${REPORT_STATS_NAME_TST} \
+    -DBATCH_OP=${BATCH_NAME_TST} \
+    -DTRMM_OP=${TRMM_NAME_TST} \
+    -DSTRIDED_OP=${STRIDED_NAME_TST} \
+    -DINPLACE_OP=${INPLACE_NAME_TST} \
+    -DINPUT_EPSILON=${INPUT_EPSILON_NAME_TST} \
+    -DIO_BYTES=${IO_BYTES_NAME_TST} \
+    -DDISTRIBUTE_FILE=${DISTRIBUTE_FILE_NAME_TST} \
+    -DCOLLECTION_FILE=${COLLECTION_FILE_NAME_TST} \
+    ${VARIANT_8} -o ${VARIANT_8}.o
+
+#BUILD VARIANT 9
+${CC} ${CFLAGS} -c\
+    -DCOMPUTE_OP=${COMPUTE_NAME_TST} \
+    -DDISTRIBUTE_ALLOCATION=${DISTRIBUTED_ALLOCATE_NAME_TST} \
+    -DFREE_MEMORY=${DISTRIBUTED_FREE_NAME_TST} \
+    -DDISTRIBUTE_DATA=${DISTRIBUTED_DATA_NAME_TST} \
+    -DDISTRIBUTE_PACKED=${DISTRIBUTE_PACKED_NAME_TST} \
+    -DCOLLECTION=${COLLECT_DATA_NAME_TST} \
+    -DREPORT_STATS=${REPORT_STATS_NAME_TST} \
+    -DBATCH_OP=${BATCH_NAME_TST} \
+    -DTRMM_OP=${TRMM_NAME_TST} \
+    -DSTRIDED_OP=${STRIDED_NAME_TST} \
+    -DINPLACE_OP=${INPLACE_NAME_TST} \
+    -DINPUT_EPSILON=${INPUT_EPSILON_NAME_TST} \
+    -DIO_BYTES=${IO_BYTES_NAME_TST} \
+    -DDISTRIBUTE_FILE=${DISTRIBUTE_FILE_NAME_TST} \
+    -DCOLLECTION_FILE=${COLLECTION_FILE_NAME_TST} \
+    ${VARIANT_9} -o ${VARIANT_9}.o
+
+#BUILD VARIANT 10
+${CC} ${CFLAGS} -c\
+    -DCOMPUTE_OP=${COMPUTE_NAME_TST} \
+    -DDISTRIBUTE_ALLOCATION=${DISTRIBUTED_ALLOCATE_NAME_TST} \
+    -DFREE_MEMORY=${DISTRIBUTED_FREE_NAME_TST} \
+    -DDISTRIBUTE_DATA=${DISTRIBUTED_DATA_NAME_TST} \
+    -DDISTRIBUTE_PACKED=${DISTRIBUTE_PACKED_NAME_TST} \
+    -DCOLLECTION=${COLLECT_DATA_NAME_TST} \
+    -DREPORT_STATS=${REPORT_STATS_NAME_TST} \
+    -DBATCH_OP=${BATCH_NAME_TST} \
+    -DTRMM_OP=${TRMM_NAME_TST} \
+    -DSTRIDED_OP=${STRIDED_NAME_TST} \
+    -DINPLACE_OP=${INPLACE_NAME_TST} \
+    -DINPUT_EPSILON=${INPUT_EPSILON_NAME_TST} \
+    -DIO_BYTES=${IO_BYTES_NAME_TST} \
+    -DDISTRIBUTE_FILE=${DISTRIBUTE_FILE_NAME_TST} \
+    -DCOLLECTION_FILE=${COLLECTION_FILE_NAME_TST} \
+    ${VARIANT_10} -o ${VARIANT_10}.o
+
+#BUILD VARIANT 11
+${CC} ${CFLAGS} -c\
+    -DCOMPUTE_OP=${COMPUTE_NAME_TST} \
+    -DDISTRIBUTE_ALLOCATION=${DISTRIBUTED_ALLOCATE_NAME_TST} \
+    -DFREE_MEMORY=${DISTRIBUTED_FREE_NAME_TST} \
+    -DDISTRIBUTE_DATA=${DISTRIBUTED_DATA_NAME_TST} \
+    -DDISTRIBUTE_PACKED=${DISTRIBUTE_PACKED_NAME_TST} \
+    -DCOLLECTION=${COLLECT_DATA_NAME_TST} \
+    -DREPORT_STATS=${REPORT_STATS_NAME_TST} \
+    -DBATCH_OP=${BATCH_NAME_TST} \
+    -DTRMM_OP=${TRMM_NAME_TST} \
+    -DSTRIDED_OP=${STRIDED_NAME_TST} \
+    -DINPLACE_OP=${INPLACE_NAME_TST} \
+    -DINPUT_EPSILON=${INPUT_EPSILON_NAME_TST} \
+    -DIO_BYTES=${IO_BYTES_NAME_TST} \
+    -DDISTRIBUTE_FILE=${DISTRIBUTE_FILE_NAME_TST} \
+    -DCOLLECTION_FILE=${COLLECTION_FILE_NAME_TST} \
+    ${VARIANT_11} -o ${VARIANT_11}.o
+
 #Build the test executables
-${CC} ${CFLAGS} ${TEST_RIG}.o  ${VARIANT_1}.o -o ./run_test_variant01.x
-${CC} ${CFLAGS} ${TEST_RIG}.o  ${VARIANT_2}.o -o ./run_test_variant02.x
-${CC} ${CFLAGS} ${TEST_RIG}.o  ${VARIANT_3}.o -o ./run_test_variant03.x
+${CC} ${CFLAGS} ${TEST_RIG}.o  ${VARIANT_1}.o ${ARENA}.o -o ./run_test_variant01.x ${LIBS}
+${CC} ${CFLAGS} ${TEST_RIG}.o  ${VARIANT_2}.o ${ARENA}.o -o ./run_test_variant02.x ${LIBS}
+${CC} ${CFLAGS} ${TEST_RIG}.o  ${VARIANT_3}.o ${ARENA}.o -o ./run_test_variant03.x ${LIBS}
+${CC} ${CFLAGS} ${TEST_RIG}.o  ${VARIANT_4}.o ${ARENA}.o -o ./run_test_variant04.x ${LIBS}
+${CC} ${CFLAGS} ${TEST_RIG}.o  ${VARIANT_5}.o ${ARENA}.o -o ./run_test_variant05.x ${LIBS}
+${CC} ${CFLAGS} ${TEST_RIG}.o  ${VARIANT_6}.o ${ARENA}.o -o ./run_test_variant06.x ${LIBS}
+${CC} ${CFLAGS} ${TEST_RIG}.o  ${VARIANT_7}.o ${ARENA}.o -o ./run_test_variant07.x ${LIBS}
+${CC} ${CFLAGS} ${TEST_RIG}.o  ${VARIANT_8}.o ${ARENA}.o -o ./run_test_variant08.x ${LIBS}
+${CC} ${CFLAGS} ${TEST_RIG}.o  ${VARIANT_9}.o ${ARENA}.o -o ./run_test_variant09.x ${LIBS}
+${CC} ${CFLAGS} ${TEST_RIG}.o  ${VARIANT_10}.o ${ARENA}.o -o ./run_test_variant10.x ${LIBS}
+${CC} ${CFLAGS} ${TEST_RIG}.o  ${VARIANT_11}.o ${ARENA}.o -o ./run_test_variant11.x ${LIBS}
 
 echo "Build Test: complete"
 
@@ -3,7 +3,21 @@ BASELINE_VARIANT="baseline.c"
 VARIANT_1="variant1.c"
 VARIANT_2="variant2.c"
 VARIANT_3="variant3.c"
+VARIANT_4="variant4.c"
+VARIANT_5="variant5.c"
+VARIANT_6="variant6.c"
+VARIANT_7="variant7.c"
+VARIANT_8="variant8.c"
+VARIANT_9="variant9.c"
+VARIANT_10="variant10.c"
+VARIANT_11="variant11.c"
+
+#Support code linked into every executable
+ARENA="trmm_arena.c"
 
 #Compiler flags
 CC=mpicc
-CFLAGS="-std=c99 -O2 -mfma -mavx2 -Wall -Wextra -g"
\ No newline at end of file
+CFLAGS="-std=c99 -O2 -mfma -mavx2 -mf16c -fopenmp -Wall -Wextra -g"
+
+#Libraries linked into every executable
+LIBS="-lm"
@@ -3,8 +3,28 @@
 #include <mpi.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include "timer.h"
+#include "trmm_arena.h"
+#include "trmm_io.h"
+#include "trmm_packed.h"
+#include "trmm_stats.h"
+
+// compiler and flags of the build, recorded in the JSON report
+#ifndef TRMM_BUILD_CC
+#define TRMM_BUILD_CC "unknown"
+#endif
+
+#ifndef TRMM_BUILD_CFLAGS
+#define TRMM_BUILD_CFLAGS "unknown"
+#endif
 
 // addition of external function interfaces to be used in test
 
@@ -18,21 +38,53 @@ extern void DISTRIBUTE_DATA_TEST(int m0, int n0, float *A_seq, float *B_seq,
                                  float *C_seq, float *A_dist, float *B_dist,
                                  float *C_dist);
 
+// optional: DISTRIBUTE_DATA with A_seq already in packed storage
+// (trmm_packed.h), so the root never holds a full m0 x m0 A (used instead of
+// DISTRIBUTE_DATA when defined)
+extern void DISTRIBUTE_PACKED_TEST(int m0, int n0, float *A_packed,
+                                   float *B_seq, float *C_seq, float *A_dist,
+                                   float *B_dist, float *C_dist)
+    __attribute__((weak));
+
 extern void COLLECTION_TEST(int m0, int n0, float *C_seq, float *C_dist);
 
 extern void FREE_MEMORY_TEST(float *A_dist, float *B_dist, float *C_dist);
 
+// optional: variants that define it print their own statistics (collective,
+// called once per size after timing)
+extern void REPORT_STATS_TEST(int m0, int n0) __attribute__((weak));
+
+// optional: batched entry point, count m0 x n0 problems back to back on the
+// root (timed instead of COMPUTE_OP when TRMM_BATCH is set)
+extern void BATCH_OP_TEST(int count, int m0, int n0, float *A, float *B,
+                          float *C) __attribute__((weak));
+
+// optional: inputs straight from matrix files (trmm_io.h): every rank reads
+// its own slices of A (packed) and B and writes its slice of C (used instead
+// of DISTRIBUTE_DATA and COLLECTION when TRMM_IO_DIR is set)
+extern void DISTRIBUTE_FILE_TEST(int m0, int n0, const char *A_path,
+                                 const char *B_path, float *A_dist,
+                                 float *B_dist, float *C_dist)
+    __attribute__((weak));
+
+extern void COLLECTION_FILE_TEST(int m0, int n0, const char *C_path,
+                                 float *C_dist) __attribute__((weak));
+
+// optional: bytes the calling rank read from and wrote to files in the last
+// COMPUTE_OP call (out-of-core variants), reported as I/O bandwidth
+extern double IO_BYTES_TEST(int m0, int n0) __attribute__((weak));
+
 // fill created memory buffer with random values
-void fill_buffer_with_random_values(float *buffer, int num_elements) {
-  for (int i = 0; i < num_elements; i++) {
+void fill_buffer_with_random_values(float *buffer, size_t num_elements) {
+  for (size_t i = 0; i < num_elements; i++) {
     buffer[i] = (float)rand() / (float)(RAND_MAX);
   }
 }
 
 // fill a memory buffer with a specified value
-void fill_buffer_with_specified_value(float *buffer, int num_elements,
+void fill_buffer_with_specified_value(float *buffer, size_t num_elements,
                                       float value) {
-  for (int i = 0; i < num_elements; i++) {
+  for (size_t i = 0; i < num_elements; i++) {
     buffer[i] = value;
   }
 }
@@ -55,79 +107,137 @@ long pick_max_in_list(int num_trials, long *results) {
   return current_max;
 }
 
-// function to flush cache and have clean cache state for test iterations
-void flush_cache() {
-  // Allocate memory equal to L3 cache size
-  int size = 1024 * 1024 * 8;
+// phases of a call, timed separately on every rank
+enum {
+  PHASE_DISTRIBUTE,
+  PHASE_COMPUTE,
+  PHASE_COLLECT,
+  PHASE_TOTAL,  // end to end
+  NUM_PHASES
+};
+
+const char *phase_names[NUM_PHASES] = {"distribute", "compute", "collect",
+                                       "total"};
+
+// one size of the benchmark: the problem, its buffers and how it is fed
+typedef struct {
+  int m0, n0;
+  int batch_count;  // problems per BATCH_OP_TEST call, 0 outside batch mode
+  const char (*io_paths)[512];  // matrix files, NULL outside file mode
+  float *A_seq, *B_seq, *C_seq;  // A_seq packed with DISTRIBUTE_PACKED_TEST
+  float *A_dist, *B_dist, *C_dist;
+} problem_t;
+
+// run the operation under test once, phase by phase: the inputs are
+// distributed (from the root or the files), C is computed and collected.
+// times[phase] accumulates the time of each phase on the calling rank (a
+// batch call does all of it inside BATCH_OP_TEST, counted as compute).
+void call_function(const problem_t *p, long *times) {
+  // initialize timer counters
+  TIMER_INIT_COUNTERS(start, stop);
+  long diff;
 
-  // allocate memory for buffer that fills the cache
-  int *buffer = (int *)malloc(size * sizeof(int));
-  if (buffer == NULL) {
-    printf("Buffer(Cache flush): Memory allocation failed\n");
-    exit(1);
+  // every call starts on all ranks together
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  TIMER_GET_CLOCK(start);
+  if (p->batch_count == 0 && p->io_paths != NULL) {
+    DISTRIBUTE_FILE_TEST(p->m0, p->n0, p->io_paths[0], p->io_paths[1],
+                         p->A_dist, p->B_dist, p->C_dist);
+  } else if (p->batch_count == 0 && DISTRIBUTE_PACKED_TEST != NULL) {
+    DISTRIBUTE_PACKED_TEST(p->m0, p->n0, p->A_seq, p->B_seq, p->C_seq,
+                           p->A_dist, p->B_dist, p->C_dist);
+  } else if (p->batch_count == 0) {
+    DISTRIBUTE_DATA_TEST(p->m0, p->n0, p->A_seq, p->B_seq, p->C_seq,
+                         p->A_dist, p->B_dist, p->C_dist);
+  }
+  TIMER_GET_CLOCK(stop);
+  TIMER_GET_DIFF(start, stop, diff);
+  times[PHASE_DISTRIBUTE] += diff;
+  times[PHASE_TOTAL] += diff;
+
+  TIMER_GET_CLOCK(start);
+  if (p->batch_count > 0) {
+    BATCH_OP_TEST(p->batch_count, p->m0, p->n0, p->A_dist, p->B_dist,
+                  p->C_dist);
+  } else {
+    COMPUTE_OP_TEST(p->m0, p->n0, p->A_dist, p->B_dist, p->C_dist);
   }
-  // fill the buffer
-  int i, result = 0;
-  // volatile prevents compiler from optimizing out the loop
-  volatile int sink;
-  for (i = 0; i < size; i++) {
-    result += buffer[i];
+  TIMER_GET_CLOCK(stop);
+  TIMER_GET_DIFF(start, stop, diff);
+  times[PHASE_COMPUTE] += diff;
+  times[PHASE_TOTAL] += diff;
+
+  TIMER_GET_CLOCK(start);
+  if (p->batch_count == 0 && p->io_paths != NULL) {
+    COLLECTION_FILE_TEST(p->m0, p->n0, p->io_paths[2], p->C_dist);
+  } else if (p->batch_count == 0) {
+    COLLECTION_TEST(p->m0, p->n0, p->C_seq, p->C_dist);
   }
-  // force write to memory
-  sink = result;
-  // free the buffer
-  free(buffer);
+  TIMER_GET_CLOCK(stop);
+  TIMER_GET_DIFF(start, stop, diff);
+  times[PHASE_COLLECT] += diff;
+  times[PHASE_TOTAL] += diff;
 }
 
-void time_function_call(int num_trials, int num_runs, long *results, int m0,
-                        int n0, float *A_dist, float *B_dist, float *C_dist) {
+// time up to num_trials trials of num_runs calls each, after num_warmup
+// untimed calls. results[trial] is the compute time of one call on the
+// slowest rank, on every rank, so all ranks take the same decisions on it;
+// phases[phase * num_trials + trial] is the time of each phase of one call
+// on the calling rank. The end to end time of the trials on the slowest rank
+// is added to *spent, and trials stop once it passes budget (ns, 0 for none);
+// at least one trial is run. Returns the number of trials run.
+int time_function_call(int num_trials, int num_runs, int num_warmup,
+                       double budget, double *spent, long *results,
+                       long *phases, const problem_t *problem) {
   int rid;
   int num_ranks;
-  int tag;
-  MPI_Status status;
-  int root_id = 0;
+
+  // initialize timer counters
+  TIMER_INIT_COUNTERS(start, stop);
 
   MPI_Comm_rank(MPI_COMM_WORLD, &rid);
   MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
 
-  // initialize timer counters
-  TIMER_INIT_COUNTERS(start, stop);
+  // untimed calls: page faults, first touch of the arena buffers and lazy
+  // MPI connection setup are paid here
+  long times[NUM_PHASES] = {0};
+  for (int run = 0; run < num_warmup; run++) {
+    call_function(problem, times);
+  }
 
   // barrier to synchronize all ranks
   MPI_Barrier(MPI_COMM_WORLD);
-  // warm up timers
+  // warm up timers (also with TRMM_WARMUP=0)
   TIMER_WARMUP(start, stop);
-
-  // flush cache before trials
-  flush_cache();
+  (void)start;
+  (void)stop;
 
   // run the function call for the specified number of trials
-  for (int trial = 0; trial < num_trials; trial++) {
-    // start timer
-    TIMER_GET_CLOCK(start);
+  int trial = 0;
+  while (trial < num_trials &&
+         (trial == 0 || budget <= 0.0 || *spent < budget)) {
+    for (int phase = 0; phase < NUM_PHASES; phase++) times[phase] = 0;
 
     // run for number of runs
     for (int run = 0; run < num_runs; run++) {
-      // call the function to be timed
-      COMPUTE_OP_TEST(m0, n0, A_dist, B_dist, C_dist);
+      call_function(problem, times);
     }
 
-    TIMER_GET_CLOCK(stop);
-
-    // get the difference in time and append to results
-    TIMER_GET_DIFF(start, stop, results[trial]);
-
-    long max_time;
-    // reduce the max time among all ranks to root
-    MPI_Reduce(&results[trial], &max_time, 1, MPI_LONG, MPI_MAX, root_id,
-               MPI_COMM_WORLD);
-
-    // root rank stores the max time in results
-    if (rid == root_id) {
-      results[trial] = max_time;
+    // the max compute and end to end times among all ranks
+    long local[2] = {times[PHASE_COMPUTE], times[PHASE_TOTAL]};
+    long max_time[2];
+    MPI_Allreduce(local, max_time, 2, MPI_LONG, MPI_MAX, MPI_COMM_WORLD);
+    results[trial] = max_time[0] / num_runs;
+    for (int phase = 0; phase < NUM_PHASES; phase++) {
+      phases[phase * num_trials + trial] = times[phase] / num_runs;
     }
+    *spent += (double)max_time[1];
+    trial++;
   }
+  return trial;
 }
+
 int scale_steps(int step, int dim) {
   if (dim < 0) {
     return -1 * dim;
@@ -135,21 +245,83 @@ int scale_steps(int step, int dim) {
     return dim * step;
   }
 }
+
+// measurement setting from the environment, or its default
+int env_int(const char *name, int value) {
+  return getenv(name) != NULL ? atoi(getenv(name)) : value;
+}
+
+double env_double(const char *name, double value) {
+  return getenv(name) != NULL ? atof(getenv(name)) : value;
+}
+
+// environment of the process (TRMM_* settings go in the JSON report)
+extern char **environ;
+
+// write s as a JSON string
+void json_string(FILE *file, const char *s) {
+  fputc('"', file);
+  for (; *s != '\0'; s++) {
+    if ((unsigned char)*s < 0x20) {
+      fprintf(file, "\\u%04x", (unsigned char)*s);
+      continue;
+    }
+    if (*s == '"' || *s == '\\') fputc('\\', file);
+    fputc(*s, file);
+  }
+  fputc('"', file);
+}
+
+// open the JSON report: TRMM_JSON, else the CSV file name with a .json
+// extension (no report when the CSV goes to stdout)
+FILE *open_json_report(const char *csv_path) {
+  char path[1024];
+  if (getenv("TRMM_JSON") != NULL) {
+    snprintf(path, sizeof(path), "%s", getenv("TRMM_JSON"));
+  } else if (csv_path != NULL) {
+    snprintf(path, sizeof(path), "%s", csv_path);
+    char *dot = strrchr(path, '.');
+    if (dot != NULL && strcmp(dot, ".csv") == 0) *dot = '\0';
+    strncat(path, ".json", sizeof(path) - strlen(path) - 1);
+  } else {
+    return NULL;
+  }
+  return fopen(path, "w");
+}
+
 int main(int argc, char *argv[]) {
   int rid;
   int num_ranks;
-  int tag = 0;
   int root_id = 0;
 
-  MPI_Init(&argc, &argv);
+  // threads of a rank only run inside the compute kernels
+  int thread_support;
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &thread_support);
 
   MPI_Comm_rank(MPI_COMM_WORLD, &rid);
   MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
 
   FILE *csv_file;
 
-  int num_trials = 10;
-  int num_runs = 1;
+  // measurement settings:
+  //   TRMM_TRIALS  timed trials per size (10)
+  //   TRMM_RUNS    calls per trial, timed together (1)
+  //   TRMM_WARMUP  untimed calls before the trials (1)
+  //   TRMM_BUDGET  seconds of timed trials per size, re-runs included, 0 for
+  //                no limit (0)
+  //   TRMM_MAX_CV  the trials are run again while their coefficient of
+  //                variation is above this (0.05)
+  //   TRMM_RERUNS  at most this many times (3)
+  int num_trials = env_int("TRMM_TRIALS", 10);
+  int num_runs = env_int("TRMM_RUNS", 1);
+  int num_warmup = env_int("TRMM_WARMUP", 1);
+  double budget = env_double("TRMM_BUDGET", 0.0) * 1e9;
+  double max_cv = env_double("TRMM_MAX_CV", 0.05);
+  int max_reruns = env_int("TRMM_RERUNS", 3);
+  if (num_trials < 1) num_trials = 1;
+  if (num_runs < 1) num_runs = 1;
+  if (num_warmup < 0) num_warmup = 0;
+  if (max_reruns < 0) max_reruns = 0;
 
   // Parameters for the test
   int min_size;
@@ -168,7 +340,7 @@ int main(int argc, char *argv[]) {
     input_n0 = 3;
 
     csv_file = stdout;
-  } else if (argc == 5 + 1 || argc == 6 + 1) {
+  } else if (argc == 5 + 1 || argc == 6 + 1 || argc == 7 + 1) {
     min_size = atoi(argv[1]);
     max_size = atoi(argv[2]);
     step_size = atoi(argv[3]);
@@ -179,21 +351,156 @@ int main(int argc, char *argv[]) {
     // print to stdout if no file is specified
     csv_file = stdout;
 
-    // if file specified then use the file
-    if (argc == 6 + 1) {
+    // if file specified then use the file (opened on the root only: a rank
+    // that opens it late would truncate what the root already wrote)
+    if (argc >= 6 + 1 && rid == root_id) {
       csv_file = fopen(argv[6], "w");
-    } else {
-      csv_file = NULL;
+    }
+
+    // threads per rank for the hybrid MPI + OpenMP kernels
+    if (argc == 7 + 1) {
+#ifdef _OPENMP
+      omp_set_num_threads(atoi(argv[7]));
+#endif
     }
   } else {
     printf(
-        "Usage: %s [min_size] [max_size] [step_size] [m0] [n0] [output_file]\n",
+        "Usage: %s [min_size] [max_size] [step_size] [m0] [n0] [output_file] "
+        "[num_threads]\n",
         argv[0]);
     exit(1);
   }
-  // use the root id to print the header on CSV file
+  // threads per rank (1 without OpenMP)
+  int num_threads = 1;
+#ifdef _OPENMP
+  num_threads = omp_get_max_threads();
+#endif
+
+  // batch mode: TRMM_BATCH problems per call through BATCH_OP_TEST
+  int batch_count = 0;
+  if (getenv("TRMM_BATCH") != NULL) {
+    batch_count = atoi(getenv("TRMM_BATCH"));
+  }
+  if (batch_count > 0 && BATCH_OP_TEST == NULL) {
+    if (rid == root_id) {
+      printf("Test: TRMM_BATCH is set but the variant has no batch entry\n");
+    }
+    MPI_Finalize();
+    exit(1);
+  }
+  int batch = batch_count > 0 ? batch_count : 1;
+
+  // file mode: TRMM_IO_DIR=<dir shared by all ranks>, the inputs are
+  // written to matrix files in parallel and no rank holds whole matrices
+  const char *io_dir = getenv("TRMM_IO_DIR");
+  int io_mode = io_dir != NULL && batch_count == 0;
+  if (io_mode &&
+      (DISTRIBUTE_FILE_TEST == NULL || COLLECTION_FILE_TEST == NULL)) {
+    if (rid == root_id) {
+      printf("Test: TRMM_IO_DIR is set but the variant has no file entry\n");
+    }
+    MPI_Finalize();
+    exit(1);
+  }
+  char io_paths[3][512];
+  if (io_mode) {
+    // names carry the pid of the root, so runs sharing the directory do
+    // not collide
+    long pid = (long)getpid();
+    MPI_Bcast(&pid, 1, MPI_LONG, root_id, MPI_COMM_WORLD);
+    const char *names[3] = {"A", "B", "C"};
+    for (int f = 0; f < 3; f++) {
+      snprintf(io_paths[f], sizeof(io_paths[f]), "%s/trmm_io_%ld_%s.bin",
+               io_dir, pid, names[f]);
+    }
+  }
+
+  // host of every rank, for the JSON report
+  char host[MPI_MAX_PROCESSOR_NAME];
+  int host_length;
+  memset(host, 0, sizeof(host));
+  MPI_Get_processor_name(host, &host_length);
+  char *hosts = NULL;
   if (rid == root_id) {
-    fprintf(csv_file, "num_ranks,m0,n0,gflops\n");
+    hosts = (char *)malloc((size_t)num_ranks * MPI_MAX_PROCESSOR_NAME);
+  }
+  MPI_Gather(host, MPI_MAX_PROCESSOR_NAME, MPI_CHAR, hosts,
+             MPI_MAX_PROCESSOR_NAME, MPI_CHAR, root_id, MPI_COMM_WORLD);
+
+  // JSON report: the exact configuration, then every size with its
+  // statistics and samples
+  FILE *json_file = NULL;
+  if (rid == root_id) {
+    json_file = open_json_report(argc >= 6 + 1 ? argv[6] : NULL);
+  }
+  if (json_file != NULL) {
+    char library[MPI_MAX_LIBRARY_VERSION_STRING];
+    int library_length;
+    MPI_Get_library_version(library, &library_length);
+    char date[64];
+    time_t now = time(NULL);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+    fprintf(json_file, "{\n  \"config\": {\n    \"executable\": ");
+    json_string(json_file, argv[0]);
+    fprintf(json_file, ",\n    \"date\": ");
+    json_string(json_file, date);
+    fprintf(json_file, ",\n    \"num_ranks\": %d,\n    \"num_threads\": %d,",
+            num_ranks, num_threads);
+    fprintf(json_file, "\n    \"hosts\": [");
+    for (int r = 0; r < num_ranks; r++) {
+      if (r > 0) fputs(", ", json_file);
+      json_string(json_file, hosts + (size_t)r * MPI_MAX_PROCESSOR_NAME);
+    }
+    fprintf(json_file,
+            "],\n    \"min_size\": %d,\n    \"max_size\": %d,\n"
+            "    \"step_size\": %d,\n    \"m0\": %d,\n    \"n0\": %d,\n"
+            "    \"trials\": %d,\n    \"runs\": %d,\n    \"warmup\": %d,\n"
+            "    \"budget_s\": %g,\n    \"max_cv\": %g,\n"
+            "    \"max_reruns\": %d,\n    \"batch\": %d,\n"
+            "    \"file_mode\": %s,\n    \"compiler\": ",
+            min_size, max_size, step_size, input_m0, input_n0, num_trials,
+            num_runs, num_warmup, budget / 1e9, max_cv, max_reruns, batch,
+            io_mode ? "true" : "false");
+    json_string(json_file, TRMM_BUILD_CC);
+    fprintf(json_file, ",\n    \"compiler_version\": ");
+    json_string(json_file, __VERSION__);
+    fprintf(json_file, ",\n    \"cflags\": ");
+    json_string(json_file, TRMM_BUILD_CFLAGS);
+    fprintf(json_file, ",\n    \"mpi_library\": ");
+    json_string(json_file, library);
+
+    // every TRMM_* setting of the run (modes, arena, variant parameters)
+    fprintf(json_file, ",\n    \"environment\": {");
+    int first = 1;
+    for (char **env = environ; *env != NULL; env++) {
+      const char *equals = strchr(*env, '=');
+      if (strncmp(*env, "TRMM_", 5) != 0 || equals == NULL) continue;
+      char name[256];
+      snprintf(name, sizeof(name), "%.*s", (int)(equals - *env), *env);
+      fputs(first ? "\n      " : ",\n      ", json_file);
+      json_string(json_file, name);
+      fprintf(json_file, ": ");
+      json_string(json_file, equals + 1);
+      first = 0;
+    }
+    fprintf(json_file, "%s}\n  },\n  \"results\": [", first ? "" : "\n    ");
+  }
+  free(hosts);
+
+  // use the root id to print the header on CSV file (gflops and the trial
+  // statistics are of the compute phase, gflops_total of the whole call on
+  // the slowest rank; times in ns per call)
+  if (rid == root_id) {
+    fprintf(csv_file,
+            "num_ranks,num_threads,m0,n0,gflops,arena_mb,arena_huge_mb,"
+            "arena_maps,arena_reuses,batch,io_gbs,trials,reruns,median_ns,"
+            "mean_ns,stddev_ns,p95_ns,cv,gflops_median");
+    for (int phase = 0; phase < NUM_PHASES; phase++) {
+      fprintf(csv_file, ",%s_max_ns,%s_min_ns,%s_avg_ns", phase_names[phase],
+              phase_names[phase], phase_names[phase]);
+    }
+    fprintf(csv_file, ",gflops_total\n");
   }
 
   for (int size = min_size; size <= max_size; size += step_size) {
@@ -201,83 +508,250 @@ int main(int argc, char *argv[]) {
     int m0 = scale_steps(size, input_m0);
     int n0 = scale_steps(size, input_n0);
 
-    // buffer sizes
-    int A_seq_size = m0 * m0;
-    int B_seq_size = m0 * n0;
-    int C_seq_size = m0 * n0;
-
-    // allocate memory for sequential buffers
-    float *A_seq = (float *)malloc(A_seq_size * sizeof(float));
-    float *B_seq = (float *)malloc(B_seq_size * sizeof(float));
-    float *C_seq = (float *)malloc(C_seq_size * sizeof(float));
-
-    // check if memory allocation was successful
-    if (A_seq == NULL || B_seq == NULL || C_seq == NULL) {
-      printf("Test: Sequential Memory buffer allocation failed\n");
-      exit(1);
-    }
-
-    // fill buffers with random values using root_id
-    if (rid == root_id) {
+    // buffer sizes (batch problems back to back in batch mode, A packed
+    // for variants with DISTRIBUTE_PACKED_TEST)
+    // (size_t: past m0 = 46341 a matrix no longer fits an int count)
+    size_t A_seq_size = batch_count == 0 && DISTRIBUTE_PACKED_TEST != NULL
+                            ? TRMM_PACKED_SIZE(m0)
+                            : (size_t)m0 * m0 * batch;
+    size_t B_seq_size = (size_t)m0 * n0 * batch;
+    size_t C_seq_size = (size_t)m0 * n0 * batch;
+
+    // sequential buffers live on the root only (and nowhere in file mode:
+    // DISTRIBUTE_DATA and COLLECTION only touch them on the root)
+    float *A_seq = NULL;
+    float *B_seq = NULL;
+    float *C_seq = NULL;
+
+    if (rid == root_id && !io_mode) {
+      A_seq = (float *)malloc(A_seq_size * sizeof(float));
+      B_seq = (float *)malloc(B_seq_size * sizeof(float));
+      C_seq = (float *)malloc(C_seq_size * sizeof(float));
+
+      // check if memory allocation was successful
+      if (A_seq == NULL || B_seq == NULL || C_seq == NULL) {
+        printf("Test: Sequential Memory buffer allocation failed\n");
+        exit(1);
+      }
+
+      // fill buffers with random values
       fill_buffer_with_random_values(A_seq, A_seq_size);
       fill_buffer_with_random_values(B_seq, B_seq_size);
       fill_buffer_with_specified_value(C_seq, C_seq_size, 0.0);
     }
 
     // allocate pointers for distributed buffers
-    float *A_dist_test;
-    float *B_dist_test;
-    float *C_dist_test;
-
-    // // distribute memory allocation
-    DISTRIBUTE_ALLOCATION_TEST(m0, n0, &A_dist_test, &B_dist_test,
-                               &C_dist_test);
-
-    if (A_dist_test == NULL || B_dist_test == NULL || C_dist_test == NULL) {
-      printf("Test: Distributed Memory buffer allocation failed\n");
-      exit(1);
+    // (batch mode works straight on the sequential buffers of the root)
+    float *A_dist_test = A_seq;
+    float *B_dist_test = B_seq;
+    float *C_dist_test = C_seq;
+
+    if (batch_count == 0) {
+      // // distribute memory allocation
+      DISTRIBUTE_ALLOCATION_TEST(m0, n0, &A_dist_test, &B_dist_test,
+                                 &C_dist_test);
+
+      if (A_dist_test == NULL || B_dist_test == NULL || C_dist_test == NULL) {
+        printf("Test: Distributed Memory buffer allocation failed\n");
+        exit(1);
+      }
+      if (io_mode) {
+        // every rank writes a share of the rows of A (packed) and B, then
+        // reads its own slices back
+        trmm_io_header_t header;
+        trmm_io_header_init(&header, m0, m0, TRMM_ROW_MAJOR,
+                            TRMM_IO_PACKED_LOWER);
+        trmm_io_check(trmm_io_write_random(MPI_COMM_WORLD, io_paths[0],
+                                           &header, 1),
+                      "write", io_paths[0]);
+        trmm_io_header_init(&header, m0, n0, TRMM_ROW_MAJOR, TRMM_IO_FULL);
+        trmm_io_check(trmm_io_write_random(MPI_COMM_WORLD, io_paths[1],
+                                           &header, 2),
+                      "write", io_paths[1]);
+      }
     }
-    // // distribute data
-    DISTRIBUTE_DATA_TEST(m0, n0, A_seq, B_seq, C_seq, A_dist_test, B_dist_test,
-                         C_dist_test);
 
-    // allocate memory for results
-    long *results = (long *)malloc(num_trials * sizeof(long));
-    if (results == NULL) {
+    // every call distributes, computes and collects (each timed)
+    problem_t problem = {.m0 = m0,
+                         .n0 = n0,
+                         .batch_count = batch_count,
+                         .io_paths = io_mode ? io_paths : NULL,
+                         .A_seq = A_seq,
+                         .B_seq = B_seq,
+                         .C_seq = C_seq,
+                         .A_dist = A_dist_test,
+                         .B_dist = B_dist_test,
+                         .C_dist = C_dist_test};
+
+    // allocate memory for results (the kept trials and the latest ones, with
+    // the phase times of the calling rank)
+    long *results = (long *)malloc(2 * num_trials * sizeof(long));
+    long *phases =
+        (long *)malloc(2 * (size_t)NUM_PHASES * num_trials * sizeof(long));
+    if (results == NULL || phases == NULL) {
       printf("Test:Results Memory allocation failed\n");
       exit(1);
     }
+    long *latest = results + num_trials;
+    long *latest_phases = phases + (size_t)NUM_PHASES * num_trials;
+
+    // perform test: trials are run again while they are too noisy, and the
+    // most consistent set is kept (every rank has the same times, so all
+    // ranks stop together)
+    int count = 0;
+    int reruns = 0;
+    double spent = 0.0;
+    trmm_stats_t stats;
+    for (;;) {
+      int trials = time_function_call(
+          num_trials, num_runs, reruns == 0 ? num_warmup : 0, budget, &spent,
+          latest, latest_phases, &problem);
+
+      trmm_stats_t latest_stats;
+      trmm_stats_compute(trials, latest, &latest_stats);
+      if (count == 0 || (trials >= count && latest_stats.cv < stats.cv)) {
+        memcpy(results, latest, trials * sizeof(long));
+        memcpy(phases, latest_phases,
+               (size_t)NUM_PHASES * num_trials * sizeof(long));
+        count = trials;
+        stats = latest_stats;
+      }
+      if (stats.cv <= max_cv || reruns >= max_reruns ||
+          (budget > 0.0 && spent >= budget)) {
+        break;
+      }
+      reruns++;
+    }
 
-    // perform test
-    time_function_call(num_trials, num_runs, results, m0, n0, A_dist_test,
-                       B_dist_test, C_dist_test);
+    // let the variant report its own statistics
+    if (batch_count == 0 && REPORT_STATS_TEST != NULL) {
+      REPORT_STATS_TEST(m0, n0);
+    }
 
     // pick min in results
-    long min_time = pick_min_in_list(num_trials, results);
+    long min_time = pick_min_in_list(count, results);
+
+    // phase times: the median over the kept trials on every rank, then the
+    // max, min and average over the ranks
+    double phase_local[NUM_PHASES];
+    for (int phase = 0; phase < NUM_PHASES; phase++) {
+      trmm_stats_t phase_stats;
+      trmm_stats_compute(count, phases + (size_t)phase * num_trials,
+                         &phase_stats);
+      phase_local[phase] = phase_stats.median;
+    }
+    double phase_max[NUM_PHASES], phase_min[NUM_PHASES];
+    double phase_avg[NUM_PHASES];
+    MPI_Reduce(phase_local, phase_max, NUM_PHASES, MPI_DOUBLE, MPI_MAX,
+               root_id, MPI_COMM_WORLD);
+    MPI_Reduce(phase_local, phase_min, NUM_PHASES, MPI_DOUBLE, MPI_MIN,
+               root_id, MPI_COMM_WORLD);
+    MPI_Reduce(phase_local, phase_avg, NUM_PHASES, MPI_DOUBLE, MPI_SUM,
+               root_id, MPI_COMM_WORLD);
+    for (int phase = 0; phase < NUM_PHASES; phase++) {
+      phase_avg[phase] /= num_ranks;
+    }
 
-    // get floating operation per second
-    long num_flops =
-        m0 * m0 * n0 * 2;  // multiply by two to factor in addition operation
+    // get floating operation per second: m0 * (m0 + 1) / 2 multiply-adds per
+    // column of B, as only the lower triangle of A is multiplied (in double:
+    // the product overflows 32-bit arithmetic from m0 = n0 = 1024 on)
+    double num_flops = (double)m0 * (m0 + 1) * n0;
+
+    // get throughput in GFLOPS (aggregate over the problems of a batch):
+    // compute phase of the fastest and median trial, and end to end on the
+    // slowest rank
+    double throughput = num_flops * batch / (double)min_time;
+    double throughput_median = num_flops * batch / stats.median;
+    double throughput_total = 0.0;
+    if (rid == root_id) {
+      throughput_total = num_flops * batch / phase_max[PHASE_TOTAL];
+    }
 
-    // get throughput in GFLOPS
-    float throughput = (float)num_flops / (float)min_time;
+    // I/O bandwidth in GB/s over all ranks: IO_BYTES covers the last call,
+    // and every call of a size moves the same bytes, so they are divided by
+    // the compute time of the fastest trial
+    double io_local = 0.0;
+    if (batch_count == 0 && IO_BYTES_TEST != NULL) {
+      io_local = IO_BYTES_TEST(m0, n0);
+    }
+    double io_bytes;
+    MPI_Reduce(&io_local, &io_bytes, 1, MPI_DOUBLE, MPI_SUM, root_id,
+               MPI_COMM_WORLD);
+    double io_bandwidth = io_bytes / (double)min_time;
+
+    if (json_file != NULL) {
+      fprintf(json_file,
+              "%s\n    {\"m0\": %d, \"n0\": %d, \"trials\": %d, "
+              "\"reruns\": %d, \"min_ns\": %.0f, \"median_ns\": %.1f, "
+              "\"mean_ns\": %.1f, \"stddev_ns\": %.1f, \"p95_ns\": %.0f, "
+              "\"max_ns\": %.0f, \"cv\": %.4f, \"gflops\": %.2f, "
+              "\"gflops_median\": %.2f, \"gflops_total\": %.2f, "
+              "\"phases\": {",
+              size == min_size ? "" : ",", m0, n0, count, reruns, stats.min,
+              stats.median, stats.mean, stats.stddev, stats.p95, stats.max,
+              stats.cv, throughput, throughput_median, throughput_total);
+      for (int phase = 0; phase < NUM_PHASES; phase++) {
+        fprintf(json_file,
+                "%s\"%s\": {\"max_ns\": %.1f, \"min_ns\": %.1f, "
+                "\"avg_ns\": %.1f}",
+                phase > 0 ? ", " : "", phase_names[phase], phase_max[phase],
+                phase_min[phase], phase_avg[phase]);
+      }
+      fprintf(json_file, "}, \"samples_ns\": [");
+      for (int t = 0; t < count; t++) {
+        fprintf(json_file, t > 0 ? ", %ld" : "%ld", results[t]);
+      }
+      fprintf(json_file, "]}");
+    }
 
     // free results memory and set pointer to NULL to avoid dangling pointers
     free(results);
+    free(phases);
     results = NULL;
-
-    // collect the distributed data and write to sequential buffer
-    COLLECTION_TEST(m0, n0, C_seq, C_dist_test);
-
-    // free buffers
-    FREE_MEMORY_TEST(A_dist_test, B_dist_test, C_dist_test);
+    phases = NULL;
+
+    if (batch_count == 0) {
+      if (io_mode) {
+        // C is in its file after every call, the files are removed
+        MPI_Barrier(MPI_COMM_WORLD);
+        if (rid == root_id) {
+          for (int f = 0; f < 3; f++) {
+            MPI_File_delete(io_paths[f], MPI_INFO_NULL);
+          }
+        }
+      }
+
+      // free buffers
+      FREE_MEMORY_TEST(A_dist_test, B_dist_test, C_dist_test);
+    }
     A_dist_test = NULL;
     B_dist_test = NULL;
     C_dist_test = NULL;
 
+    // arena allocator counters of the busiest rank (cumulative over sizes)
+    trmm_arena_stats_t arena;
+    trmm_arena_get_stats(&arena);
+    double arena_local[4] = {arena.reserved / 1048576.0,
+                             arena.huge / 1048576.0, (double)arena.maps,
+                             (double)arena.reuses};
+    double arena_max[4];
+    MPI_Reduce(arena_local, arena_max, 4, MPI_DOUBLE, MPI_MAX, root_id,
+               MPI_COMM_WORLD);
+
     // print the results to the csv file
     if (rid == root_id) {
-      fprintf(csv_file, "%d, %d, %d,%2.2f\n", num_ranks, m0, n0, throughput);
+      fprintf(csv_file,
+              "%d, %d, %d, %d,%2.2f,%.2f,%.2f,%.0f,%.0f,%d,%.2f,%d,%d,%.1f,"
+              "%.1f,%.1f,%.0f,%.4f,%.2f",
+              num_ranks, num_threads, m0, n0, throughput, arena_max[0],
+              arena_max[1], arena_max[2], arena_max[3], batch, io_bandwidth,
+              count, reruns, stats.median, stats.mean, stats.stddev,
+              stats.p95, stats.cv, throughput_median);
+      for (int phase = 0; phase < NUM_PHASES; phase++) {
+        fprintf(csv_file, ",%.1f,%.1f,%.1f", phase_max[phase],
+                phase_min[phase], phase_avg[phase]);
+      }
+      fprintf(csv_file, ",%.2f\n", throughput_total);
     }
 
     // free the sequential buffers and set pointers to NULL to avoid dangling
@@ -294,6 +768,10 @@ int main(int argc, char *argv[]) {
   if (rid == root_id && csv_file != NULL) {
     fclose(csv_file);
   }
+  if (json_file != NULL) {
+    fprintf(json_file, "\n  ]\n}\n");
+    fclose(json_file);
+  }
 
   MPI_Finalize();
 }
@@ -0,0 +1,190 @@
+#define _GNU_SOURCE
+
+#include "trmm_arena.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define ARENA_HUGE_PAGE ((size_t)2 << 20)
+
+#define HUGE_NONE 0
+#define HUGE_THP 1
+#define HUGE_EXPLICIT 2
+
+static const char *huge_names[] = {"none", "thp", "explicit"};
+
+typedef struct {
+  char *base;       // start of the buffer handed out
+  char *map_base;   // start of the mapping (before alignment)
+  size_t map_size;  // size of the mapping
+  size_t capacity;  // usable bytes from base
+  int in_use;
+  int huge;
+} arena_block_t;
+
+// block table, doubled when every slot holds a live buffer
+static arena_block_t *blocks = NULL;
+static int num_blocks = 0;
+static int max_blocks = 0;
+static int huge_mode = -1;
+static trmm_arena_stats_t stats;
+
+static int huge_mode_from_env(void) {
+  const char *mode = getenv("TRMM_HUGEPAGES");
+  if (mode == NULL) return HUGE_NONE;
+  for (int h = 0; h < 3; h++) {
+    if (strcmp(mode, huge_names[h]) == 0) return h;
+  }
+  fprintf(stderr, "Unknown TRMM_HUGEPAGES '%s', using none\n", mode);
+  return HUGE_NONE;
+}
+
+static size_t round_up(size_t bytes, size_t unit) {
+  return (bytes + unit - 1) / unit * unit;
+}
+
+// map a block of at least bytes bytes, 0 on success
+static int map_block(arena_block_t *block, size_t bytes) {
+  size_t page = (size_t)sysconf(_SC_PAGESIZE);
+  int prot = PROT_READ | PROT_WRITE;
+  int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+
+  if (huge_mode == HUGE_EXPLICIT) {
+    size_t size = round_up(bytes, ARENA_HUGE_PAGE);
+    void *p = mmap(NULL, size, prot, flags | MAP_HUGETLB, -1, 0);
+    if (p != MAP_FAILED) {
+      block->base = block->map_base = (char *)p;
+      block->map_size = block->capacity = size;
+      block->huge = 1;
+      return 0;
+    }
+    fprintf(stderr, "MAP_HUGETLB failed for %zu bytes, using thp\n", size);
+    huge_mode = HUGE_THP;
+  }
+
+  if (huge_mode == HUGE_THP && bytes >= ARENA_HUGE_PAGE) {
+    // over-allocate by one huge page to align the start to 2 MB
+    size_t size = round_up(bytes, ARENA_HUGE_PAGE);
+    size_t map_size = size + ARENA_HUGE_PAGE;
+    void *p = mmap(NULL, map_size, prot, flags, -1, 0);
+    if (p == MAP_FAILED) return -1;
+    char *base = (char *)round_up((size_t)(uintptr_t)p, ARENA_HUGE_PAGE);
+    madvise(base, size, MADV_HUGEPAGE);
+    block->base = base;
+    block->map_base = (char *)p;
+    block->map_size = map_size;
+    block->capacity = size;
+    block->huge = 1;
+    return 0;
+  }
+
+  size_t size = round_up(bytes, page);
+  void *p = mmap(NULL, size, prot, flags, -1, 0);
+  if (p == MAP_FAILED) return -1;
+  block->base = block->map_base = (char *)p;
+  block->map_size = block->capacity = size;
+  block->huge = 0;
+  return 0;
+}
+
+static void unmap_block(arena_block_t *block) {
+  munmap(block->map_base, block->map_size);
+  stats.reserved -= block->capacity;
+  if (block->huge) stats.huge -= block->capacity;
+}
+
+static void *arena_alloc_locked(size_t bytes) {
+  if (huge_mode < 0) huge_mode = huge_mode_from_env();
+  if (bytes == 0) bytes = 64;
+  stats.allocs++;
+
+  // Smallest free block that fits, otherwise the largest free block
+  int fit = -1;
+  int spare = -1;
+  for (int b = 0; b < num_blocks; b++) {
+    if (blocks[b].in_use) continue;
+    if (blocks[b].capacity >= bytes) {
+      if (fit < 0 || blocks[b].capacity < blocks[fit].capacity) fit = b;
+    } else if (spare < 0 || blocks[b].capacity > blocks[spare].capacity) {
+      spare = b;
+    }
+  }
+
+  if (fit >= 0) {
+    stats.reuses++;
+    blocks[fit].in_use = 1;
+    stats.in_use += blocks[fit].capacity;
+    return blocks[fit].base;
+  }
+
+  // Grow a free block that is too small (by at least half, so a sweep
+  // over increasing sizes does not remap at every step) or add a new one
+  arena_block_t *block;
+  size_t request = bytes;
+  if (spare >= 0) {
+    block = &blocks[spare];
+    if (request < block->capacity + block->capacity / 2) {
+      request = block->capacity + block->capacity / 2;
+    }
+    unmap_block(block);
+  } else {
+    if (num_blocks == max_blocks) {
+      int grown = max_blocks ? 2 * max_blocks : 64;
+      arena_block_t *table =
+          (arena_block_t *)realloc(blocks, grown * sizeof(arena_block_t));
+      if (table == NULL) return NULL;
+      blocks = table;
+      max_blocks = grown;
+    }
+    block = &blocks[num_blocks++];
+  }
+
+  if (map_block(block, request) != 0) {
+    // keep the slot but mark it empty
+    block->base = block->map_base = NULL;
+    block->map_size = block->capacity = 0;
+    block->in_use = 0;
+    return NULL;
+  }
+
+  stats.maps++;
+  stats.reserved += block->capacity;
+  if (block->huge) stats.huge += block->capacity;
+  if (stats.reserved > stats.peak_reserved) {
+    stats.peak_reserved = stats.reserved;
+  }
+  block->in_use = 1;
+  stats.in_use += block->capacity;
+  return block->base;
+}
+
+void *trmm_arena_alloc(size_t bytes) {
+  void *ptr;
+#pragma omp critical(trmm_arena)
+  ptr = arena_alloc_locked(bytes);
+  return ptr;
+}
+
+void trmm_arena_free(void *ptr) {
+  if (ptr == NULL) return;
+#pragma omp critical(trmm_arena)
+  {
+    int b = 0;
+    while (b < num_blocks && blocks[b].base != (char *)ptr) b++;
+    if (b < num_blocks && blocks[b].in_use) {
+      blocks[b].in_use = 0;
+      stats.in_use -= blocks[b].capacity;
+    } else {
+      fprintf(stderr, "Arena: free of an unknown buffer %p\n", ptr);
+    }
+  }
+}
+
+void trmm_arena_get_stats(trmm_arena_stats_t *out) {
+#pragma omp critical(trmm_arena)
+  *out = stats;
+}
@@ -0,0 +1,49 @@
+#ifndef TRMM_ARENA_H
+#define TRMM_ARENA_H
+
+#include <stddef.h>
+
+/*
+Arena allocator for the distributed buffers and kernel scratch space
+
+Every buffer is a block of its own mapped with mmap, so it starts on a page
+boundary (at least 64-byte aligned: AVX loads of an aligned row never split
+a cache line). trmm_arena_free only marks a block as free: the next
+allocation reuses the smallest free block that is large enough, and when
+none is, a free block that is too small is replaced by a larger one. The
+arena therefore only grows, and a size sweep that frees and reallocates
+its buffers at every step maps new memory only when a size outgrows the
+previous ones. The block table grows with the number of live buffers.
+
+Huge pages are selected at runtime with TRMM_HUGEPAGES:
+
+  none      (default) regular pages
+  thp       blocks of 2 MB and more are 2 MB aligned and advised with
+            MADV_HUGEPAGE (transparent huge pages)
+  explicit  blocks are mapped with MAP_HUGETLB from the reserved huge page
+            pool, falling back to thp when the pool is empty
+
+The allocator is safe to call from OpenMP threads. trmm_arena_get_stats
+returns the counters of the calling process; the timer prints them next
+to the GFLOP/s of every size.
+*/
+
+typedef struct {
+  long allocs;          // calls to trmm_arena_alloc
+  long reuses;          // allocations served by an existing block
+  long maps;            // blocks mapped (new or grown)
+  size_t in_use;        // bytes of the blocks handed out and not freed
+  size_t reserved;      // bytes mapped by the arena
+  size_t peak_reserved; // largest value of reserved so far
+  size_t huge;          // bytes of reserved backed by huge pages
+} trmm_arena_stats_t;
+
+// 64-byte aligned buffer of at least bytes bytes, NULL on failure
+void *trmm_arena_alloc(size_t bytes);
+
+// give a buffer back to the arena (NULL is ignored)
+void trmm_arena_free(void *ptr);
+
+void trmm_arena_get_stats(trmm_arena_stats_t *stats);
+
+#endif /* TRMM_ARENA_H */
@@ -0,0 +1,249 @@
+#ifndef TRMM_AUTOTUNE_H
+#define TRMM_AUTOTUNE_H
+
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/*
+Runtime autotuner with a persisted tuning database
+
+A kernel asks for its tuning parameters (tile size and loop order) for a
+shape with autotune_params. The answer is looked up, in order, in:
+
+  1. the entries already resolved by this process,
+  2. the tuning file named by TRMM_TUNING_FILE (default trmm_tuning.txt),
+     read once by the root at the first lookup,
+  3. a sweep over the candidate parameters, when TRMM_AUTOTUNE is set to a
+     non-zero value: every candidate gets a warm-up run and TUNE_REPEATS
+     timed runs, each timed on the slowest rank, and the candidate with
+     the smallest minimum is appended to the tuning file,
+
+and otherwise the kernel's compiled-in default is used. Entries are keyed by
+kernel name, m0, n0, number of ranks and number of threads, one per line:
+
+  kernel m0 n0 ranks threads block order gflops
+
+autotune_params is collective over MPI_COMM_WORLD the first time a key is
+seen (the root decides and broadcasts), so it must be called by every rank
+and every rank of a run uses the same parameters; later calls are answered
+locally.
+*/
+
+#define TUNE_ORDER_IJK 0  // dot product over k innermost
+#define TUNE_ORDER_IKJ 1  // row update over j innermost
+
+#define TUNE_DEFAULT_FILE "trmm_tuning.txt"
+
+// timed runs per candidate; the minimum is kept, so one run slowed down
+// by noise does not rule out a candidate
+#define TUNE_REPEATS 3
+
+static const char *tune_order_names[] = {"ijk", "ikj"};
+
+typedef struct {
+  int block;
+  int order;
+} tune_params_t;
+
+// runs the kernel once with the given parameters (on every rank)
+typedef void (*tune_run_fn)(const tune_params_t *params, void *arg);
+
+typedef struct {
+  char kernel[32];
+  int m0, n0, ranks, threads;
+  tune_params_t params;
+  double gflops;
+} tune_entry_t;
+
+typedef struct {
+  tune_entry_t *entries;
+  int count;
+  int capacity;
+} tune_table_t;
+
+static tune_table_t tune_resolved;  // answers known to every rank
+static tune_table_t tune_file;      // contents of the tuning file (root)
+static int tune_file_loaded = 0;
+
+static inline const char *tune_file_path(void) {
+  const char *path = getenv("TRMM_TUNING_FILE");
+  return path != NULL && path[0] != '\0' ? path : TUNE_DEFAULT_FILE;
+}
+
+static inline int tune_order_from_name(const char *name) {
+  for (int o = 0; o < 2; o++) {
+    if (strcmp(name, tune_order_names[o]) == 0) return o;
+  }
+  return -1;
+}
+
+static inline void tune_table_add(tune_table_t *table,
+                                  const tune_entry_t *entry) {
+  if (table->count == table->capacity) {
+    table->capacity = table->capacity ? 2 * table->capacity : 16;
+    table->entries = (tune_entry_t *)realloc(
+        table->entries, table->capacity * sizeof(tune_entry_t));
+  }
+  table->entries[table->count++] = *entry;
+}
+
+// most recent entry of the table matching the key, NULL if none
+static inline const tune_entry_t *tune_table_find(const tune_table_t *table,
+                                                  const tune_entry_t *key) {
+  for (int t = table->count - 1; t >= 0; t--) {
+    const tune_entry_t *e = &table->entries[t];
+    if (strcmp(e->kernel, key->kernel) == 0 && e->m0 == key->m0 &&
+        e->n0 == key->n0 && e->ranks == key->ranks &&
+        e->threads == key->threads) {
+      return e;
+    }
+  }
+  return NULL;
+}
+
+// read the tuning file (root only); a missing file is an empty database
+static inline void tune_load_file(void) {
+  tune_file_loaded = 1;
+  FILE *file = fopen(tune_file_path(), "r");
+  if (file == NULL) return;
+
+  char line[256];
+  while (fgets(line, sizeof(line), file) != NULL) {
+    tune_entry_t e;
+    char order[8];
+    if (line[0] == '#') continue;
+    if (sscanf(line, "%31s %d %d %d %d %d %7s %lf", e.kernel, &e.m0, &e.n0,
+               &e.ranks, &e.threads, &e.params.block, order,
+               &e.gflops) != 8) {
+      continue;
+    }
+    e.params.order = tune_order_from_name(order);
+    if (e.params.block <= 0 || e.params.order < 0) continue;
+    tune_table_add(&tune_file, &e);
+  }
+  fclose(file);
+}
+
+// append a tuned entry to the tuning file (root only)
+static inline void tune_save_entry(const tune_entry_t *e) {
+  FILE *file = fopen(tune_file_path(), "a");
+  if (file == NULL) {
+    fprintf(stderr, "Cannot write tuning file %s\n", tune_file_path());
+    return;
+  }
+  if (ftell(file) == 0) {
+    fprintf(file, "# kernel m0 n0 ranks threads block order gflops\n");
+  }
+  fprintf(file, "%s %d %d %d %d %d %s %.3f\n", e->kernel, e->m0, e->n0,
+          e->ranks, e->threads, e->params.block,
+          tune_order_names[e->params.order], e->gflops);
+  fclose(file);
+}
+
+// time every candidate (slowest rank, best of TUNE_REPEATS runs) and return
+// the index of the fastest
+static inline int tune_sweep(const tune_params_t *candidates,
+                             int num_candidates, tune_run_fn run, void *arg,
+                             double *best_time) {
+  int best = 0;
+  *best_time = -1.0;
+
+  for (int c = 0; c < num_candidates; c++) {
+    // untimed warm-up, so the caches start from this candidate's data
+    run(&candidates[c], arg);
+
+    double fastest = -1.0;
+    for (int rep = 0; rep < TUNE_REPEATS; rep++) {
+      MPI_Barrier(MPI_COMM_WORLD);
+      double t0 = MPI_Wtime();
+      run(&candidates[c], arg);
+      double local = MPI_Wtime() - t0;
+      double elapsed;
+      MPI_Allreduce(&local, &elapsed, 1, MPI_DOUBLE, MPI_MAX,
+                    MPI_COMM_WORLD);
+      if (fastest < 0.0 || elapsed < fastest) fastest = elapsed;
+    }
+
+    if (*best_time < 0.0 || fastest < *best_time) {
+      *best_time = fastest;
+      best = c;
+    }
+  }
+  return best;
+}
+
+/*
+Tuning parameters of kernel for an m0 x n0 problem
+
+candidates are the parameters swept in tuning mode and fallback the ones
+used when the database has no entry and tuning is off.
+*/
+static inline tune_params_t autotune_params(const char *kernel, int m0,
+                                            int n0,
+                                            const tune_params_t *candidates,
+                                            int num_candidates,
+                                            tune_params_t fallback,
+                                            tune_run_fn run, void *arg) {
+  tune_entry_t key;
+  memset(&key, 0, sizeof(key));
+  strncpy(key.kernel, kernel, sizeof(key.kernel) - 1);
+  key.m0 = m0;
+  key.n0 = n0;
+  MPI_Comm_size(MPI_COMM_WORLD, &key.ranks);
+#ifdef _OPENMP
+  key.threads = omp_get_max_threads();
+#else
+  key.threads = 1;
+#endif
+
+  const tune_entry_t *known = tune_table_find(&tune_resolved, &key);
+  if (known != NULL) return known->params;
+
+  int rid;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+
+  // sweep flag, block, order
+  int decision[3] = {0, fallback.block, fallback.order};
+  if (rid == 0) {
+    if (!tune_file_loaded) tune_load_file();
+    const tune_entry_t *stored = tune_table_find(&tune_file, &key);
+    const char *tune = getenv("TRMM_AUTOTUNE");
+    if (stored != NULL) {
+      decision[1] = stored->params.block;
+      decision[2] = stored->params.order;
+    } else if (tune != NULL && atoi(tune) != 0) {
+      decision[0] = 1;
+    }
+  }
+  MPI_Bcast(decision, 3, MPI_INT, 0, MPI_COMM_WORLD);
+
+  key.params.block = decision[1];
+  key.params.order = decision[2];
+
+  if (decision[0]) {
+    double best_time;
+    int best = tune_sweep(candidates, num_candidates, run, arg, &best_time);
+    key.params = candidates[best];
+    key.gflops = best_time > 0.0 ? (double)m0 * (m0 + 1) * n0 / best_time / 1e9
+                                 : 0.0;
+    if (rid == 0) {
+      tune_table_add(&tune_file, &key);
+      tune_save_entry(&key);
+      fprintf(stderr, "autotune %s m0=%d n0=%d ranks=%d threads=%d: "
+              "block=%d order=%s (%.2f GFLOP/s)\n",
+              key.kernel, m0, n0, key.ranks, key.threads, key.params.block,
+              tune_order_names[key.params.order], key.gflops);
+    }
+  }
+
+  tune_table_add(&tune_resolved, &key);
+  return key.params;
+}
+
+#endif /* TRMM_AUTOTUNE_H */
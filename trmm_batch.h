@@ -0,0 +1,215 @@
+#ifndef TRMM_BATCH_H
+#define TRMM_BATCH_H
+
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "trmm_arena.h"
+#include "trmm_kernels.h"
+#include "trmm_mpi.h"
+
+/*
+Batched lower triangular multiplies: C[p] = A[p] * B[p] for p < count
+
+Small problems are never split: every rank gets a contiguous range of
+whole problems with about the same number of flops, and the threads of the
+rank share those problems (one problem per thread at a time, run with the
+serial register-tiled kernel, so no parallel region is opened per problem).
+The root sends every rank all of its A and B matrices in one message each,
+described by an MPI_Type_create_struct datatype over the caller's buffers
+(one large-count sub-type per matrix, so a matrix may pass 2^31
+elements), and receives the C matrices back the same way; there is no
+other per-call communication or barrier.
+
+  trmm_batch(count, m0, n0, A, B, C, comm)
+      m0[p] x m0[p] A[p], m0[p] x n0[p] B[p] and C[p], row major
+  trmm_batch_strided(count, m0, n0, A, stride_A, B, stride_B, C, stride_C,
+                     comm)
+      count problems of the same shape, problem p at A + p * stride_A, ...
+
+count and the shapes must be given on every rank of comm, the matrices
+only on its root (rank 0). Must be called by every rank of comm.
+*/
+
+// flops of one problem (multiply-adds of the lower triangle)
+static inline double trmm_batch_cost(int m0, int n0) {
+  return (double)m0 * (m0 + 1) / 2 * n0;
+}
+
+// first problem of every rank (first[num_ranks] = count), flop balanced
+static inline void trmm_batch_split(int count, const int *m0, const int *n0,
+                                    int num_ranks, int *first) {
+  double total = 0.0;
+  for (int p = 0; p < count; p++) total += trmm_batch_cost(m0[p], n0[p]);
+
+  // problem p goes to the rank whose share holds the middle of its cost
+  double prefix = 0.0;
+  int r = 0;
+  first[0] = 0;
+  for (int p = 0; p < count; p++) {
+    double cost = trmm_batch_cost(m0[p], n0[p]);
+    double mid = prefix + cost / 2;
+    while (r + 1 < num_ranks && mid >= total * (r + 1) / num_ranks) {
+      first[++r] = p;
+    }
+    prefix += cost;
+  }
+  while (r + 1 <= num_ranks) first[++r] = count;
+}
+
+// one message worth of problems [p0, p1) of a batch, straight from the
+// caller's buffers (rows x cols floats per problem, which may pass 2^31)
+static inline MPI_Datatype trmm_batch_type(int p0, int p1, const int *rows,
+                                           const int *cols,
+                                           const float *const *M) {
+  int n = p1 - p0;
+  int *lengths = (int *)malloc((n + 1) * sizeof(int));
+  MPI_Aint *displs = (MPI_Aint *)malloc((n + 1) * sizeof(MPI_Aint));
+  MPI_Datatype *types =
+      (MPI_Datatype *)malloc((n + 1) * sizeof(MPI_Datatype));
+  for (int p = p0; p < p1; p++) {
+    trmm_mpi_count_type((size_t)rows[p] * cols[p], MPI_FLOAT, &types[p - p0],
+                        &lengths[p - p0]);
+    MPI_Get_address(M[p], &displs[p - p0]);
+  }
+  MPI_Datatype type;
+  MPI_Type_create_struct(n, lengths, displs, types, &type);
+  MPI_Type_commit(&type);
+  for (int t = 0; t < n; t++) trmm_mpi_type_release(MPI_FLOAT, &types[t]);
+  free(lengths);
+  free(displs);
+  free(types);
+  return type;
+}
+
+static inline void trmm_batch(int count, const int *m0, const int *n0,
+                              const float *const *A, const float *const *B,
+                              float *const *C, MPI_Comm comm) {
+  int num_ranks, rid;
+  MPI_Comm_size(comm, &num_ranks);
+  MPI_Comm_rank(comm, &rid);
+
+  int *first = (int *)malloc((num_ranks + 1) * sizeof(int));
+  trmm_batch_split(count, m0, n0, num_ranks, first);
+  int p0 = first[rid];
+  int p1 = first[rid + 1];
+
+  if (rid == 0) {
+    // 3 messages per rank: A and B out, C back
+    MPI_Request *requests =
+        (MPI_Request *)malloc((3 * num_ranks + 1) * sizeof(MPI_Request));
+    MPI_Datatype *types =
+        (MPI_Datatype *)malloc((3 * num_ranks + 1) * sizeof(MPI_Datatype));
+    int num_requests = 0;
+
+    for (int r = 1; r < num_ranks; r++) {
+      int r0 = first[r];
+      int r1 = first[r + 1];
+      if (r0 == r1) continue;
+      types[num_requests] = trmm_batch_type(r0, r1, m0, m0, A);
+      MPI_Isend(MPI_BOTTOM, 1, types[num_requests], r, 0, comm,
+                &requests[num_requests]);
+      num_requests++;
+      types[num_requests] = trmm_batch_type(r0, r1, m0, n0, B);
+      MPI_Isend(MPI_BOTTOM, 1, types[num_requests], r, 1, comm,
+                &requests[num_requests]);
+      num_requests++;
+      types[num_requests] =
+          trmm_batch_type(r0, r1, m0, n0, (const float *const *)C);
+      MPI_Irecv(MPI_BOTTOM, 1, types[num_requests], r, 2, comm,
+                &requests[num_requests]);
+      num_requests++;
+    }
+
+    // The root works on its own problems in place
+#pragma omp parallel for schedule(dynamic)
+    for (int p = p0; p < p1; p++) {
+      trmm_lower_small(m0[p], n0[p], A[p], m0[p], B[p], n0[p], C[p], n0[p]);
+    }
+
+    MPI_Waitall(num_requests, requests, MPI_STATUSES_IGNORE);
+    for (int t = 0; t < num_requests; t++) MPI_Type_free(&types[t]);
+    free(requests);
+    free(types);
+  } else if (p0 < p1) {
+    // Problems arrive back to back; offsets of every problem
+    long *a_offsets = (long *)malloc((p1 - p0 + 1) * sizeof(long));
+    long *b_offsets = (long *)malloc((p1 - p0 + 1) * sizeof(long));
+    a_offsets[0] = 0;
+    b_offsets[0] = 0;
+    for (int p = p0; p < p1; p++) {
+      a_offsets[p - p0 + 1] = a_offsets[p - p0] + (long)m0[p] * m0[p];
+      b_offsets[p - p0 + 1] = b_offsets[p - p0] + (long)m0[p] * n0[p];
+    }
+    long a_size = a_offsets[p1 - p0];
+    long b_size = b_offsets[p1 - p0];
+
+    float *A_local = (float *)trmm_arena_alloc((a_size + 1) * sizeof(float));
+    float *B_local = (float *)trmm_arena_alloc((b_size + 1) * sizeof(float));
+    float *C_local = (float *)trmm_arena_alloc((b_size + 1) * sizeof(float));
+    if (A_local == NULL || B_local == NULL || C_local == NULL) {
+      printf("Rank %d: Memory allocation failed\n", rid);
+      MPI_Abort(comm, 1);
+    }
+
+    trmm_mpi_recv(A_local, (size_t)a_size, MPI_FLOAT, 0, 0, comm);
+    trmm_mpi_recv(B_local, (size_t)b_size, MPI_FLOAT, 0, 1, comm);
+
+#pragma omp parallel for schedule(dynamic)
+    for (int p = p0; p < p1; p++) {
+      trmm_lower_small(m0[p], n0[p], A_local + a_offsets[p - p0], m0[p],
+                       B_local + b_offsets[p - p0], n0[p],
+                       C_local + b_offsets[p - p0], n0[p]);
+    }
+
+    trmm_mpi_send(C_local, (size_t)b_size, MPI_FLOAT, 0, 2, comm);
+
+    trmm_arena_free(A_local);
+    trmm_arena_free(B_local);
+    trmm_arena_free(C_local);
+    free(a_offsets);
+    free(b_offsets);
+  }
+
+  free(first);
+}
+
+static inline void trmm_batch_strided(int count, int m0, int n0,
+                                      const float *A, long stride_A,
+                                      const float *B, long stride_B,
+                                      float *C, long stride_C,
+                                      MPI_Comm comm) {
+  int rid;
+  MPI_Comm_rank(comm, &rid);
+
+  int *m0s = (int *)malloc((count + 1) * sizeof(int));
+  int *n0s = (int *)malloc((count + 1) * sizeof(int));
+  const float **As = NULL;
+  const float **Bs = NULL;
+  float **Cs = NULL;
+  for (int p = 0; p < count; p++) {
+    m0s[p] = m0;
+    n0s[p] = n0;
+  }
+  if (rid == 0) {
+    As = (const float **)malloc((count + 1) * sizeof(float *));
+    Bs = (const float **)malloc((count + 1) * sizeof(float *));
+    Cs = (float **)malloc((count + 1) * sizeof(float *));
+    for (int p = 0; p < count; p++) {
+      As[p] = A + p * stride_A;
+      Bs[p] = B + p * stride_B;
+      Cs[p] = C + p * stride_C;
+    }
+  }
+
+  trmm_batch(count, m0s, n0s, As, Bs, Cs, comm);
+
+  free(m0s);
+  free(n0s);
+  free(As);
+  free(Bs);
+  free(Cs);
+}
+
+#endif /* TRMM_BATCH_H */
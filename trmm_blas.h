@@ -0,0 +1,530 @@
+#ifndef TRMM_BLAS_H
+#define TRMM_BLAS_H
+
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "trmm_arena.h"
+#include "trmm_kernels.h"
+#include "trmm_layout.h"
+#include "trmm_mpi.h"
+
+/*
+BLAS-style triangular multiplies (the ?trmm parameter set), out of place
+
+  side = TRMM_LEFT    C = alpha * op(A) * B    A is m x m
+  side = TRMM_RIGHT   C = alpha * B * op(A)    A is n x n
+
+B and C are m x n. op(A) is A (TRMM_NOTRANS) or its transpose (TRMM_TRANS),
+A is TRMM_LOWER or TRMM_UPPER triangular and with TRMM_UNIT its diagonal is
+taken as ones. Elements of the other triangle of A, and with TRMM_UNIT the
+diagonal, are never read. The kernels take row major matrices with leading
+dimensions lda, ldb and ldc.
+
+Every case runs its own kernel; A is never transposed or copied:
+
+  left       rows of C += op(A)(i, k) * rows of B. op(A)(i, k) is read
+             with strides (lda, 1) or (1, lda), so transposing A only
+             changes which element is broadcast
+  right, N   rows of C += B(i, k) * rows of A, masked to the triangle
+  right, T   C(i, j) = B row i . A row j, vectorized over k
+
+With TRMM_UNIT the diagonal term adds B directly instead of loading and
+multiplying the diagonal of A.
+
+  trmm_blas_local(side, uplo, trans, diag, m, n, alpha, A, lda, B, ldb,
+                  C, ldc)
+      on the calling rank, tiles of C shared by its threads, row major
+  trmm_blas(layout, side, uplo, trans, diag, m, n, alpha, A, lda, B, ldb,
+            C, ldc, comm)
+      distributed: columns (left) or rows (right) of B and C are
+      independent and split evenly over the ranks of comm; A is broadcast.
+      The parameters must be given on every rank, the matrices only on the
+      root (rank 0). They are stored in the given layout (trmm_layout.h) and
+      may be submatrices of larger arrays: the root sends and receives
+      straight out of and into them with strided datatypes and computes its
+      own block in place, so nothing is copied on the root. A column major
+      call runs as the row major product of the transposes, which swaps
+      the side and the triangle of A.
+*/
+
+#define TRMM_LEFT 0
+#define TRMM_RIGHT 1
+
+#define TRMM_LOWER 0
+#define TRMM_UPPER 1
+
+#define TRMM_NOTRANS 0
+#define TRMM_TRANS 1
+
+#define TRMM_NONUNIT 0
+#define TRMM_UNIT 1
+
+// tile of the dot product kernel (right side, transposed A)
+#define TRMM_DMR 2
+#define TRMM_DNR 4
+
+// columns of C per panel: the threads share (panel, row tile) pairs, so the
+// A rows of a panel (right side) stay in cache across row tiles
+#ifndef TRMM_BLAS_NB
+#define TRMM_BLAS_NB 48
+#endif
+
+#if TRMM_HAVE_AVX2
+
+// lanes [lo, hi) enabled
+TRMM_INLINE __m256i trmm_lane_range(int lo, int hi) {
+  return _mm256_andnot_si256(trmm_lane_mask(lo), trmm_lane_mask(hi));
+}
+
+TRMM_INLINE float trmm_hsum(__m256 v) {
+  __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+  s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+  s = _mm_add_ss(s, _mm_movehdup_ps(s));
+  return _mm_cvtss_f32(s);
+}
+
+/*
+Left side tile: rows i..i+mr, TRMM_NR columns at B and C
+
+op(A)(i, k) is at A + i * rs_a + k * cs_a. lower is the triangle of op(A):
+columns k < i (lower) or k >= i + mr (upper) are used by every row of the
+tile, the mr columns in between form the diagonal band.
+*/
+TRMM_INLINE void trmm_blas_left_body(int i, int mr, int nr, int m, int lower,
+                                     int unit, float alpha, const float *A,
+                                     int rs_a, int cs_a, const float *B,
+                                     int ldb, float *C, int ldc,
+                                     const int full) {
+  __m256 c[TRMM_MR][2];
+  __m256i mask_lo = trmm_lane_mask(nr);
+  __m256i mask_hi = trmm_lane_mask(nr - 8);
+  const float *a[TRMM_MR];
+
+  for (int r = 0; r < TRMM_MR; r++) {
+    c[r][0] = _mm256_setzero_ps();
+    c[r][1] = _mm256_setzero_ps();
+    a[r] = A + (size_t)(i + (r < mr ? r : 0)) * rs_a;
+  }
+
+  int k_start = lower ? 0 : i + mr;
+  int k_end = lower ? i : m;
+  for (int k = k_start; k < k_end; k++) {
+    const float *b = B + (size_t)k * ldb;
+    __m256 b0 = full ? _mm256_loadu_ps(b) : _mm256_maskload_ps(b, mask_lo);
+    __m256 b1 =
+        full ? _mm256_loadu_ps(b + 8) : _mm256_maskload_ps(b + 8, mask_hi);
+    for (int r = 0; r < TRMM_MR; r++) {
+      if (r < mr) {
+        __m256 a_r = _mm256_broadcast_ss(a[r] + (size_t)k * cs_a);
+        c[r][0] = _mm256_fmadd_ps(a_r, b0, c[r][0]);
+        c[r][1] = _mm256_fmadd_ps(a_r, b1, c[r][1]);
+      }
+    }
+  }
+
+  // diagonal band: row r uses column i + d for d < r (lower) or d > r
+  // (upper), and its diagonal at d == r
+  for (int d = 0; d < mr; d++) {
+    const float *b = B + (size_t)(i + d) * ldb;
+    __m256 b0 = full ? _mm256_loadu_ps(b) : _mm256_maskload_ps(b, mask_lo);
+    __m256 b1 =
+        full ? _mm256_loadu_ps(b + 8) : _mm256_maskload_ps(b + 8, mask_hi);
+    for (int r = 0; r < TRMM_MR; r++) {
+      if (r >= mr) continue;
+      if (d == r && unit) {
+        c[r][0] = _mm256_add_ps(c[r][0], b0);
+        c[r][1] = _mm256_add_ps(c[r][1], b1);
+      } else if (d == r || (lower ? d < r : d > r)) {
+        __m256 a_r = _mm256_broadcast_ss(a[r] + (size_t)(i + d) * cs_a);
+        c[r][0] = _mm256_fmadd_ps(a_r, b0, c[r][0]);
+        c[r][1] = _mm256_fmadd_ps(a_r, b1, c[r][1]);
+      }
+    }
+  }
+
+  __m256 scale = _mm256_set1_ps(alpha);
+  for (int r = 0; r < TRMM_MR; r++) {
+    if (r < mr) {
+      float *c_row = C + (size_t)r * ldc;
+      __m256 c0 = _mm256_mul_ps(scale, c[r][0]);
+      __m256 c1 = _mm256_mul_ps(scale, c[r][1]);
+      if (full) {
+        _mm256_storeu_ps(c_row, c0);
+        _mm256_storeu_ps(c_row + 8, c1);
+      } else {
+        _mm256_maskstore_ps(c_row, mask_lo, c0);
+        _mm256_maskstore_ps(c_row + 8, mask_hi, c1);
+      }
+    }
+  }
+}
+
+/*
+Right side tile, A not transposed: rows i..i+mr of C, columns j..j+nr
+
+Row k of A is loaded TRMM_NR columns at a time. Rows k >= j + nr (lower) or
+k < j (upper) are full; in the nr rows in between only the columns inside
+the triangle are loaded (column j + d is the diagonal of row k = j + d).
+*/
+TRMM_INLINE void trmm_blas_right_n_body(int mr, int nr, int j, int n,
+                                        int lower, int unit, float alpha,
+                                        const float *A, int lda,
+                                        const float *B, int ldb, float *C,
+                                        int ldc, const int full) {
+  __m256 c[TRMM_MR][2];
+  __m256i mask_lo = trmm_lane_mask(nr);
+  __m256i mask_hi = trmm_lane_mask(nr - 8);
+  const __m256 ones = _mm256_set1_ps(1.0f);
+
+  for (int r = 0; r < TRMM_MR; r++) {
+    c[r][0] = _mm256_setzero_ps();
+    c[r][1] = _mm256_setzero_ps();
+  }
+
+  int k_start = lower ? j + nr : 0;
+  int k_end = lower ? n : j;
+  for (int k = k_start; k < k_end; k++) {
+    const float *a = A + (size_t)k * lda + j;
+    __m256 a0 = full ? _mm256_loadu_ps(a) : _mm256_maskload_ps(a, mask_lo);
+    __m256 a1 =
+        full ? _mm256_loadu_ps(a + 8) : _mm256_maskload_ps(a + 8, mask_hi);
+    for (int r = 0; r < TRMM_MR; r++) {
+      if (r < mr) {
+        __m256 b_r = _mm256_broadcast_ss(B + (size_t)r * ldb + k);
+        c[r][0] = _mm256_fmadd_ps(b_r, a0, c[r][0]);
+        c[r][1] = _mm256_fmadd_ps(b_r, a1, c[r][1]);
+      }
+    }
+  }
+
+  // diagonal band: in row j + d the columns d' < d (lower) or d' > d
+  // (upper) are loaded, the diagonal d' == d too unless unit
+  for (int d = 0; d < nr; d++) {
+    int lo = lower ? 0 : d + unit;
+    int hi = lower ? d + 1 - unit : nr;
+    const float *a = A + (size_t)(j + d) * lda + j;
+    __m256 a0 = _mm256_maskload_ps(a, trmm_lane_range(lo, hi));
+    __m256 a1 = _mm256_maskload_ps(a + 8, trmm_lane_range(lo - 8, hi - 8));
+    __m256 e0 = _mm256_setzero_ps();
+    __m256 e1 = _mm256_setzero_ps();
+    if (unit) {
+      e0 = _mm256_and_ps(_mm256_castsi256_ps(trmm_lane_range(d, d + 1)), ones);
+      e1 = _mm256_and_ps(_mm256_castsi256_ps(trmm_lane_range(d - 8, d - 7)),
+                         ones);
+    }
+    for (int r = 0; r < TRMM_MR; r++) {
+      if (r < mr) {
+        __m256 b_r = _mm256_broadcast_ss(B + (size_t)r * ldb + j + d);
+        c[r][0] = _mm256_fmadd_ps(b_r, a0, c[r][0]);
+        c[r][1] = _mm256_fmadd_ps(b_r, a1, c[r][1]);
+        if (unit) {
+          c[r][0] = _mm256_fmadd_ps(b_r, e0, c[r][0]);
+          c[r][1] = _mm256_fmadd_ps(b_r, e1, c[r][1]);
+        }
+      }
+    }
+  }
+
+  __m256 scale = _mm256_set1_ps(alpha);
+  for (int r = 0; r < TRMM_MR; r++) {
+    if (r < mr) {
+      float *c_row = C + (size_t)r * ldc + j;
+      __m256 c0 = _mm256_mul_ps(scale, c[r][0]);
+      __m256 c1 = _mm256_mul_ps(scale, c[r][1]);
+      if (full) {
+        _mm256_storeu_ps(c_row, c0);
+        _mm256_storeu_ps(c_row + 8, c1);
+      } else {
+        _mm256_maskstore_ps(c_row, mask_lo, c0);
+        _mm256_maskstore_ps(c_row + 8, mask_hi, c1);
+      }
+    }
+  }
+}
+
+/*
+Right side tile, A transposed: rows i..i+mr, columns j..j+nr of C
+
+C(i, j) = sum over k of B(i, k) * A(j, k): rows of B and A are streamed
+eight k at a time into one accumulator per element of the tile. Column c
+only uses k in [lo_c, hi_c); chunks inside every range use plain loads,
+the others masked loads of A.
+*/
+static inline void trmm_blas_right_t_tile(int mr, int nr, int j, int n,
+                                          int lower, int unit, float alpha,
+                                          const float *A, int lda,
+                                          const float *B, int ldb, float *C,
+                                          int ldc) {
+  __m256 acc[TRMM_DMR][TRMM_DNR];
+  int lo[TRMM_DNR], hi[TRMM_DNR];
+  int k_min = n, k_max = 0, full_lo = 0, full_hi = n;
+
+  for (int c = 0; c < TRMM_DNR; c++) {
+    int col = j + (c < nr ? c : 0);
+    lo[c] = lower ? col + unit : 0;
+    hi[c] = lower ? n : col + 1 - unit;
+    if (c < nr) {
+      if (lo[c] < k_min) k_min = lo[c];
+      if (hi[c] > k_max) k_max = hi[c];
+      if (lo[c] > full_lo) full_lo = lo[c];
+      if (hi[c] < full_hi) full_hi = hi[c];
+    }
+    for (int r = 0; r < TRMM_DMR; r++) acc[r][c] = _mm256_setzero_ps();
+  }
+
+  for (int k = k_min; k < k_max; k += 8) {
+    // rows past mr are never read; zeroed so the compiler can tell
+    __m256 b[TRMM_DMR];
+    for (int r = 0; r < TRMM_DMR; r++) b[r] = _mm256_setzero_ps();
+    int inside = k >= full_lo && k + 8 <= full_hi;
+    __m256i b_mask = trmm_lane_mask(k_max - k);
+    for (int r = 0; r < TRMM_DMR; r++) {
+      if (r < mr) {
+        const float *b_row = B + (size_t)r * ldb + k;
+        b[r] = inside ? _mm256_loadu_ps(b_row)
+                      : _mm256_maskload_ps(b_row, b_mask);
+      }
+    }
+    for (int c = 0; c < TRMM_DNR; c++) {
+      if (c >= nr) continue;
+      const float *a_row = A + (size_t)(j + c) * lda + k;
+      __m256 a = inside ? _mm256_loadu_ps(a_row)
+                        : _mm256_maskload_ps(
+                              a_row, trmm_lane_range(lo[c] - k, hi[c] - k));
+      for (int r = 0; r < TRMM_DMR; r++) {
+        if (r < mr) acc[r][c] = _mm256_fmadd_ps(b[r], a, acc[r][c]);
+      }
+    }
+  }
+
+  for (int r = 0; r < mr; r++) {
+    for (int c = 0; c < nr; c++) {
+      float sum = trmm_hsum(acc[r][c]);
+      // unit diagonal: B(i, j) itself, A(j, j) is never read
+      if (unit) sum += B[(size_t)r * ldb + j + c];
+      C[(size_t)r * ldc + j + c] = alpha * sum;
+    }
+  }
+}
+
+#endif  // TRMM_HAVE_AVX2
+
+// element (i, k) of op(A) inside its triangle, unit diagonal applied
+static inline float trmm_blas_op_element(int uplo, int trans, int diag,
+                                         const float *A, int lda, int i,
+                                         int k) {
+  int lower = (uplo == TRMM_LOWER) != (trans == TRMM_TRANS);
+  if (lower ? k > i : k < i) return 0.0f;
+  if (i == k && diag == TRMM_UNIT) return 1.0f;
+  return trans == TRMM_TRANS ? A[(size_t)k * lda + i]
+                              : A[(size_t)i * lda + k];
+}
+
+// plain C tile for builds without AVX2/FMA: rows i..i+mr, cols j..j+nr
+static inline void trmm_blas_scalar_tile(int side, int uplo, int trans,
+                                         int diag, int i, int mr, int j,
+                                         int nr, int m, int n, float alpha,
+                                         const float *A, int lda,
+                                         const float *B, int ldb, float *C,
+                                         int ldc) {
+  int k_dim = side == TRMM_LEFT ? m : n;
+  for (int r = i; r < i + mr; r++) {
+    for (int c = j; c < j + nr; c++) {
+      float sum = 0.0f;
+      for (int k = 0; k < k_dim; k++) {
+        if (side == TRMM_LEFT) {
+          sum += trmm_blas_op_element(uplo, trans, diag, A, lda, r, k) *
+                 B[(size_t)k * ldb + c];
+        } else {
+          sum += B[(size_t)r * ldb + k] *
+                 trmm_blas_op_element(uplo, trans, diag, A, lda, k, c);
+        }
+      }
+      C[(size_t)r * ldc + c] = alpha * sum;
+    }
+  }
+}
+
+static inline void trmm_blas_local(int side, int uplo, int trans, int diag,
+                                   int m, int n, float alpha, const float *A,
+                                   int lda, const float *B, int ldb, float *C,
+                                   int ldc) {
+  // triangle of op(A)
+  int lower = (uplo == TRMM_LOWER) != (trans == TRMM_TRANS);
+  int unit = diag == TRMM_UNIT;
+  int dot = side == TRMM_RIGHT && trans == TRMM_TRANS;
+  int tile_m = dot ? TRMM_DMR : TRMM_MR;
+  int tile_n = dot ? TRMM_DNR : TRMM_NR;
+
+#pragma omp parallel for schedule(dynamic) collapse(2)
+  for (int jb = 0; jb < n; jb += TRMM_BLAS_NB) {
+    for (int i = 0; i < m; i += tile_m) {
+      int mr = m - i < tile_m ? m - i : tile_m;
+      int j_end = jb + TRMM_BLAS_NB < n ? jb + TRMM_BLAS_NB : n;
+      for (int j = jb; j < j_end; j += tile_n) {
+        int nr = j_end - j < tile_n ? j_end - j : tile_n;
+#if TRMM_HAVE_AVX2
+        if (side == TRMM_LEFT) {
+          int rs_a = trans == TRMM_TRANS ? 1 : lda;
+          int cs_a = trans == TRMM_TRANS ? lda : 1;
+          if (nr == TRMM_NR)
+            trmm_blas_left_body(i, mr, nr, m, lower, unit, alpha, A, rs_a,
+                                cs_a, B + j, ldb, C + (size_t)i * ldc + j,
+                                ldc, 1);
+          else
+            trmm_blas_left_body(i, mr, nr, m, lower, unit, alpha, A, rs_a,
+                                cs_a, B + j, ldb, C + (size_t)i * ldc + j,
+                                ldc, 0);
+        } else if (!dot) {
+          if (nr == TRMM_NR)
+            trmm_blas_right_n_body(mr, nr, j, n, lower, unit, alpha, A, lda,
+                                   B + (size_t)i * ldb, ldb,
+                                   C + (size_t)i * ldc, ldc, 1);
+          else
+            trmm_blas_right_n_body(mr, nr, j, n, lower, unit, alpha, A, lda,
+                                   B + (size_t)i * ldb, ldb,
+                                   C + (size_t)i * ldc, ldc, 0);
+        } else {
+          trmm_blas_right_t_tile(mr, nr, j, n, lower, unit, alpha, A, lda,
+                                 B + (size_t)i * ldb, ldb,
+                                 C + (size_t)i * ldc, ldc);
+        }
+#else
+        trmm_blas_scalar_tile(side, uplo, trans, diag, i, mr, j, nr, m, n,
+                              alpha, A, lda, B, ldb, C, ldc);
+#endif
+      }
+    }
+  }
+}
+
+// block [start, start + count) of the dimension split over the ranks
+static inline void trmm_blas_block(int size, int num_ranks, int r, int *start,
+                                   int *count) {
+  int per_rank = size / num_ranks;
+  int extra = size % num_ranks;
+  *start = r * per_rank + (r < extra ? r : extra);
+  *count = per_rank + (r < extra ? 1 : 0);
+}
+
+// columns [start, start + count) (left) or rows (right) of an m x n row
+// major matrix with leading dimension ld
+static inline MPI_Datatype trmm_blas_block_type(int side, int m, int n,
+                                                int ld, int count) {
+  MPI_Datatype type;
+  if (side == TRMM_LEFT) {
+    MPI_Type_vector(m, count, ld, MPI_FLOAT, &type);
+  } else {
+    MPI_Type_vector(count, n, ld, MPI_FLOAT, &type);
+  }
+  MPI_Type_commit(&type);
+  return type;
+}
+
+static inline void trmm_blas(int layout, int side, int uplo, int trans,
+                             int diag, int m, int n, float alpha,
+                             const float *A, int lda, const float *B, int ldb,
+                             float *C, int ldc, MPI_Comm comm) {
+  // C^T = B^T * op(A)^T, and the row major view of a column major matrix is
+  // its transpose: the side and the triangle swap, trans does not
+  if (layout == TRMM_COL_MAJOR) {
+    trmm_blas(TRMM_ROW_MAJOR, !side, !uplo, trans, diag, n, m, alpha, A, lda,
+              B, ldb, C, ldc, comm);
+    return;
+  }
+
+  int num_ranks, rid;
+  MPI_Comm_size(comm, &num_ranks);
+  MPI_Comm_rank(comm, &rid);
+
+  int k_dim = side == TRMM_LEFT ? m : n;
+  int split = side == TRMM_LEFT ? n : m;
+  int start, count;
+  trmm_blas_block(split, num_ranks, rid, &start, &count);
+
+  // Every rank needs all of op(A); the root sends it out of the caller's
+  // matrix, the others receive it with leading dimension k_dim
+  if (rid == 0) {
+    MPI_Datatype A_type;
+    MPI_Type_vector(k_dim, k_dim, lda, MPI_FLOAT, &A_type);
+    MPI_Type_commit(&A_type);
+    MPI_Bcast((float *)A, 1, A_type, 0, comm);
+    MPI_Type_free(&A_type);
+  } else {
+    float *A_local =
+        (float *)trmm_arena_alloc(((size_t)k_dim * k_dim + 1) * sizeof(float));
+    if (A_local == NULL) {
+      printf("Rank %d: Memory allocation failed\n", rid);
+      MPI_Abort(comm, 1);
+    }
+    trmm_mpi_bcast(A_local, (size_t)k_dim * k_dim, MPI_FLOAT, 0, comm);
+    A = A_local;
+    lda = k_dim;
+  }
+
+  if (rid == 0) {
+    // B out, C back, straight from and into the caller's matrices
+    MPI_Request *requests =
+        (MPI_Request *)malloc(2 * num_ranks * sizeof(MPI_Request));
+    MPI_Datatype *types =
+        (MPI_Datatype *)malloc(2 * num_ranks * sizeof(MPI_Datatype));
+    int num_requests = 0;
+    int num_types = 0;
+
+    for (int r = 1; r < num_ranks; r++) {
+      int r_start, r_count;
+      trmm_blas_block(split, num_ranks, r, &r_start, &r_count);
+      if (r_count == 0) continue;
+      size_t B_offset =
+          side == TRMM_LEFT ? (size_t)r_start : (size_t)r_start * ldb;
+      size_t C_offset =
+          side == TRMM_LEFT ? (size_t)r_start : (size_t)r_start * ldc;
+      types[num_types] = trmm_blas_block_type(side, m, n, ldb, r_count);
+      MPI_Isend(B + B_offset, 1, types[num_types++], r, 0, comm,
+                &requests[num_requests++]);
+      types[num_types] = trmm_blas_block_type(side, m, n, ldc, r_count);
+      MPI_Irecv(C + C_offset, 1, types[num_types++], r, 1, comm,
+                &requests[num_requests++]);
+    }
+
+    // The root works on its own block in place
+    if (side == TRMM_LEFT) {
+      trmm_blas_local(side, uplo, trans, diag, m, count, alpha, A, lda,
+                      B + start, ldb, C + start, ldc);
+    } else {
+      trmm_blas_local(side, uplo, trans, diag, count, n, alpha, A, lda,
+                      B + (size_t)start * ldb, ldb, C + (size_t)start * ldc,
+                      ldc);
+    }
+
+    MPI_Waitall(num_requests, requests, MPI_STATUSES_IGNORE);
+    for (int t = 0; t < num_types; t++) MPI_Type_free(&types[t]);
+    free(requests);
+    free(types);
+  } else if (count > 0) {
+    int rows = side == TRMM_LEFT ? m : count;
+    int cols = side == TRMM_LEFT ? count : n;
+    float *B_local =
+        (float *)trmm_arena_alloc(((size_t)rows * cols + 1) * sizeof(float));
+    float *C_local =
+        (float *)trmm_arena_alloc(((size_t)rows * cols + 1) * sizeof(float));
+    if (B_local == NULL || C_local == NULL) {
+      printf("Rank %d: Memory allocation failed\n", rid);
+      MPI_Abort(comm, 1);
+    }
+
+    trmm_mpi_recv(B_local, (size_t)rows * cols, MPI_FLOAT, 0, 0, comm);
+    trmm_blas_local(side, uplo, trans, diag, rows, cols, alpha, A, lda,
+                    B_local, cols, C_local, cols);
+    trmm_mpi_send(C_local, (size_t)rows * cols, MPI_FLOAT, 0, 1, comm);
+
+    trmm_arena_free(B_local);
+    trmm_arena_free(C_local);
+  }
+
+  if (rid != 0) trmm_arena_free((float *)A);
+}
+
+#endif /* TRMM_BLAS_H */
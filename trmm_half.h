@@ -0,0 +1,199 @@
+#ifndef TRMM_HALF_H
+#define TRMM_HALF_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trmm_kernels.h"
+
+/*
+16-bit storage formats for A and B (Variant 10)
+
+  fp16  IEEE half precision: 5 exponent bits, 10 mantissa bits, range up
+        to 65504, unit roundoff 2^-11
+  bf16  bfloat16: the upper half of a float (8 exponent bits, 7 mantissa
+        bits), same range as float, unit roundoff 2^-8
+
+Both are stored as uint16_t and moved by MPI as MPI_UINT16_T. Stores round
+to nearest even. The kernels widen to fp32 as they load and accumulate in
+fp32; C stays fp32. With F16C the fp16 conversions are single
+instructions (vcvtph2ps / vcvtps2ph), bf16 only needs a 16-bit shift. The
+format is selected at runtime with TRMM_HALF (bf16 or fp16, default bf16).
+*/
+
+#define TRMM_BF16 0
+#define TRMM_FP16 1
+
+typedef uint16_t trmm_half_t;
+
+static const char *trmm_half_names[] = {"bf16", "fp16"};
+
+#if defined(__F16C__)
+#include <immintrin.h>
+#define TRMM_HAVE_F16C 1
+#else
+#define TRMM_HAVE_F16C 0
+#endif
+
+// the format is resolved on the first call and cached, so an unknown
+// TRMM_HALF is reported once per process
+static inline int trmm_half_format_from_env(void) {
+  static int cached = -1;
+  if (cached >= 0) return cached;
+
+  cached = TRMM_BF16;
+  const char *format = getenv("TRMM_HALF");
+  if (format == NULL) return cached;
+  for (int f = 0; f < 2; f++) {
+    if (strcmp(format, trmm_half_names[f]) == 0) return cached = f;
+  }
+  fprintf(stderr, "Unknown TRMM_HALF '%s', using bf16\n", format);
+  return cached;
+}
+
+// unit roundoff of a format
+static inline double trmm_half_epsilon(int format) {
+  return format == TRMM_FP16 ? 1.0 / 2048.0 : 1.0 / 256.0;
+}
+
+TRMM_INLINE uint32_t trmm_float_bits(float x) {
+  uint32_t u;
+  memcpy(&u, &x, sizeof(u));
+  return u;
+}
+
+TRMM_INLINE float trmm_bits_float(uint32_t u) {
+  float x;
+  memcpy(&x, &u, sizeof(x));
+  return x;
+}
+
+TRMM_INLINE trmm_half_t trmm_float_to_bf16(float x) {
+  uint32_t u = trmm_float_bits(x);
+  if ((u & 0x7fffffffu) > 0x7f800000u) return (trmm_half_t)((u >> 16) | 0x40);
+  u += 0x7fffu + ((u >> 16) & 1u);
+  return (trmm_half_t)(u >> 16);
+}
+
+TRMM_INLINE float trmm_bf16_to_float(trmm_half_t h) {
+  return trmm_bits_float((uint32_t)h << 16);
+}
+
+TRMM_INLINE trmm_half_t trmm_float_to_fp16(float x) {
+#if TRMM_HAVE_F16C
+  return (trmm_half_t)_cvtss_sh(x, _MM_FROUND_TO_NEAREST_INT);
+#else
+  uint32_t u = trmm_float_bits(x);
+  uint32_t sign = (u >> 16) & 0x8000u;
+  uint32_t abs = u & 0x7fffffffu;
+  if (abs > 0x7f800000u) return (trmm_half_t)(sign | 0x7e00u);  // NaN
+  if (abs >= 0x477ff000u) return (trmm_half_t)(sign | 0x7c00u);  // overflow
+  if (abs < 0x38800000u) {
+    // subnormal: round the value scaled by 2^24 to an integer
+    float scaled = trmm_bits_float(abs) * 16777216.0f;
+    return (trmm_half_t)(sign | (uint32_t)__builtin_rintf(scaled));
+  }
+  // normal: rebias the exponent, round the mantissa to 10 bits
+  abs += ((uint32_t)(15 - 127) << 23) + 0xfffu + ((abs >> 13) & 1u);
+  return (trmm_half_t)(sign | (abs >> 13));
+#endif
+}
+
+TRMM_INLINE float trmm_fp16_to_float(trmm_half_t h) {
+#if TRMM_HAVE_F16C
+  return _cvtsh_ss(h);
+#else
+  uint32_t sign = (uint32_t)(h & 0x8000u) << 16;
+  uint32_t exponent = (h >> 10) & 0x1fu;
+  uint32_t mantissa = h & 0x3ffu;
+  if (exponent == 0) {
+    // zero or subnormal: mantissa * 2^-24
+    float value = (float)mantissa * (1.0f / 16777216.0f);
+    return trmm_bits_float(trmm_float_bits(value) | sign);
+  }
+  if (exponent == 31) {
+    return trmm_bits_float(sign | 0x7f800000u | (mantissa << 13));
+  }
+  return trmm_bits_float(sign | ((exponent + 127 - 15) << 23) |
+                         (mantissa << 13));
+#endif
+}
+
+TRMM_INLINE trmm_half_t trmm_float_to_half(int format, float x) {
+  return format == TRMM_FP16 ? trmm_float_to_fp16(x) : trmm_float_to_bf16(x);
+}
+
+TRMM_INLINE float trmm_half_to_float(int format, trmm_half_t h) {
+  return format == TRMM_FP16 ? trmm_fp16_to_float(h) : trmm_bf16_to_float(h);
+}
+
+// dst[i] = x[i] rounded to the format, for n elements
+static inline void trmm_float_to_half_n(int format, size_t n, const float *x,
+                                        trmm_half_t *dst) {
+  size_t i = 0;
+#if TRMM_HAVE_AVX2 && TRMM_HAVE_F16C
+  if (format == TRMM_FP16) {
+    for (; i + 8 <= n; i += 8) {
+      _mm_storeu_si128((__m128i *)(dst + i),
+                       _mm256_cvtps_ph(_mm256_loadu_ps(x + i),
+                                       _MM_FROUND_TO_NEAREST_INT));
+    }
+  }
+#endif
+  for (; i < n; i++) dst[i] = trmm_float_to_half(format, x[i]);
+}
+
+// dst[i] = x[i] widened to fp32, for n elements
+static inline void trmm_half_to_float_n(int format, size_t n,
+                                        const trmm_half_t *x, float *dst) {
+  size_t i = 0;
+#if TRMM_HAVE_AVX2 && TRMM_HAVE_F16C
+  if (format == TRMM_FP16) {
+    for (; i + 8 <= n; i += 8) {
+      __m128i raw = _mm_loadu_si128((const __m128i *)(x + i));
+      _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(raw));
+    }
+  }
+#endif
+  for (; i < n; i++) dst[i] = trmm_half_to_float(format, x[i]);
+}
+
+#if TRMM_HAVE_AVX2
+
+// 8 consecutive 16-bit values widened to fp32
+TRMM_INLINE __m256 trmm_half_load8(int format, const trmm_half_t *h) {
+  __m128i raw = _mm_loadu_si128((const __m128i *)h);
+#if TRMM_HAVE_F16C
+  if (format == TRMM_FP16) return _mm256_cvtph_ps(raw);
+#else
+  if (format == TRMM_FP16) {
+    float x[8];
+    for (int l = 0; l < 8; l++) x[l] = trmm_fp16_to_float(h[l]);
+    return _mm256_loadu_ps(x);
+  }
+#endif
+  return _mm256_castsi256_ps(
+      _mm256_slli_epi32(_mm256_cvtepu16_epi32(raw), 16));
+}
+
+// the first n (0..16) of 16 consecutive 16-bit values widened to fp32 into
+// v[0] and v[1], the lanes past n zero; AVX2 has no 16-bit masked load, so
+// a partial row is copied into a zero-padded one first
+TRMM_INLINE void trmm_half_load16(int format, const trmm_half_t *h, int n,
+                                  __m256 *v) {
+  if (n == 16) {
+    v[0] = trmm_half_load8(format, h);
+    v[1] = trmm_half_load8(format, h + 8);
+    return;
+  }
+  trmm_half_t padded[16] = {0};
+  memcpy(padded, h, (size_t)n * sizeof(trmm_half_t));
+  v[0] = trmm_half_load8(format, padded);
+  v[1] = trmm_half_load8(format, padded + 8);
+}
+
+#endif  // TRMM_HAVE_AVX2
+
+#endif /* TRMM_HALF_H */
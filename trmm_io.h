@@ -0,0 +1,308 @@
+#ifndef TRMM_IO_H
+#define TRMM_IO_H
+
+#include <mpi.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trmm_layout.h"
+#include "trmm_mpi.h"
+#include "trmm_packed.h"
+
+/*
+Binary matrix files read and written in parallel with MPI-IO
+
+A file is a TRMM_IO_HEADER_BYTES header followed by the elements:
+
+  offset  bytes  field
+  0       4      magic "TRMM"
+  4       4      version (1)
+  8       8      rows
+  16      8      cols
+  24      4      layout: TRMM_ROW_MAJOR or TRMM_COL_MAJOR (trmm_layout.h)
+  28      4      precision: bytes per element (4 = fp32, 2 = bf16/fp16)
+  32      4      storage: TRMM_IO_FULL or TRMM_IO_PACKED_LOWER
+  36      28     reserved, zero
+
+Fields are in the byte order of the machine that wrote the file (the
+"native" MPI-IO representation). Full storage holds rows x cols elements
+in the given layout. Packed storage holds the lower triangle of a square
+matrix row after row (trmm_packed.h), so rows [i0, i1) are one contiguous
+range either way. The helpers below move fp32 elements; a 16-bit file is
+recognized by its header but not read.
+
+Every data call is collective over the communicator the file was opened
+on. Each rank passes its own slice, possibly empty, and only ever holds
+that slice, so no rank stages the whole matrix:
+
+  trmm_io_read_rows / write_rows    rows [row0, row0 + rows) of a row major
+                                    or packed file, MPI_File_read_at_all /
+                                    MPI_File_write_at_all at their offset
+  trmm_io_read_block / write_block  any block of a full matrix, through a
+                                    subarray file view and
+                                    MPI_File_read_all / MPI_File_write_all;
+                                    the block is stored in the layout of
+                                    the file with its own leading dimension
+
+Counts beyond INT_MAX go through the derived types of trmm_mpi.h. Calls
+return MPI_SUCCESS, an MPI error code, or -1 when the header does not
+allow the request (wrong storage, layout or precision).
+*/
+
+#define TRMM_IO_HEADER_BYTES 64
+#define TRMM_IO_VERSION 1
+
+#define TRMM_IO_FULL 0
+#define TRMM_IO_PACKED_LOWER 1
+
+typedef struct {
+  char magic[4];
+  int32_t version;
+  int64_t rows;
+  int64_t cols;
+  int32_t layout;
+  int32_t precision;
+  int32_t storage;
+  int32_t reserved[7];
+} trmm_io_header_t;
+
+typedef char trmm_io_header_size_check
+    [sizeof(trmm_io_header_t) == TRMM_IO_HEADER_BYTES ? 1 : -1];
+
+static inline void trmm_io_header_init(trmm_io_header_t *header, int rows,
+                                       int cols, int layout, int storage) {
+  memset(header, 0, sizeof(*header));
+  memcpy(header->magic, "TRMM", 4);
+  header->version = TRMM_IO_VERSION;
+  header->rows = rows;
+  header->cols = cols;
+  header->layout = layout;
+  header->precision = (int32_t)sizeof(float);
+  header->storage = storage;
+}
+
+// elements stored in the file
+static inline size_t trmm_io_elements(const trmm_io_header_t *header) {
+  if (header->storage == TRMM_IO_PACKED_LOWER) {
+    return TRMM_PACKED_SIZE(header->rows);
+  }
+  return (size_t)header->rows * header->cols;
+}
+
+// create (or truncate) a file and write its header from the first rank
+static inline int trmm_io_create(MPI_Comm comm, const char *path,
+                                 const trmm_io_header_t *header,
+                                 MPI_File *file) {
+  int rid;
+  MPI_Comm_rank(comm, &rid);
+  int err = MPI_File_open(comm, path, MPI_MODE_CREATE | MPI_MODE_RDWR,
+                          MPI_INFO_NULL, file);
+  if (err != MPI_SUCCESS) return err;
+  err = MPI_File_set_size(*file, 0);
+  if (err == MPI_SUCCESS && rid == 0) {
+    err = MPI_File_write_at(*file, 0, header, TRMM_IO_HEADER_BYTES, MPI_BYTE,
+                            MPI_STATUS_IGNORE);
+  }
+  return err;
+}
+
+// open a file and read its header on the first rank, shared with all ranks
+static inline int trmm_io_open(MPI_Comm comm, const char *path, int amode,
+                               trmm_io_header_t *header, MPI_File *file) {
+  int rid;
+  MPI_Comm_rank(comm, &rid);
+  int err = MPI_File_open(comm, path, amode, MPI_INFO_NULL, file);
+  if (err != MPI_SUCCESS) return err;
+  if (rid == 0) {
+    err = MPI_File_read_at(*file, 0, header, TRMM_IO_HEADER_BYTES, MPI_BYTE,
+                           MPI_STATUS_IGNORE);
+  }
+  MPI_Bcast(&err, 1, MPI_INT, 0, comm);
+  if (err == MPI_SUCCESS) {
+    MPI_Bcast(header, TRMM_IO_HEADER_BYTES, MPI_BYTE, 0, comm);
+    if (memcmp(header->magic, "TRMM", 4) != 0 ||
+        header->version != TRMM_IO_VERSION) {
+      err = -1;
+    }
+  }
+  // the caller only closes files that were opened successfully
+  if (err != MPI_SUCCESS) MPI_File_close(file);
+  return err;
+}
+
+// first element and number of elements of rows [row0, row0 + rows)
+static inline int trmm_io_row_range(const trmm_io_header_t *header,
+                                    int row0, int rows, size_t *first,
+                                    size_t *count) {
+  if (header->precision != (int32_t)sizeof(float)) return -1;
+  if (header->storage == TRMM_IO_PACKED_LOWER) {
+    *first = TRMM_PACKED_ROW(row0);
+    *count = TRMM_PACKED_ROW(row0 + rows) - *first;
+    return 0;
+  }
+  if (header->layout != TRMM_ROW_MAJOR) return -1;
+  *first = (size_t)row0 * header->cols;
+  *count = (size_t)rows * header->cols;
+  return 0;
+}
+
+static inline int trmm_io_read_rows(MPI_File file,
+                                    const trmm_io_header_t *header, int row0,
+                                    int rows, float *buffer) {
+  size_t first, count;
+  int bad = trmm_io_row_range(header, row0, rows, &first, &count);
+  if (bad) first = count = 0;  // still take part in the collective
+
+  MPI_Datatype type;
+  int type_count;
+  trmm_mpi_count_type(count, MPI_FLOAT, &type, &type_count);
+  MPI_Offset offset =
+      TRMM_IO_HEADER_BYTES + (MPI_Offset)(first * sizeof(float));
+  int err = MPI_File_read_at_all(file, offset, buffer, type_count, type,
+                                 MPI_STATUS_IGNORE);
+  trmm_mpi_type_release(MPI_FLOAT, &type);
+  return bad ? -1 : err;
+}
+
+static inline int trmm_io_write_rows(MPI_File file,
+                                     const trmm_io_header_t *header,
+                                     int row0, int rows, const float *buffer) {
+  size_t first, count;
+  int bad = trmm_io_row_range(header, row0, rows, &first, &count);
+  if (bad) first = count = 0;
+
+  MPI_Datatype type;
+  int type_count;
+  trmm_mpi_count_type(count, MPI_FLOAT, &type, &type_count);
+  MPI_Offset offset =
+      TRMM_IO_HEADER_BYTES + (MPI_Offset)(first * sizeof(float));
+  int err = MPI_File_write_at_all(file, offset, buffer, type_count, type,
+                                  MPI_STATUS_IGNORE);
+  trmm_mpi_type_release(MPI_FLOAT, &type);
+  return bad ? -1 : err;
+}
+
+// file view selecting a block of a full matrix (every rank sets its own,
+// an empty block selects nothing)
+static inline int trmm_io_block_view(MPI_File file,
+                                     const trmm_io_header_t *header, int row0,
+                                     int rows, int col0, int cols,
+                                     size_t *count) {
+  int bad = header->storage != TRMM_IO_FULL ||
+            header->precision != (int32_t)sizeof(float);
+  *count = bad ? 0 : (size_t)rows * cols;
+
+  MPI_Datatype view = MPI_FLOAT;
+  if (*count > 0) {
+    int sizes[2] = {(int)header->rows, (int)header->cols};
+    int subsizes[2] = {rows, cols};
+    int starts[2] = {row0, col0};
+    int order =
+        header->layout == TRMM_COL_MAJOR ? MPI_ORDER_FORTRAN : MPI_ORDER_C;
+    MPI_Type_create_subarray(2, sizes, subsizes, starts, order, MPI_FLOAT,
+                             &view);
+    MPI_Type_commit(&view);
+  }
+  int err = MPI_File_set_view(file, TRMM_IO_HEADER_BYTES, MPI_FLOAT, view,
+                              "native", MPI_INFO_NULL);
+  if (view != MPI_FLOAT) MPI_Type_free(&view);
+  return bad ? -1 : err;
+}
+
+// back to the byte view the offsets of the row calls are relative to
+static inline void trmm_io_reset_view(MPI_File file) {
+  MPI_File_set_view(file, 0, MPI_BYTE, MPI_BYTE, "native", MPI_INFO_NULL);
+}
+
+static inline int trmm_io_read_block(MPI_File file,
+                                     const trmm_io_header_t *header,
+                                     int row0, int rows, int col0, int cols,
+                                     float *buffer) {
+  size_t count;
+  int err = trmm_io_block_view(file, header, row0, rows, col0, cols, &count);
+  MPI_Datatype type;
+  int type_count;
+  trmm_mpi_count_type(count, MPI_FLOAT, &type, &type_count);
+  int read_err =
+      MPI_File_read_all(file, buffer, type_count, type, MPI_STATUS_IGNORE);
+  trmm_mpi_type_release(MPI_FLOAT, &type);
+  trmm_io_reset_view(file);
+  return err != MPI_SUCCESS ? err : read_err;
+}
+
+static inline int trmm_io_write_block(MPI_File file,
+                                      const trmm_io_header_t *header,
+                                      int row0, int rows, int col0, int cols,
+                                      const float *buffer) {
+  size_t count;
+  int err = trmm_io_block_view(file, header, row0, rows, col0, cols, &count);
+  MPI_Datatype type;
+  int type_count;
+  trmm_mpi_count_type(count, MPI_FLOAT, &type, &type_count);
+  int write_err =
+      MPI_File_write_all(file, buffer, type_count, type, MPI_STATUS_IGNORE);
+  trmm_mpi_type_release(MPI_FLOAT, &type);
+  trmm_io_reset_view(file);
+  return err != MPI_SUCCESS ? err : write_err;
+}
+
+// uniform value in [0, 1) that only depends on seed and index (splitmix64)
+static inline float trmm_io_random_value(uint64_t seed, uint64_t index) {
+  uint64_t z = seed + (index + 1) * 0x9e3779b97f4a7c15ull;
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  z ^= z >> 31;
+  return (float)(z >> 40) / 16777216.0f;
+}
+
+// create a row major or packed file of random values: every rank generates
+// and writes an even share of the rows, and the contents do not depend on
+// the number of ranks
+static inline int trmm_io_write_random(MPI_Comm comm, const char *path,
+                                       const trmm_io_header_t *header,
+                                       uint64_t seed) {
+  int rid, num_ranks;
+  MPI_Comm_rank(comm, &rid);
+  MPI_Comm_size(comm, &num_ranks);
+  int row0 = (int)(header->rows * rid / num_ranks);
+  int row1 = (int)(header->rows * (rid + 1) / num_ranks);
+
+  size_t first, count;
+  if (trmm_io_row_range(header, row0, row1 - row0, &first, &count) != 0) {
+    return -1;
+  }
+  float *buffer = (float *)malloc((count + 1) * sizeof(float));
+  if (buffer == NULL) return MPI_ERR_NO_MEM;
+  for (size_t i = 0; i < count; i++) {
+    buffer[i] = trmm_io_random_value(seed, first + i);
+  }
+
+  MPI_File file;
+  int err = trmm_io_create(comm, path, header, &file);
+  if (err == MPI_SUCCESS) {
+    err = trmm_io_write_rows(file, header, row0, row1 - row0, buffer);
+    MPI_File_close(&file);
+  }
+  free(buffer);
+  return err;
+}
+
+// report a failed call on the calling rank and abort
+static inline void trmm_io_check(int err, const char *what, const char *path) {
+  if (err == MPI_SUCCESS) return;
+  int rid;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+  if (err < 0) {
+    printf("Rank %d: %s: unsupported matrix file %s\n", rid, what, path);
+  } else {
+    char message[MPI_MAX_ERROR_STRING];
+    int length;
+    MPI_Error_string(err, message, &length);
+    printf("Rank %d: %s failed for %s: %s\n", rid, what, path, message);
+  }
+  MPI_Abort(MPI_COMM_WORLD, 1);
+}
+
+#endif /* TRMM_IO_H */
@@ -0,0 +1,290 @@
+#ifndef TRMM_KERNELS_H
+#define TRMM_KERNELS_H
+
+/*
+Register-blocked micro-kernels for the lower triangular multiply C = A * B
+
+A tile of C is TRMM_MR rows by TRMM_NR columns and lives entirely in
+registers while the k loop runs: every step broadcasts one element of A per
+row, streams one row of B and accumulates with FMA. Tiles that sit on the
+diagonal of A stop each row at its own diagonal element, and tiles on the
+right edge of C use masked loads/stores, so no scalar cleanup loop is needed.
+
+All matrices are stored in Row Major Order. Dimensions and row strides are
+int, offsets into a matrix are computed in size_t so that matrices past
+2^31 elements can be addressed.
+*/
+
+#include <stddef.h>
+
+#include "trmm_packed.h"
+
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#define TRMM_HAVE_AVX2 1
+#else
+#define TRMM_HAVE_AVX2 0
+#endif
+
+#define TRMM_MR 6
+#define TRMM_NR 16
+
+#define TRMM_INLINE static inline __attribute__((always_inline))
+
+#if TRMM_HAVE_AVX2
+
+// lane mask with the first n (0..8) lanes enabled
+TRMM_INLINE __m256i trmm_lane_mask(int n) {
+  const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+  return _mm256_cmpgt_epi32(_mm256_set1_epi32(n), lanes);
+}
+
+TRMM_INLINE void trmm_ukr_avx2_body(int mr, int nr, int kc, int tri,
+                                    const float *const *a, const float *B,
+                                    int rs_B, float *C, int rs_C,
+                                    int accumulate, const int full) {
+  __m256 c[TRMM_MR][2];
+  __m256i mask_lo = trmm_lane_mask(nr);
+  __m256i mask_hi = trmm_lane_mask(nr - 8);
+
+  for (int r = 0; r < TRMM_MR; r++) {
+    c[r][0] = _mm256_setzero_ps();
+    c[r][1] = _mm256_setzero_ps();
+  }
+
+  // every row of the tile is active while k is left of the first diagonal
+  int k_full = tri ? kc - mr + 1 : kc;
+
+  for (int k = 0; k < k_full; k++) {
+    const float *b = B + (size_t)k * rs_B;
+    __m256 b0 = full ? _mm256_loadu_ps(b) : _mm256_maskload_ps(b, mask_lo);
+    __m256 b1 =
+        full ? _mm256_loadu_ps(b + 8) : _mm256_maskload_ps(b + 8, mask_hi);
+    for (int r = 0; r < TRMM_MR; r++) {
+      if (r < mr) {
+        __m256 a_r = _mm256_broadcast_ss(a[r] + k);
+        c[r][0] = _mm256_fmadd_ps(a_r, b0, c[r][0]);
+        c[r][1] = _mm256_fmadd_ps(a_r, b1, c[r][1]);
+      }
+    }
+  }
+
+  // diagonal triangle: row r stops after column k_full + r - 1
+  for (int k = k_full; k < kc; k++) {
+    const float *b = B + (size_t)k * rs_B;
+    __m256 b0 = full ? _mm256_loadu_ps(b) : _mm256_maskload_ps(b, mask_lo);
+    __m256 b1 =
+        full ? _mm256_loadu_ps(b + 8) : _mm256_maskload_ps(b + 8, mask_hi);
+    for (int r = 0; r < TRMM_MR; r++) {
+      if (r < mr && r > k - k_full) {
+        __m256 a_r = _mm256_broadcast_ss(a[r] + k);
+        c[r][0] = _mm256_fmadd_ps(a_r, b0, c[r][0]);
+        c[r][1] = _mm256_fmadd_ps(a_r, b1, c[r][1]);
+      }
+    }
+  }
+
+  for (int r = 0; r < TRMM_MR; r++) {
+    if (r < mr) {
+      float *c_row = C + (size_t)r * rs_C;
+      if (full) {
+        if (accumulate) {
+          c[r][0] = _mm256_add_ps(c[r][0], _mm256_loadu_ps(c_row));
+          c[r][1] = _mm256_add_ps(c[r][1], _mm256_loadu_ps(c_row + 8));
+        }
+        _mm256_storeu_ps(c_row, c[r][0]);
+        _mm256_storeu_ps(c_row + 8, c[r][1]);
+      } else {
+        if (accumulate) {
+          c[r][0] =
+              _mm256_add_ps(c[r][0], _mm256_maskload_ps(c_row, mask_lo));
+          c[r][1] =
+              _mm256_add_ps(c[r][1], _mm256_maskload_ps(c_row + 8, mask_hi));
+        }
+        _mm256_maskstore_ps(c_row, mask_lo, c[r][0]);
+        _mm256_maskstore_ps(c_row + 8, mask_hi, c[r][1]);
+      }
+    }
+  }
+}
+
+#endif  // TRMM_HAVE_AVX2
+
+/*
+Computes one mr x nr tile of C (mr <= TRMM_MR, nr <= TRMM_NR)
+
+  C[r][0:nr] (+)= sum over k < kc_r of a[r][k] * B[k][0:nr]
+
+a[r] points at the first A element used by row r of the tile and B at the
+matching row of B. kc_r is kc for a rectangular tile; when tri is set the
+tile ends on the diagonal of A and kc_r = kc - mr + 1 + r, so no element
+above the diagonal is ever read. accumulate selects C += over C =.
+*/
+static inline void trmm_ukr(int mr, int nr, int kc, int tri,
+                            const float *const *a, const float *B, int rs_B,
+                            float *C, int rs_C, int accumulate) {
+#if TRMM_HAVE_AVX2
+  if (nr == TRMM_NR)
+    trmm_ukr_avx2_body(mr, nr, kc, tri, a, B, rs_B, C, rs_C, accumulate, 1);
+  else
+    trmm_ukr_avx2_body(mr, nr, kc, tri, a, B, rs_B, C, rs_C, accumulate, 0);
+#else
+  for (int r = 0; r < mr; r++) {
+    int kc_r = tri ? kc - mr + 1 + r : kc;
+    for (int j = 0; j < nr; j++) {
+      float sum = accumulate ? C[(size_t)r * rs_C + j] : 0.0f;
+      for (int k = 0; k < kc_r; k++) {
+        sum += a[r][k] * B[(size_t)k * rs_B + j];
+      }
+      C[(size_t)r * rs_C + j] = sum;
+    }
+  }
+#endif
+}
+
+/*
+Micro-kernel on packed panels: C (mr x nr) += a_panel * b_panel
+
+a_panel holds kc columns of TRMM_MR values (column k at a_panel + k *
+TRMM_MR) and b_panel kc rows of TRMM_NR values (row k at b_panel + k *
+TRMM_NR, 32-byte aligned). Both are zero padded to the full tile, so the k
+loop never branches; the triangle of A is respected by the zeros the
+packing routine stores above the diagonal. Only the mr x nr corner of the
+tile is written back to C.
+*/
+static inline void trmm_ukr_packed(int mr, int nr, int kc,
+                                   const float *a_panel,
+                                   const float *b_panel, float *C, int rs_C) {
+#if TRMM_HAVE_AVX2
+  __m256 c[TRMM_MR][2];
+  __m256i mask_lo = trmm_lane_mask(nr);
+  __m256i mask_hi = trmm_lane_mask(nr - 8);
+
+  for (int r = 0; r < TRMM_MR; r++) {
+    c[r][0] = _mm256_setzero_ps();
+    c[r][1] = _mm256_setzero_ps();
+  }
+
+  for (int k = 0; k < kc; k++) {
+    __m256 b0 = _mm256_load_ps(b_panel + k * TRMM_NR);
+    __m256 b1 = _mm256_load_ps(b_panel + k * TRMM_NR + 8);
+    const float *a = a_panel + k * TRMM_MR;
+    for (int r = 0; r < TRMM_MR; r++) {
+      __m256 a_r = _mm256_broadcast_ss(a + r);
+      c[r][0] = _mm256_fmadd_ps(a_r, b0, c[r][0]);
+      c[r][1] = _mm256_fmadd_ps(a_r, b1, c[r][1]);
+    }
+  }
+
+  for (int r = 0; r < mr; r++) {
+    float *c_row = C + (size_t)r * rs_C;
+    if (nr == TRMM_NR) {
+      _mm256_storeu_ps(c_row, _mm256_add_ps(c[r][0], _mm256_loadu_ps(c_row)));
+      _mm256_storeu_ps(c_row + 8,
+                       _mm256_add_ps(c[r][1], _mm256_loadu_ps(c_row + 8)));
+    } else {
+      _mm256_maskstore_ps(
+          c_row, mask_lo,
+          _mm256_add_ps(c[r][0], _mm256_maskload_ps(c_row, mask_lo)));
+      _mm256_maskstore_ps(
+          c_row + 8, mask_hi,
+          _mm256_add_ps(c[r][1], _mm256_maskload_ps(c_row + 8, mask_hi)));
+    }
+  }
+#else
+  for (int r = 0; r < mr; r++) {
+    for (int j = 0; j < nr; j++) {
+      float sum = 0.0f;
+      for (int k = 0; k < kc; k++) {
+        sum += a_panel[k * TRMM_MR + r] * b_panel[k * TRMM_NR + j];
+      }
+      C[(size_t)r * rs_C + j] += sum;
+    }
+  }
+#endif
+}
+
+// row drivers below: shared loop nest over TRMM_MR x TRMM_NR tiles of C
+// (with OpenMP and parallel set the row tiles are shared by the thread team
+// of the rank; lower tiles cost more, hence the dynamic schedule)
+TRMM_INLINE void trmm_lower_rows_body(int row_start, int row_end, int n0,
+                                      const float *A, int rs_A, int packed,
+                                      const float *B, int rs_B, float *C,
+                                      int rs_C, int parallel) {
+#pragma omp parallel for schedule(dynamic) if (parallel)
+  for (int i = row_start; i < row_end; i += TRMM_MR) {
+    const float *a[TRMM_MR];
+    int mr = row_end - i < TRMM_MR ? row_end - i : TRMM_MR;
+    for (int r = 0; r < mr; r++) {
+      int row = i + r;
+      a[r] = packed ? A + TRMM_PACKED_ROW(row) : A + (size_t)row * rs_A;
+    }
+
+    for (int j = 0; j < n0; j += TRMM_NR) {
+      int nr = n0 - j < TRMM_NR ? n0 - j : TRMM_NR;
+      trmm_ukr(mr, nr, i + mr, 1, a, B + j, rs_B,
+               C + (size_t)(i - row_start) * rs_C + j, rs_C, 0);
+    }
+  }
+}
+
+/*
+Rows [row_start, row_end) of C = A * B for a lower triangular A
+
+A row i starts at A + i * rs_A, B is m0 x n0 with row stride rs_B and C
+points at row row_start of the output, so a rank can write straight into a
+local buffer that only holds its own rows.
+*/
+static inline void trmm_lower_rows(int row_start, int row_end, int n0,
+                                   const float *A, int rs_A, const float *B,
+                                   int rs_B, float *C, int rs_C) {
+  trmm_lower_rows_body(row_start, row_end, n0, A, rs_A, 0, B, rs_B, C, rs_C,
+                       1);
+}
+
+// same as trmm_lower_rows with A in packed lower triangular storage
+static inline void trmm_lower_rows_packed(int row_start, int row_end, int n0,
+                                          const float *A_packed,
+                                          const float *B, int rs_B, float *C,
+                                          int rs_C) {
+  trmm_lower_rows_body(row_start, row_end, n0, A_packed, 0, 1, B, rs_B, C,
+                       rs_C, 1);
+}
+
+/*
+C = A * B for one small m0 x n0 problem on the calling thread
+
+Same tiles as trmm_lower_rows without a parallel region, for callers that
+already share whole problems between threads (batched multiplies).
+*/
+static inline void trmm_lower_small(int m0, int n0, const float *A, int rs_A,
+                                    const float *B, int rs_B, float *C,
+                                    int rs_C) {
+  trmm_lower_rows_body(0, m0, n0, A, rs_A, 0, B, rs_B, C, rs_C, 0);
+}
+
+/*
+C (m x n) += A (m x k) * B (k x n)
+
+With tri set A is a square lower triangular block on the diagonal (m == k)
+and row i only reads A[i][0..i]; otherwise A is a dense block.
+*/
+static inline void trmm_block_acc(int m, int n, int k, int tri,
+                                  const float *A, int rs_A, const float *B,
+                                  int rs_B, float *C, int rs_C) {
+  const float *a[TRMM_MR];
+
+  for (int i = 0; i < m; i += TRMM_MR) {
+    int mr = m - i < TRMM_MR ? m - i : TRMM_MR;
+    for (int r = 0; r < mr; r++) a[r] = A + (size_t)(i + r) * rs_A;
+    int kc = tri ? i + mr : k;
+
+    for (int j = 0; j < n; j += TRMM_NR) {
+      int nr = n - j < TRMM_NR ? n - j : TRMM_NR;
+      trmm_ukr(mr, nr, kc, tri, a, B + j, rs_B, C + (size_t)i * rs_C + j,
+               rs_C, 1);
+    }
+  }
+}
+
+#endif /* TRMM_KERNELS_H */
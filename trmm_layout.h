@@ -0,0 +1,49 @@
+#ifndef TRMM_LAYOUT_H
+#define TRMM_LAYOUT_H
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+Storage layout of the matrices passed to the strided entry points
+
+A rows x cols matrix X with leading dimension ld is stored as
+
+  TRMM_ROW_MAJOR   X(i, j) = X[i * ld + j]      ld >= cols
+  TRMM_COL_MAJOR   X(i, j) = X[i + j * ld]      ld >= rows
+
+so a submatrix of a larger array is passed as a pointer to its first
+element and the leading dimension of the enclosing array. The layout of a
+run is selected with the TRMM_LAYOUT environment variable (row or col).
+*/
+
+#define TRMM_ROW_MAJOR 0
+#define TRMM_COL_MAJOR 1
+
+static const char *trmm_layout_names[] = {"row", "col"};
+
+// row and column strides of a matrix with leading dimension ld (size_t, so
+// that i * rs + j * cs does not overflow past 2^31 elements)
+static inline void trmm_layout_strides(int layout, int ld, size_t *rs,
+                                       size_t *cs) {
+  *rs = layout == TRMM_COL_MAJOR ? 1 : (size_t)ld;
+  *cs = layout == TRMM_COL_MAJOR ? (size_t)ld : 1;
+}
+
+// smallest leading dimension of a rows x cols matrix
+static inline int trmm_layout_min_ld(int layout, int rows, int cols) {
+  return layout == TRMM_COL_MAJOR ? rows : cols;
+}
+
+// layout requested through TRMM_LAYOUT, -1 when it is not set or unknown
+static inline int trmm_layout_from_env(void) {
+  const char *layout = getenv("TRMM_LAYOUT");
+  if (layout == NULL) return -1;
+  for (int l = 0; l < 2; l++) {
+    if (strcmp(layout, trmm_layout_names[l]) == 0) return l;
+  }
+  return -1;
+}
+
+#endif /* TRMM_LAYOUT_H */
@@ -0,0 +1,115 @@
+#ifndef TRMM_MPI_H
+#define TRMM_MPI_H
+
+#include <limits.h>
+#include <mpi.h>
+#include <stddef.h>
+
+/*
+Large-count transfers
+
+MPI counts and displacements are int, so one call moves at most 2^31 - 1
+elements: a 46341 x 46341 matrix of floats is already past that, and
+Open MPI 4.1 has no MPI-4 large-count (_c) calls. The helpers below take a
+size_t count. A count that fits in an int is passed through unchanged;
+a larger one is described by one derived datatype made of
+TRMM_MPI_CHUNK-element blocks plus a remainder block, so the transfer is
+still a single message with a single request and both sides may use
+different counts as long as the type signatures match.
+
+The derived type is freed as soon as the call is posted; MPI keeps it
+alive until pending requests that use it complete.
+*/
+
+#define TRMM_MPI_CHUNK ((size_t)1 << 30)
+
+// (*big_type, *big_count) describes count elements of type
+static inline void trmm_mpi_count_type(size_t count, MPI_Datatype type,
+                                       MPI_Datatype *big_type,
+                                       int *big_count) {
+  if (count <= INT_MAX) {
+    *big_type = type;
+    *big_count = (int)count;
+    return;
+  }
+
+  size_t blocks = count / TRMM_MPI_CHUNK;
+  size_t rest = count % TRMM_MPI_CHUNK;
+  MPI_Datatype chunk, body;
+  MPI_Type_contiguous((int)TRMM_MPI_CHUNK, type, &chunk);
+  MPI_Type_contiguous((int)blocks, chunk, &body);
+
+  if (rest == 0) {
+    *big_type = body;
+  } else {
+    MPI_Aint lb, extent;
+    MPI_Type_get_extent(type, &lb, &extent);
+    MPI_Datatype tail;
+    MPI_Type_contiguous((int)rest, type, &tail);
+    int lengths[2] = {1, 1};
+    MPI_Aint displs[2] = {0, (MPI_Aint)(blocks * TRMM_MPI_CHUNK) * extent};
+    MPI_Datatype types[2] = {body, tail};
+    MPI_Type_create_struct(2, lengths, displs, types, big_type);
+    MPI_Type_free(&tail);
+    MPI_Type_free(&body);
+  }
+  MPI_Type_free(&chunk);
+  MPI_Type_commit(big_type);
+  *big_count = 1;
+}
+
+// free a type made by trmm_mpi_count_type (plain types are left alone)
+static inline void trmm_mpi_type_release(MPI_Datatype type,
+                                         MPI_Datatype *big_type) {
+  if (*big_type != type) MPI_Type_free(big_type);
+}
+
+static inline void trmm_mpi_send(const void *buf, size_t count,
+                                 MPI_Datatype type, int dest, int tag,
+                                 MPI_Comm comm) {
+  MPI_Datatype big_type;
+  int big_count;
+  trmm_mpi_count_type(count, type, &big_type, &big_count);
+  MPI_Send(buf, big_count, big_type, dest, tag, comm);
+  trmm_mpi_type_release(type, &big_type);
+}
+
+static inline void trmm_mpi_recv(void *buf, size_t count, MPI_Datatype type,
+                                 int source, int tag, MPI_Comm comm) {
+  MPI_Datatype big_type;
+  int big_count;
+  trmm_mpi_count_type(count, type, &big_type, &big_count);
+  MPI_Recv(buf, big_count, big_type, source, tag, comm, MPI_STATUS_IGNORE);
+  trmm_mpi_type_release(type, &big_type);
+}
+
+static inline void trmm_mpi_isend(const void *buf, size_t count,
+                                  MPI_Datatype type, int dest, int tag,
+                                  MPI_Comm comm, MPI_Request *request) {
+  MPI_Datatype big_type;
+  int big_count;
+  trmm_mpi_count_type(count, type, &big_type, &big_count);
+  MPI_Isend(buf, big_count, big_type, dest, tag, comm, request);
+  trmm_mpi_type_release(type, &big_type);
+}
+
+static inline void trmm_mpi_irecv(void *buf, size_t count, MPI_Datatype type,
+                                  int source, int tag, MPI_Comm comm,
+                                  MPI_Request *request) {
+  MPI_Datatype big_type;
+  int big_count;
+  trmm_mpi_count_type(count, type, &big_type, &big_count);
+  MPI_Irecv(buf, big_count, big_type, source, tag, comm, request);
+  trmm_mpi_type_release(type, &big_type);
+}
+
+static inline void trmm_mpi_bcast(void *buf, size_t count, MPI_Datatype type,
+                                  int root, MPI_Comm comm) {
+  MPI_Datatype big_type;
+  int big_count;
+  trmm_mpi_count_type(count, type, &big_type, &big_count);
+  MPI_Bcast(buf, big_count, big_type, root, comm);
+  trmm_mpi_type_release(type, &big_type);
+}
+
+#endif /* TRMM_MPI_H */
@@ -0,0 +1,52 @@
+#ifndef TRMM_PACKED_H
+#define TRMM_PACKED_H
+
+#include <stddef.h>
+#include <string.h>
+
+/*
+Packed storage for the lower triangular matrix A
+
+Only the m0 * (m0 + 1) / 2 elements on or below the diagonal are stored,
+row after row: row i holds its i + 1 elements A[i][0..i] and starts at
+offset i * (i + 1) / 2. Rows stay contiguous, so a block of consecutive
+rows is also one contiguous range of the packed buffer.
+*/
+
+// number of elements in a packed m0 x m0 lower triangle (size_t: the
+// triangle passes 2^31 elements from m0 = 65536 on)
+#define TRMM_PACKED_SIZE(m0) ((size_t)(m0) * ((m0) + 1) / 2)
+
+// offset of the first element of row i in the packed buffer
+#define TRMM_PACKED_ROW(i) ((size_t)(i) * ((i) + 1) / 2)
+
+// copy the lower triangle of the row major matrix A into packed storage
+static inline void pack_lower_triangular(int m0, const float *A, int rs_A,
+                                         float *A_packed) {
+  for (int i = 0; i < m0; i++) {
+    const float *a_row = A + (size_t)i * rs_A;
+    float *p_row = A_packed + TRMM_PACKED_ROW(i);
+    for (int j = 0; j <= i; j++) {
+      p_row[j] = a_row[j];
+    }
+  }
+}
+
+// offset of row i of a lower triangular A that is either row major with m0
+// columns or, if packed is set, already in packed storage
+static inline size_t lower_row_offset(int m0, int packed, int i) {
+  return packed ? TRMM_PACKED_ROW(i) : (size_t)i * m0;
+}
+
+// lower triangle of A (row major, or packed if packed is set) into packed
+// storage
+static inline void copy_lower_triangular(int m0, const float *A, int packed,
+                                         float *A_packed) {
+  if (packed) {
+    memcpy(A_packed, A, TRMM_PACKED_SIZE(m0) * sizeof(float));
+  } else {
+    pack_lower_triangular(m0, A, m0, A_packed);
+  }
+}
+
+#endif /* TRMM_PACKED_H */
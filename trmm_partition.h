@@ -0,0 +1,163 @@
+#ifndef TRMM_PARTITION_H
+#define TRMM_PARTITION_H
+
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+Row partitioning of C = A * B for a lower triangular A
+
+Row i of C costs (i + 1) * n0 multiply-adds, so an even split of the rows
+leaves the last rank with roughly 2p - 1 times the work of the first. The
+partitioners below assign rows to ranks in one of four ways:
+
+  even          contiguous blocks with the same number of rows
+  balanced      contiguous blocks with the same number of flops
+  cyclic        row i goes to rank i % num_ranks
+  block_cyclic  blocks of TRMM_PARTITION_BLOCK rows dealt out round robin
+
+The mode is selected at runtime with the TRMM_PARTITION environment
+variable (default: balanced) and the block size of block_cyclic with
+TRMM_PARTITION_BLOCK (default: 16). Every rank must see the same values
+(with Open MPI pass them with mpiexec -x on multi-node runs).
+
+The variants that split the columns of B and C instead (5 and 10) use
+partition_column_block and partition_column_type.
+*/
+
+#define PARTITION_EVEN 0
+#define PARTITION_BALANCED 1
+#define PARTITION_CYCLIC 2
+#define PARTITION_BLOCK_CYCLIC 3
+
+#define PARTITION_DEFAULT_BLOCK 16
+
+static const char *partition_names[] = {"even", "balanced", "cyclic",
+                                        "block_cyclic"};
+
+// partition mode requested through TRMM_PARTITION
+static inline int partition_mode_from_env(void) {
+  const char *mode = getenv("TRMM_PARTITION");
+  if (mode == NULL) return PARTITION_BALANCED;
+  for (int p = 0; p < 4; p++) {
+    if (strcmp(mode, partition_names[p]) == 0) return p;
+  }
+  fprintf(stderr, "Unknown TRMM_PARTITION '%s', using balanced\n", mode);
+  return PARTITION_BALANCED;
+}
+
+// block size of the block cyclic partition requested through
+// TRMM_PARTITION_BLOCK
+static inline int partition_block_from_env(void) {
+  const char *block = getenv("TRMM_PARTITION_BLOCK");
+  int nb = block != NULL ? atoi(block) : PARTITION_DEFAULT_BLOCK;
+  return nb > 0 ? nb : PARTITION_DEFAULT_BLOCK;
+}
+
+// contiguous modes keep the rows of every rank in one block
+static inline int partition_is_contiguous(int mode) {
+  return mode == PARTITION_EVEN || mode == PARTITION_BALANCED;
+}
+
+// number of multiply-adds needed for the first e rows of C (per column)
+static inline long long partition_prefix_cost(int e) {
+  return (long long)e * (e + 1) / 2;
+}
+
+// first row owned by rank r in the contiguous modes (r = num_ranks gives m0)
+static inline int partition_boundary(int mode, int m0, int num_ranks, int r) {
+  if (mode == PARTITION_EVEN) {
+    int rows_per_rank = m0 / num_ranks;
+    int extra_rows = m0 % num_ranks;
+    return r * rows_per_rank + (r < extra_rows ? r : extra_rows);
+  }
+
+  // balanced: smallest e with e * (e + 1) / 2 >= r / num_ranks of the flops
+  long long total = partition_prefix_cost(m0);
+  long long target = (total * r + num_ranks - 1) / num_ranks;
+  int lo = 0;
+  int hi = m0;
+  while (lo < hi) {
+    int mid = lo + (hi - lo) / 2;
+    if (partition_prefix_cost(mid) >= target)
+      hi = mid;
+    else
+      lo = mid + 1;
+  }
+  return lo;
+}
+
+// row range [start, end) of rank rid in the contiguous modes
+static inline void partition_bounds(int mode, int m0, int num_ranks, int rid,
+                                    int *start, int *end) {
+  *start = partition_boundary(mode, m0, num_ranks, rid);
+  *end = partition_boundary(mode, m0, num_ranks, rid + 1);
+}
+
+// balanced row range [start, end) of rank rid, for the variants whose
+// kernels need contiguous rows and so do not follow TRMM_PARTITION
+static inline void partition_row_block(int m0, int num_ranks, int rid,
+                                       int *start, int *end) {
+  partition_bounds(PARTITION_BALANCED, m0, num_ranks, rid, start, end);
+}
+
+/*
+Rows owned by rank rid in increasing order
+
+Writes them to rows (if not NULL, room for m0 entries) and returns how
+many there are.
+*/
+static inline int partition_rows(int mode, int block, int m0, int num_ranks,
+                                 int rid, int *rows) {
+  int count = 0;
+
+  if (partition_is_contiguous(mode)) {
+    int start, end;
+    partition_bounds(mode, m0, num_ranks, rid, &start, &end);
+    for (int i = start; i < end; i++) {
+      if (rows != NULL) rows[count] = i;
+      count++;
+    }
+    return count;
+  }
+
+  if (mode == PARTITION_CYCLIC) block = 1;
+  for (int b0 = rid * block; b0 < m0; b0 += num_ranks * block) {
+    for (int i = b0; i < b0 + block && i < m0; i++) {
+      if (rows != NULL) rows[count] = i;
+      count++;
+    }
+  }
+  return count;
+}
+
+// multiply-adds per column of C needed by a list of rows
+static inline long long partition_cost(int num_rows, const int *rows) {
+  long long cost = 0;
+  for (int t = 0; t < num_rows; t++) cost += rows[t] + 1;
+  return cost;
+}
+
+// column block [*start, *start + *count) of rank r, the n0 columns split as
+// evenly as possible
+static inline void partition_column_block(int n0, int num_ranks, int r,
+                                          int *start, int *count) {
+  int cols_per_rank = n0 / num_ranks;
+  int extra_cols = n0 % num_ranks;
+  *start = r * cols_per_rank + (r < extra_cols ? r : extra_cols);
+  *count = cols_per_rank + (r < extra_cols ? 1 : 0);
+}
+
+// committed m0 x cols block of element inside a row major matrix with n0
+// columns
+static inline MPI_Datatype partition_column_type(int m0, int n0, int cols,
+                                                 MPI_Datatype element) {
+  MPI_Datatype block_type;
+  MPI_Type_vector(m0, cols, n0, element, &block_type);
+  MPI_Type_commit(&block_type);
+  return block_type;
+}
+
+#endif /* TRMM_PARTITION_H */
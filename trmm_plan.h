@@ -0,0 +1,216 @@
+#ifndef TRMM_PLAN_H
+#define TRMM_PLAN_H
+
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trmm_arena.h"
+#include "trmm_mpi.h"
+#include "trmm_packed.h"
+#include "trmm_partition.h"
+
+/*
+Plans for repeated multiplies of the same shape (Variant 3)
+
+  trmm_plan_t plan = trmm_plan_create(m0, n0, comm);
+  trmm_execute(plan, A, B, C);   // as many times as needed
+  trmm_plan_destroy(plan);
+
+trmm_plan_create does all the setup of the distributed multiply once: the
+rows of C owned by the rank (partition mode from TRMM_PARTITION), the
+offset of every local row in A and C, the local result buffer and, on the
+root, one indexed MPI datatype per rank that places the rows of that rank
+straight into C. trmm_execute then only computes and moves rows of C, with
+no allocation and no setup.
+
+A and B are the local buffers of the distribution mode (TRMM_DISTRIBUTION,
+see below); C is the full m0 x n0 result on the root of comm and unused
+elsewhere. Creating, executing and destroying a plan are local operations
+except that trmm_execute must be called by every rank of comm.
+*/
+
+/*
+Data distribution modes, selected at runtime with TRMM_DISTRIBUTION
+
+  working_set  (default) a rank owning rows r_0 < ... < r_last of C only
+               receives those rows of A (packed one after the other,
+               sent straight out of A_seq with an indexed datatype) and
+               rows 0..r_last of B. Only the root keeps a full C.
+  replicate    the packed A and the full B are broadcast to every rank
+  shared       one packed A and full B per node, in an MPI shared memory
+               window that all ranks of the node read directly; only the
+               node leaders take part in the broadcast
+
+C is never broadcast: it is only written by trmm_execute.
+*/
+#define DIST_WORKING_SET 0
+#define DIST_REPLICATE 1
+#define DIST_SHARED 2
+
+static const char *distribution_names[] = {"working_set", "replicate",
+                                           "shared"};
+
+static inline int distribution_mode_from_env(void) {
+  const char *mode = getenv("TRMM_DISTRIBUTION");
+  if (mode == NULL) return DIST_WORKING_SET;
+  for (int d = 0; d < 3; d++) {
+    if (strcmp(mode, distribution_names[d]) == 0) return d;
+  }
+  fprintf(stderr, "Unknown TRMM_DISTRIBUTION '%s', using working_set\n",
+          mode);
+  return DIST_WORKING_SET;
+}
+
+// number of leading rows of B needed by a list of rows of C
+static inline int rows_of_B_needed(int num_rows, const int *rows) {
+  return num_rows > 0 ? rows[num_rows - 1] + 1 : 0;
+}
+
+typedef struct trmm_plan_s {
+  MPI_Comm comm;
+  int num_ranks;
+  int rid;
+  int m0;
+  int n0;
+  int mode;   // partition mode
+  int block;  // block size of the block cyclic partition
+  int dist;   // distribution mode
+
+  int local_rows;
+  int *rows;       // rows of C owned by this rank
+  size_t *a_offsets;  // start of every local row in A
+  size_t *c_offsets;  // start of every local row in the output buffer
+  float *local_C;  // local rows of C (non-root ranks)
+
+  // root only: where the rows of every other rank land in C
+  MPI_Datatype *row_types;
+  MPI_Request *requests;
+} *trmm_plan_t;
+
+static inline trmm_plan_t trmm_plan_create(int m0, int n0, MPI_Comm comm) {
+  trmm_plan_t plan = (trmm_plan_t)calloc(1, sizeof(struct trmm_plan_s));
+  plan->comm = comm;
+  MPI_Comm_size(comm, &plan->num_ranks);
+  MPI_Comm_rank(comm, &plan->rid);
+  plan->m0 = m0;
+  plan->n0 = n0;
+  plan->mode = partition_mode_from_env();
+  plan->block = partition_block_from_env();
+  plan->dist = distribution_mode_from_env();
+
+  // Rows of C owned by this rank (see trmm_partition.h for the modes)
+  plan->rows = (int *)malloc((m0 + 1) * sizeof(int));
+  plan->local_rows = partition_rows(plan->mode, plan->block, m0,
+                                    plan->num_ranks, plan->rid, plan->rows);
+
+  // Offset of every local row of A and C
+  // (working set: the local rows of A are packed one after the other;
+  // the root writes its rows straight into C, the others into local_C)
+  plan->a_offsets =
+      (size_t *)malloc((plan->local_rows + 1) * sizeof(size_t));
+  plan->c_offsets =
+      (size_t *)malloc((plan->local_rows + 1) * sizeof(size_t));
+  size_t a_offset = 0;
+  for (int t = 0; t < plan->local_rows; t++) {
+    int i = plan->rows[t];
+    plan->a_offsets[t] =
+        plan->dist == DIST_WORKING_SET ? a_offset : TRMM_PACKED_ROW(i);
+    plan->c_offsets[t] = (size_t)(plan->rid == 0 ? i : t) * n0;
+    a_offset += i + 1;
+  }
+
+  if (plan->rid != 0) {
+    plan->local_C = (float *)trmm_arena_alloc(
+        ((size_t)plan->local_rows * n0 + 1) * sizeof(float));
+  } else {
+    // One datatype per rank: its rows of C, in order, inside the full C
+    // (byte displacements, which stay exact for C past 2^31 elements)
+    int *blocklens = (int *)malloc((m0 + 1) * sizeof(int));
+    int *rank_rows = (int *)malloc((m0 + 1) * sizeof(int));
+    MPI_Aint *displs = (MPI_Aint *)malloc((m0 + 1) * sizeof(MPI_Aint));
+    plan->row_types =
+        (MPI_Datatype *)malloc(plan->num_ranks * sizeof(MPI_Datatype));
+    plan->requests =
+        (MPI_Request *)malloc(plan->num_ranks * sizeof(MPI_Request));
+
+    for (int r = 1; r < plan->num_ranks; r++) {
+      int r_rows = partition_rows(plan->mode, plan->block, m0,
+                                  plan->num_ranks, r, rank_rows);
+      for (int t = 0; t < r_rows; t++) {
+        blocklens[t] = n0;
+        displs[t] = (MPI_Aint)rank_rows[t] * n0 * sizeof(float);
+      }
+      MPI_Type_create_hindexed(r_rows, blocklens, displs, MPI_FLOAT,
+                               &plan->row_types[r]);
+      MPI_Type_commit(&plan->row_types[r]);
+    }
+    free(blocklens);
+    free(rank_rows);
+    free(displs);
+  }
+
+  if (plan->rows == NULL || plan->a_offsets == NULL ||
+      plan->c_offsets == NULL || (plan->rid != 0 && plan->local_C == NULL)) {
+    printf("Rank %d: Memory allocation failed\n", plan->rid);
+    MPI_Abort(comm, 1);
+  }
+  return plan;
+}
+
+static inline void trmm_execute(trmm_plan_t plan, const float *A,
+                                const float *B, float *C) {
+  int n0 = plan->n0;
+  float *out = plan->rid == 0 ? C : plan->local_C;
+
+  // Rows of C from other ranks are placed by the datatypes as they arrive
+  if (plan->rid == 0) {
+    for (int r = 1; r < plan->num_ranks; r++) {
+      MPI_Irecv(C, 1, plan->row_types[r], r, 0, plan->comm,
+                &plan->requests[r - 1]);
+    }
+  }
+
+  // Computation with correct triangular bounds, rows shared by the threads
+  // of the rank (dynamic schedule since lower rows cost more)
+#pragma omp parallel for schedule(dynamic)
+  for (int t = 0; t < plan->local_rows; t++) {
+    int i = plan->rows[t];
+    const float *a_row = A + plan->a_offsets[t];
+    float *c_row = out + plan->c_offsets[t];
+    for (int j = 0; j < n0; j++) {
+      float sum = 0.0f;
+      // Only iterate up to current row i
+      for (int k = 0; k <= i; k++) {
+        sum += a_row[k] * B[(size_t)k * n0 + j];
+      }
+      c_row[j] = sum;
+    }
+  }
+
+  if (plan->rid == 0) {
+    MPI_Waitall(plan->num_ranks - 1, plan->requests, MPI_STATUSES_IGNORE);
+  } else {
+    trmm_mpi_send(plan->local_C, (size_t)plan->local_rows * n0, MPI_FLOAT, 0,
+                  0, plan->comm);
+  }
+}
+
+static inline void trmm_plan_destroy(trmm_plan_t plan) {
+  if (plan == NULL) return;
+  if (plan->rid == 0) {
+    for (int r = 1; r < plan->num_ranks; r++) {
+      MPI_Type_free(&plan->row_types[r]);
+    }
+    free(plan->row_types);
+    free(plan->requests);
+  }
+  free(plan->rows);
+  free(plan->a_offsets);
+  free(plan->c_offsets);
+  trmm_arena_free(plan->local_C);
+  free(plan);
+}
+
+#endif /* TRMM_PLAN_H */
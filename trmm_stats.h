@@ -0,0 +1,72 @@
+#ifndef TRMM_STATS_H
+#define TRMM_STATS_H
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+Summary statistics of a set of timing samples (nanoseconds)
+
+  min, max, median  order statistics of the sorted samples
+  mean, stddev      sample mean and standard deviation (n - 1)
+  p95               95th percentile, nearest rank: the smallest sample with
+                    at least 95% of the samples at or below it
+  cv                coefficient of variation, stddev / mean
+
+The minimum estimates the cost without interference; the median and p95
+show what a run typically and occasionally pays, and the coefficient of
+variation tells whether the samples are consistent enough to compare.
+*/
+
+typedef struct {
+  int count;
+  double min;
+  double max;
+  double median;
+  double mean;
+  double stddev;
+  double p95;
+  double cv;
+} trmm_stats_t;
+
+static inline int trmm_stats_compare(const void *a, const void *b) {
+  long x = *(const long *)a;
+  long y = *(const long *)b;
+  return (x > y) - (x < y);
+}
+
+static inline void trmm_stats_compute(int count, const long *samples,
+                                      trmm_stats_t *stats) {
+  memset(stats, 0, sizeof(*stats));
+  stats->count = count;
+  if (count <= 0) return;
+
+  long *sorted = (long *)malloc(count * sizeof(long));
+  memcpy(sorted, samples, count * sizeof(long));
+  qsort(sorted, count, sizeof(long), trmm_stats_compare);
+
+  double sum = 0.0;
+  for (int i = 0; i < count; i++) sum += (double)sorted[i];
+  stats->mean = sum / count;
+
+  double squares = 0.0;
+  for (int i = 0; i < count; i++) {
+    double d = (double)sorted[i] - stats->mean;
+    squares += d * d;
+  }
+  stats->stddev = count > 1 ? sqrt(squares / (count - 1)) : 0.0;
+  stats->cv = stats->mean > 0.0 ? stats->stddev / stats->mean : 0.0;
+
+  stats->min = (double)sorted[0];
+  stats->max = (double)sorted[count - 1];
+  stats->median = count % 2 ? (double)sorted[count / 2]
+                            : ((double)sorted[count / 2 - 1] +
+                               (double)sorted[count / 2]) / 2;
+  int rank = (95 * count + 99) / 100;
+  stats->p95 = (double)sorted[rank - 1];
+
+  free(sorted);
+}
+
+#endif /* TRMM_STATS_H */
@@ -0,0 +1,159 @@
+#ifndef TRMM_WORKSTEAL_H
+#define TRMM_WORKSTEAL_H
+
+#include <stdlib.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/*
+Work-stealing scheduler for the tiles of C
+
+Tiles of a lower triangular multiply have very uneven cost (a block row
+near the bottom of A has far more k blocks than one at the top), so a
+static split of the tiles over threads leaves cores idle. Here the
+(i-block, j-block) tasks are first dealt out in contiguous chunks to
+per-thread deques. A thread pops its own tasks from the bottom of its
+deque and, once it runs dry, steals single tasks from the top of the
+other deques until every task has been executed.
+
+Every deque is guarded by its own OpenMP lock; tasks are coarse (a whole
+tile of C), so the lock is never contended for long. Without OpenMP the
+tasks simply run in order on the calling thread.
+
+ws_run fills a ws_stats_t with the number of tasks, successful steals and
+the time threads spent idle looking for work (summed over threads).
+*/
+
+typedef void (*ws_task_fn)(int ib, int jb, void *arg);
+
+typedef struct {
+  long tasks;        // tasks executed
+  long steals;       // tasks taken from another thread's deque
+  double idle_time;  // seconds spent without work, summed over threads
+  int num_threads;
+} ws_stats_t;
+
+#ifdef _OPENMP
+
+typedef struct {
+  int *tasks;  // task ids (ib * num_jb + jb)
+  int top;     // next task for thieves
+  int bottom;  // one past the next task for the owner
+  omp_lock_t lock;
+  long executed;
+  long steals;
+  double idle_time;
+  char pad[64];  // keep deques of different threads on separate lines
+} ws_deque_t;
+
+// owner side: take the most recently queued task, -1 if empty
+static inline int ws_pop(ws_deque_t *d) {
+  int task = -1;
+  omp_set_lock(&d->lock);
+  if (d->bottom > d->top) task = d->tasks[--d->bottom];
+  omp_unset_lock(&d->lock);
+  return task;
+}
+
+// thief side: take the oldest task, -1 if empty
+static inline int ws_steal(ws_deque_t *d) {
+  int task = -1;
+  omp_set_lock(&d->lock);
+  if (d->bottom > d->top) task = d->tasks[d->top++];
+  omp_unset_lock(&d->lock);
+  return task;
+}
+
+#endif  // _OPENMP
+
+// run fn(ib, jb, arg) for every tile of a num_ib x num_jb grid
+static inline void ws_run(int num_ib, int num_jb, ws_task_fn fn, void *arg,
+                          ws_stats_t *stats) {
+  int num_tasks = num_ib * num_jb;
+  ws_stats_t result = {0, 0, 0.0, 1};
+
+#ifdef _OPENMP
+  int num_threads = omp_get_max_threads();
+  ws_deque_t *deques = (ws_deque_t *)malloc(num_threads * sizeof(ws_deque_t));
+  int *storage = (int *)malloc((num_tasks + 1) * sizeof(int));
+
+  // Contiguous chunks of tiles per thread, ordered top to bottom
+  for (int t = 0; t < num_threads; t++) {
+    int first = (int)((long)num_tasks * t / num_threads);
+    int last = (int)((long)num_tasks * (t + 1) / num_threads);
+    deques[t].tasks = storage + first;
+    deques[t].top = 0;
+    deques[t].bottom = last - first;
+    for (int q = first; q < last; q++) storage[q] = q;
+    omp_init_lock(&deques[t].lock);
+    deques[t].executed = 0;
+    deques[t].steals = 0;
+    deques[t].idle_time = 0.0;
+  }
+
+  int remaining = num_tasks;
+
+#pragma omp parallel num_threads(num_threads)
+  {
+    int tid = omp_get_thread_num();
+    ws_deque_t *own = &deques[tid];
+    unsigned int seed = 2654435761u * (tid + 1);
+
+    for (;;) {
+      int task = ws_pop(own);
+
+      if (task < 0) {
+        // Out of work: visit the other deques from a random start
+        double idle_start = omp_get_wtime();
+        for (;;) {
+          int left;
+#pragma omp atomic read
+          left = remaining;
+          if (left == 0) break;
+
+          seed ^= seed << 13;
+          seed ^= seed >> 17;
+          seed ^= seed << 5;
+          int start = (int)(seed % (unsigned int)num_threads);
+          for (int v = 0; v < num_threads && task < 0; v++) {
+            int victim = (start + v) % num_threads;
+            if (victim != tid) task = ws_steal(&deques[victim]);
+          }
+          if (task >= 0) {
+            own->steals++;
+            break;
+          }
+        }
+        own->idle_time += omp_get_wtime() - idle_start;
+        if (task < 0) break;
+      }
+
+      fn(task / num_jb, task % num_jb, arg);
+      own->executed++;
+#pragma omp atomic update
+      remaining--;
+    }
+  }
+
+  result.num_threads = num_threads;
+  for (int t = 0; t < num_threads; t++) {
+    result.tasks += deques[t].executed;
+    result.steals += deques[t].steals;
+    result.idle_time += deques[t].idle_time;
+    omp_destroy_lock(&deques[t].lock);
+  }
+  free(deques);
+  free(storage);
+#else
+  for (int task = 0; task < num_tasks; task++) {
+    fn(task / num_jb, task % num_jb, arg);
+  }
+  result.tasks = num_tasks;
+#endif
+
+  if (stats != NULL) *stats = result;
+}
+
+#endif /* TRMM_WORKSTEAL_H */
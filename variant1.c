@@ -1,6 +1,10 @@
 #include <mpi.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#include "trmm_arena.h"
+#include "trmm_layout.h"
 
 #ifndef COMPUTE_OP
 #define COMPUTE_OP baseline_compute
@@ -22,41 +26,49 @@
 #define FREE_MEMORY baseline_free
 #endif
 
+#ifndef STRIDED_OP
+#define STRIDED_OP baseline_strided
+#endif
+
+#ifndef INPLACE_OP
+#define INPLACE_OP baseline_inplace
+#endif
+
 /*
 This operation focuses on Lower Triangular Matrix Multiplication
 The operation is C = A * B
 where A is a Lower Triangular Matrix
       B is a Matrix
       C is the result of the operation
-A is a m0 x n0 matrix
+A is a m0 x m0 matrix
 B is a m0 x n0 matrix
 C is a m0 x n0 matrix
 
+STRIDED_OP runs on the caller's matrices in place, in either layout and
+with any leading dimensions (trmm_layout.h), so submatrices of larger
+arrays need no copy. COMPUTE_OP is the row major case with every leading
+dimension equal to the row length; it is not zero-copy, since its
+DISTRIBUTE_DATA and COLLECTION still copy A and B in and C out on the
+root. Only STRIDED_OP works on the caller's buffers directly.
 
+INPLACE_OP overwrites B with A * B, with no C at all. Rows are computed
+bottom-up: row i only reads rows 0..i of B, and those still hold their
+input when row i is written.
 */
 
-void COMPUTE_OP(int m0, int n0, float *A, float *B, float *C) {
+void STRIDED_OP(int layout, int m0, int n0, float *A, int lda, float *B,
+                int ldb, float *C, int ldc) {
   int root_id = 0;
-  int num_ranks;
   int rid;
-  MPI_Status status;
-  int tag = 0;
-  // query the number of ranks from MPI using the default communicator
-  num_ranks = MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
   // query the rank of the current process
-  rid = MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
 
   if (rid == root_id) {
     // Matrices Row and Column Strides
-    // Matrices are stored in Row Major Order
-    int rs_A = m0;
-    int CS_A = 1;
-
-    int rs_B = n0;
-    int CS_B = 1;
-
-    int rs_C = n0;
-    int CS_C = 1;
+    size_t rs_A, CS_A, rs_B, CS_B, rs_C, CS_C;
+    trmm_layout_strides(layout, lda, &rs_A, &CS_A);
+    trmm_layout_strides(layout, ldb, &rs_B, &CS_B);
+    trmm_layout_strides(layout, ldc, &rs_C, &CS_C);
 
     float result;
     // Lower Triangular Matrix Multiplication algorithm
@@ -64,80 +76,92 @@ void COMPUTE_OP(int m0, int n0, float *A, float *B, float *C) {
       for (int j0 = 0; j0 < n0; j0++) {
         result = 0.0f;
         for (int k0 = 0; k0 <= i0; k0++) {
-          result += A[i0 * rs_A + k0] * B[k0 * rs_B + j0];
+          result += A[i0 * rs_A + k0 * CS_A] * B[k0 * rs_B + j0 * CS_B];
         }
-        C[i0 * rs_C + j0] = result;
+        C[i0 * rs_C + j0 * CS_C] = result;
       }
     }
   }
 }
 
+void INPLACE_OP(int layout, int m0, int n0, float *A, int lda, float *B,
+                int ldb) {
+  int root_id = 0;
+  int rid;
+  // query the rank of the current process
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+
+  if (rid == root_id) {
+    // Matrices Row and Column Strides
+    size_t rs_A, CS_A, rs_B, CS_B;
+    trmm_layout_strides(layout, lda, &rs_A, &CS_A);
+    trmm_layout_strides(layout, ldb, &rs_B, &CS_B);
+
+    float result;
+    // Lower Triangular Matrix Multiplication algorithm, last row first
+    for (int i0 = m0 - 1; i0 >= 0; i0--) {
+      for (int j0 = 0; j0 < n0; j0++) {
+        result = 0.0f;
+        for (int k0 = 0; k0 <= i0; k0++) {
+          result += A[i0 * rs_A + k0 * CS_A] * B[k0 * rs_B + j0 * CS_B];
+        }
+        B[i0 * rs_B + j0 * CS_B] = result;
+      }
+    }
+  }
+}
+
+void COMPUTE_OP(int m0, int n0, float *A, float *B, float *C) {
+  // Matrices are stored in Row Major Order
+  STRIDED_OP(TRMM_ROW_MAJOR, m0, n0, A, m0, B, n0, C, n0);
+}
+
 void DISTRIBUTE_ALLOCATION(int m0, int n0, float **A_dist, float **B_dist,
                            float **C_dist) {
   int root_id = 0;
   int num_ranks;
   int rid;
-  MPI_Status status;
-  int tag = 0;
   // query the number of ranks from MPI using the default communicator
-  num_ranks = MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
+  MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
   // query the rank of the current process
-  rid = MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
 
   if (rid == root_id) {
     // Allocate memory for the matrices
-    *A_dist = (float *)malloc(m0 * m0 * sizeof(float));
-    *B_dist = (float *)malloc(m0 * n0 * sizeof(float));
-    *C_dist = (float *)malloc(m0 * n0 * sizeof(float));
-    // Check if memory allocation was successful
-    if (*A_dist == NULL || *B_dist == NULL || *C_dist == NULL) {
-      printf("Memory allocation failed\n");
-      exit(1);
-    }
+    *A_dist = (float *)trmm_arena_alloc((size_t)m0 * m0 * sizeof(float));
+    *B_dist = (float *)trmm_arena_alloc((size_t)m0 * n0 * sizeof(float));
+    *C_dist = (float *)trmm_arena_alloc((size_t)m0 * n0 * sizeof(float));
+  } else {
+    // Only the root holds data, the other ranks get placeholders
+    *A_dist = (float *)trmm_arena_alloc(sizeof(float));
+    *B_dist = (float *)trmm_arena_alloc(sizeof(float));
+    *C_dist = (float *)trmm_arena_alloc(sizeof(float));
+  }
+  // Check if memory allocation was successful
+  if (*A_dist == NULL || *B_dist == NULL || *C_dist == NULL) {
+    printf("Memory allocation failed\n");
+    exit(1);
   }
 }
 
 void DISTRIBUTE_DATA(int m0, int n0, float *A_seq, float *B_seq, float *C_seq,
                      float *A_dist, float *B_dist, float *C_dist) {
+  // C is not an input: COMPUTE_OP overwrites it
+  (void)C_seq;
+  (void)C_dist;
+
   int root_id = 0;
   int num_ranks;
   int rid;
-  MPI_Status status;
-  int tag = 0;
   // query the number of ranks from MPI using the default communicator
-  num_ranks = MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
+  MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
   // query the rank of the current process
-  rid = MPI_Comm_rank(MPI_COMM_WORLD, &rid);
-
-  // Matrices Row and Column Strides
-  int rs_A = m0;
-  int CS_A = 1;
-
-  int rs_B = m0;
-  int CS_B = 1;
-
-  int rs_C = m0;
-  int CS_C = 1;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
 
   if (rid == root_id) {
-    // Copy the data from the sequential matrices to the distributed matrices
-    for (int i0 = 0; i0 < m0; i0++) {
-      for (int j0 = 0; j0 < n0; j0++) {
-        A_dist[i0 * rs_A + j0 * CS_A] = A_seq[i0 * rs_A + j0 * CS_A];
-      }
-    }
-
-    for (int i0 = 0; i0 < m0; i0++) {
-      for (int j0 = 0; j0 < n0; j0++) {
-        B_dist[i0 * rs_B + j0 * CS_B] = B_seq[i0 * rs_B + j0 * CS_B];
-      }
-    }
-
-    for (int i0 = 0; i0 < m0; i0++) {
-      for (int j0 = 0; j0 < n0; j0++) {
-        C_dist[i0 * rs_C + j0 * CS_C] = C_seq[i0 * rs_C + j0 * CS_C];
-      }
-    }
+    // One bulk copy of A and B; C is overwritten by COMPUTE_OP
+    memcpy(A_dist, A_seq, (size_t)m0 * m0 * sizeof(float));
+    memcpy(B_dist, B_seq, (size_t)m0 * n0 * sizeof(float));
   }
 }
 
@@ -145,38 +169,20 @@ void COLLECTION(int m0, int n0, float *C_seq, float *C_dist) {
   int root_id = 0;
   int num_ranks;
   int rid;
-  MPI_Status status;
-  int tag = 0;
   // query the number of ranks from MPI using the default communicator
-  num_ranks = MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
+  MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
   // query the rank of the current process
-  rid = MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
 
   if (rid == root_id) {
     // Copy the data from the distributed matrix to the sequential matrix
-    for (int i0 = 0; i0 < m0; i0++) {
-      for (int j0 = 0; j0 < n0; j0++) {
-        C_seq[i0 * m0 + j0] = C_dist[i0 * m0 + j0];
-      }
-    }
+    memcpy(C_seq, C_dist, (size_t)m0 * n0 * sizeof(float));
   }
 }
 
 void FREE_MEMORY(float *A_dist, float *B_dist, float *C_dist) {
-  int root_id = 0;
-  int num_ranks;
-  int rid;
-  MPI_Status status;
-  int tag = 0;
-  // query the number of ranks from MPI using the default communicator
-  num_ranks = MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
-  // query the rank of the current process
-  rid = MPI_Comm_rank(MPI_COMM_WORLD, &rid);
-
-  if (rid == root_id) {
-    // Free the memory allocated for the matrices
-    free(A_dist);
-    free(B_dist);
-    free(C_dist);
-  }
+  // Free the memory allocated for the matrices (placeholders off the root)
+  trmm_arena_free(A_dist);
+  trmm_arena_free(B_dist);
+  trmm_arena_free(C_dist);
 }
\ No newline at end of file
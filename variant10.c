@@ -0,0 +1,385 @@
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "trmm_arena.h"
+#include "trmm_half.h"
+#include "trmm_kernels.h"
+#include "trmm_mpi.h"
+#include "trmm_packed.h"
+#include "trmm_partition.h"
+
+#ifndef COMPUTE_OP
+#define COMPUTE_OP baseline_compute
+#endif
+
+#ifndef DISTRIBUTE_ALLOCATION
+#define DISTRIBUTE_ALLOCATION baseline_distribute
+#endif
+
+#ifndef DISTRIBUTE_DATA
+#define DISTRIBUTE_DATA baseline_distribute_data
+#endif
+
+#ifndef DISTRIBUTE_PACKED
+#define DISTRIBUTE_PACKED baseline_distribute_packed
+#endif
+
+#ifndef COLLECTION
+#define COLLECTION baseline_collect
+#endif
+
+#ifndef FREE_MEMORY
+#define FREE_MEMORY baseline_free
+#endif
+
+#ifndef REPORT_STATS
+#define REPORT_STATS baseline_report_stats
+#endif
+
+#ifndef INPUT_EPSILON
+#define INPUT_EPSILON baseline_input_epsilon
+#endif
+
+/*
+Mixed precision variant: 16-bit A and B, fp32 accumulation
+
+Same column split as Variant 5, but A (packed lower triangle) and B are
+stored in bf16 or fp16 (trmm_half.h, selected with TRMM_HALF). The root
+rounds A and B once in DISTRIBUTE_DATA; the broadcast of A and the column
+blocks of B then move MPI_UINT16_T, half the bytes of the fp32 variants,
+and each rank keeps half the memory for its inputs. C stays fp32.
+
+The kernel works on TRMM_MR x TRMM_NR tiles of C like trmm_ukr: the rows
+of A used by a row tile are widened once into a per-thread fp32 panel,
+the rows of B are widened 16 values at a time inside the k loop and every
+product is accumulated in fp32. The last tile of a row is zero-padded to
+TRMM_NR columns on load and stored with a mask, so there is no scalar
+cleanup loop.
+
+The result carries the rounding error of the inputs, so the verifier gets
+the unit roundoff of the format through INPUT_EPSILON.
+
+On each rank A_dist holds the packed 16-bit triangle, B_dist an m0 x
+local_cols row major 16-bit matrix and C_dist an m0 x local_cols fp32
+matrix.
+*/
+
+#if TRMM_HAVE_AVX2
+
+// C (mr x nr) = A tile * B, with the rows of B in 16-bit storage; row r of
+// the tile reads a[r][0..kc - mr + r], as trmm_ukr with tri set
+TRMM_INLINE void half_ukr_body(const int format, int mr, int nr, int kc,
+                               const float *const *a, const trmm_half_t *B,
+                               int rs_B, float *C, int rs_C, const int full) {
+  __m256 c[TRMM_MR][2];
+  __m256i mask_lo = trmm_lane_mask(nr);
+  __m256i mask_hi = trmm_lane_mask(nr - 8);
+
+  for (int r = 0; r < TRMM_MR; r++) {
+    c[r][0] = _mm256_setzero_ps();
+    c[r][1] = _mm256_setzero_ps();
+  }
+
+  // every row of the tile is active while k is left of the first diagonal
+  int k_full = kc - mr + 1;
+
+  for (int k = 0; k < k_full; k++) {
+    __m256 b[2];
+    trmm_half_load16(format, B + (size_t)k * rs_B, full ? TRMM_NR : nr, b);
+    for (int r = 0; r < TRMM_MR; r++) {
+      if (r < mr) {
+        __m256 a_r = _mm256_broadcast_ss(a[r] + k);
+        c[r][0] = _mm256_fmadd_ps(a_r, b[0], c[r][0]);
+        c[r][1] = _mm256_fmadd_ps(a_r, b[1], c[r][1]);
+      }
+    }
+  }
+
+  // diagonal triangle: row r stops after column k_full + r - 1
+  for (int k = k_full; k < kc; k++) {
+    __m256 b[2];
+    trmm_half_load16(format, B + (size_t)k * rs_B, full ? TRMM_NR : nr, b);
+    for (int r = 0; r < TRMM_MR; r++) {
+      if (r < mr && r > k - k_full) {
+        __m256 a_r = _mm256_broadcast_ss(a[r] + k);
+        c[r][0] = _mm256_fmadd_ps(a_r, b[0], c[r][0]);
+        c[r][1] = _mm256_fmadd_ps(a_r, b[1], c[r][1]);
+      }
+    }
+  }
+
+  for (int r = 0; r < mr; r++) {
+    float *c_row = C + (size_t)r * rs_C;
+    if (full) {
+      _mm256_storeu_ps(c_row, c[r][0]);
+      _mm256_storeu_ps(c_row + 8, c[r][1]);
+    } else {
+      _mm256_maskstore_ps(c_row, mask_lo, c[r][0]);
+      _mm256_maskstore_ps(c_row + 8, mask_hi, c[r][1]);
+    }
+  }
+}
+
+#endif  // TRMM_HAVE_AVX2
+
+// one instance per format and for full tiles, so neither the conversion nor
+// the edge handling is branched on per load
+static void half_ukr(int format, int mr, int nr, int kc, const float *const *a,
+                     const trmm_half_t *B, int rs_B, float *C, int rs_C) {
+#if TRMM_HAVE_AVX2
+  int full = nr == TRMM_NR;
+  if (format == TRMM_FP16 && full)
+    half_ukr_body(TRMM_FP16, mr, nr, kc, a, B, rs_B, C, rs_C, 1);
+  else if (format == TRMM_FP16)
+    half_ukr_body(TRMM_FP16, mr, nr, kc, a, B, rs_B, C, rs_C, 0);
+  else if (full)
+    half_ukr_body(TRMM_BF16, mr, nr, kc, a, B, rs_B, C, rs_C, 1);
+  else
+    half_ukr_body(TRMM_BF16, mr, nr, kc, a, B, rs_B, C, rs_C, 0);
+#else
+  for (int r = 0; r < mr; r++) {
+    int kc_r = kc - mr + 1 + r;
+    for (int j = 0; j < nr; j++) {
+      float sum = 0.0f;
+      for (int k = 0; k < kc_r; k++) {
+        sum += a[r][k] * trmm_half_to_float(format, B[(size_t)k * rs_B + j]);
+      }
+      C[(size_t)r * rs_C + j] = sum;
+    }
+  }
+#endif
+}
+
+// C (m0 x n0) = A * B with A packed lower triangular, A and B in 16-bit
+static void half_lower_rows(int format, int m0, int n0,
+                            const trmm_half_t *A_packed, const trmm_half_t *B,
+                            int rs_B, float *C, int rs_C) {
+  if (m0 == 0 || n0 == 0) return;
+
+  // fp32 copies of the TRMM_MR rows of A used by the current row tile, one
+  // panel per thread carved from a single arena block
+  int num_threads = 1;
+#ifdef _OPENMP
+  num_threads = omp_get_max_threads();
+#endif
+  float *a_panels = (float *)trmm_arena_alloc(
+      ((size_t)num_threads * TRMM_MR * m0 + 1) * sizeof(float));
+  if (a_panels == NULL) {
+    printf("Memory allocation failed\n");
+    MPI_Abort(MPI_COMM_WORLD, 1);
+  }
+
+#pragma omp parallel
+  {
+    int tid = 0;
+#ifdef _OPENMP
+    tid = omp_get_thread_num();
+#endif
+    float *a_panel = a_panels + (size_t)tid * TRMM_MR * m0;
+    const float *a[TRMM_MR];
+
+#pragma omp for schedule(dynamic)
+    for (int i = 0; i < m0; i += TRMM_MR) {
+      int mr = m0 - i < TRMM_MR ? m0 - i : TRMM_MR;
+      for (int r = 0; r < mr; r++) {
+        int row = i + r;
+        trmm_half_to_float_n(format, row + 1,
+                             A_packed + TRMM_PACKED_ROW(row),
+                             a_panel + r * m0);
+        a[r] = a_panel + r * m0;
+      }
+
+      for (int j = 0; j < n0; j += TRMM_NR) {
+        int nr = n0 - j < TRMM_NR ? n0 - j : TRMM_NR;
+        half_ukr(format, mr, nr, i + mr, a, B + j, rs_B,
+                 C + (size_t)i * rs_C + j, rs_C);
+      }
+    }
+  }
+
+  trmm_arena_free(a_panels);
+}
+
+void COMPUTE_OP(int m0, int n0, float *A, float *B, float *C) {
+  int num_ranks, rid;
+  MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+
+  int col_start, local_cols;
+  partition_column_block(n0, num_ranks, rid, &col_start, &local_cols);
+
+  // A and B hold 16-bit values behind the rig's float pointers
+  half_lower_rows(trmm_half_format_from_env(), m0, local_cols,
+                  (const trmm_half_t *)A, (const trmm_half_t *)B, local_cols,
+                  C, local_cols);
+}
+
+void DISTRIBUTE_ALLOCATION(int m0, int n0, float **A_dist, float **B_dist,
+                           float **C_dist) {
+  int num_ranks, rid;
+  MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+
+  int col_start, local_cols;
+  partition_column_block(n0, num_ranks, rid, &col_start, &local_cols);
+
+  // Packed 16-bit A on every rank, the local column block of 16-bit B and
+  // fp32 C (at least one element so ranks without columns get a valid
+  // buffer)
+  size_t local_size = (size_t)m0 * local_cols;
+  if (local_size == 0) local_size = 1;
+  *A_dist = (float *)trmm_arena_alloc((TRMM_PACKED_SIZE(m0) + 1) *
+                                      sizeof(trmm_half_t));
+  *B_dist = (float *)trmm_arena_alloc(local_size * sizeof(trmm_half_t));
+  *C_dist = (float *)trmm_arena_alloc(local_size * sizeof(float));
+
+  if (*A_dist == NULL || *B_dist == NULL || *C_dist == NULL) {
+    printf("Rank %d: Memory allocation failed\n", rid);
+    MPI_Abort(MPI_COMM_WORLD, 1);
+  }
+}
+
+// inputs from the root to every rank, A either row major or (packed set)
+// in packed storage
+static void distribute_inputs(int m0, int n0, const float *A, int packed,
+                              float *B_seq, float *A_dist, float *B_dist) {
+  int num_ranks, rid;
+  MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+
+  int col_start, local_cols;
+  partition_column_block(n0, num_ranks, rid, &col_start, &local_cols);
+
+  int format = trmm_half_format_from_env();
+  trmm_half_t *A_half = (trmm_half_t *)A_dist;
+
+  // Root rounds the lower triangle of A into packed 16-bit storage, which
+  // is broadcast once
+  if (rid == 0) {
+    for (int i = 0; i < m0; i++) {
+      trmm_float_to_half_n(format, i + 1,
+                           A + lower_row_offset(m0, packed, i),
+                           A_half + TRMM_PACKED_ROW(i));
+    }
+  }
+  trmm_mpi_bcast(A_half, TRMM_PACKED_SIZE(m0), MPI_UINT16_T, 0,
+                 MPI_COMM_WORLD);
+
+  // Root rounds B once and sends every rank its column block of the 16-bit
+  // copy
+  MPI_Request *requests = NULL;
+  MPI_Datatype *types = NULL;
+  trmm_half_t *B_half = NULL;
+  if (rid == 0) {
+    B_half = (trmm_half_t *)trmm_arena_alloc(
+        ((size_t)m0 * n0 + 1) * sizeof(trmm_half_t));
+    if (B_half == NULL) {
+      printf("Rank %d: Memory allocation failed\n", rid);
+      MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    trmm_float_to_half_n(format, (size_t)m0 * n0, B_seq, B_half);
+
+    requests = (MPI_Request *)malloc(num_ranks * sizeof(MPI_Request));
+    types = (MPI_Datatype *)malloc(num_ranks * sizeof(MPI_Datatype));
+    for (int r = 0; r < num_ranks; r++) {
+      int r_start, r_cols;
+      partition_column_block(n0, num_ranks, r, &r_start, &r_cols);
+      types[r] = partition_column_type(m0, n0, r_cols, MPI_UINT16_T);
+      MPI_Isend(B_half + r_start, r_cols > 0 ? 1 : 0, types[r], r, 0,
+                MPI_COMM_WORLD, &requests[r]);
+    }
+  }
+
+  trmm_mpi_recv(B_dist, (size_t)m0 * local_cols, MPI_UINT16_T, 0, 0,
+                MPI_COMM_WORLD);
+
+  if (rid == 0) {
+    MPI_Waitall(num_ranks, requests, MPI_STATUSES_IGNORE);
+    for (int r = 0; r < num_ranks; r++) MPI_Type_free(&types[r]);
+    free(requests);
+    free(types);
+    trmm_arena_free(B_half);
+  }
+}
+
+void DISTRIBUTE_DATA(int m0, int n0, float *A_seq, float *B_seq, float *C_seq,
+                     float *A_dist, float *B_dist, float *C_dist) {
+  (void)C_seq;
+  (void)C_dist;
+  distribute_inputs(m0, n0, A_seq, 0, B_seq, A_dist, B_dist);
+}
+
+// DISTRIBUTE_DATA with A already in packed storage on the root
+void DISTRIBUTE_PACKED(int m0, int n0, float *A_packed, float *B_seq,
+                       float *C_seq, float *A_dist, float *B_dist,
+                       float *C_dist) {
+  (void)C_seq;
+  (void)C_dist;
+  distribute_inputs(m0, n0, A_packed, 1, B_seq, A_dist, B_dist);
+}
+
+void COLLECTION(int m0, int n0, float *C_seq, float *C_dist) {
+  int num_ranks, rid;
+  MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+
+  int col_start, local_cols;
+  partition_column_block(n0, num_ranks, rid, &col_start, &local_cols);
+
+  // Root receives every fp32 column block of C straight into place in C_seq
+  MPI_Request *requests = NULL;
+  MPI_Datatype *types = NULL;
+  if (rid == 0) {
+    requests = (MPI_Request *)malloc(num_ranks * sizeof(MPI_Request));
+    types = (MPI_Datatype *)malloc(num_ranks * sizeof(MPI_Datatype));
+    for (int r = 0; r < num_ranks; r++) {
+      int r_start, r_cols;
+      partition_column_block(n0, num_ranks, r, &r_start, &r_cols);
+      types[r] = partition_column_type(m0, n0, r_cols, MPI_FLOAT);
+      MPI_Irecv(C_seq + r_start, r_cols > 0 ? 1 : 0, types[r], r, 0,
+                MPI_COMM_WORLD, &requests[r]);
+    }
+  }
+
+  trmm_mpi_send(C_dist, (size_t)m0 * local_cols, MPI_FLOAT, 0, 0,
+                MPI_COMM_WORLD);
+
+  if (rid == 0) {
+    MPI_Waitall(num_ranks, requests, MPI_STATUSES_IGNORE);
+    for (int r = 0; r < num_ranks; r++) MPI_Type_free(&types[r]);
+    free(requests);
+    free(types);
+  }
+}
+
+void FREE_MEMORY(float *A_dist, float *B_dist, float *C_dist) {
+  trmm_arena_free(A_dist);
+  trmm_arena_free(B_dist);
+  trmm_arena_free(C_dist);
+}
+
+void REPORT_STATS(int m0, int n0) {
+  int num_ranks, rid;
+  MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+
+  // Bytes of A and B sent by the root, next to the same transfers in fp32
+  if (rid == 0) {
+    double moved = ((double)TRMM_PACKED_SIZE(m0) * (num_ranks - 1) +
+                    (double)m0 * n0) *
+                   sizeof(trmm_half_t);
+    fprintf(stderr, "half=%s m0=%d n0=%d input_bytes=%.0f fp32_bytes=%.0f\n",
+            trmm_half_names[trmm_half_format_from_env()], m0, n0, moved,
+            moved * sizeof(float) / sizeof(trmm_half_t));
+  }
+}
+
+// unit roundoff of the inputs, for the verifier's error bound
+double INPUT_EPSILON(void) {
+  return trmm_half_epsilon(trmm_half_format_from_env());
+}
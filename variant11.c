@@ -0,0 +1,427 @@
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <mpi.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "trmm_arena.h"
+#include "trmm_kernels.h"
+#include "trmm_packed.h"
+#include "trmm_partition.h"
+
+#ifndef COMPUTE_OP
+#define COMPUTE_OP baseline_compute
+#endif
+
+#ifndef DISTRIBUTE_ALLOCATION
+#define DISTRIBUTE_ALLOCATION baseline_distribute
+#endif
+
+#ifndef DISTRIBUTE_DATA
+#define DISTRIBUTE_DATA baseline_distribute_data
+#endif
+
+#ifndef DISTRIBUTE_PACKED
+#define DISTRIBUTE_PACKED baseline_distribute_packed
+#endif
+
+#ifndef COLLECTION
+#define COLLECTION baseline_collect
+#endif
+
+#ifndef FREE_MEMORY
+#define FREE_MEMORY baseline_free
+#endif
+
+#ifndef REPORT_STATS
+#define REPORT_STATS baseline_report_stats
+#endif
+
+#ifndef IO_BYTES
+#define IO_BYTES baseline_io_bytes
+#endif
+
+// working set budget in MB when TRMM_OOC_MB is not set
+#define OOC_DEFAULT_MB 256.0
+#define min(a, b) (((a) < (b)) ? (a) : (b))
+
+/*
+Out-of-core variant: A and B are memory-mapped from files and streamed
+through a bounded working set
+
+A is stored in a file as packed lower triangular rows (trmm_packed.h) and
+B as row major rows, so rows [i0, i1) of either are one contiguous byte
+range. DISTRIBUTE_DATA stages A_seq and B_seq from the root into these
+files (standing in for inputs that already live on disk) and creates the
+file of C; every rank then maps A and B read-only. The files go to
+TRMM_OOC_DIR (default ".", which must be visible to every rank).
+
+Rows of C are split in flop-balanced blocks [s, e) as in Variant 8. A rank
+walks its rows in row panels of P rows, and for each row panel walks B in
+panels of P rows k0 < i1, accumulating C[i0:i1) += A[i0:i1, k0:k1) *
+B[k0:k1, :] in C_dist, which is the only buffer the variant allocates
+(P x n0). Before a panel is computed the one needed next (the following
+panel of B, or the rows of A of the next row panel) is advised with
+MADV_WILLNEED, so the kernel reads it ahead while the current one is
+being computed; a panel that has been used is dropped from the mapping
+with MADV_DONTNEED. A finished row panel is written to the file of C with
+pwrite right away.
+
+The resident set is the C panel plus about three panels of A and B,
+however large the matrices are: P is the largest multiple of TRMM_MR for
+which P * (3 * n0 + m0) floats fit in TRMM_OOC_MB megabytes (default 256,
+fractions allowed), or m0 when everything fits. B above row i1 is read
+again for every row panel, so the I/O volume drops as the budget grows.
+COLLECTION reads C back into C_seq on the root. IO_BYTES returns the bytes
+of A and B read and of C written by the last COMPUTE_OP call, which the
+timer reports as GB/s; REPORT_STATS prints the panel height, the working
+set and the volumes.
+*/
+
+typedef struct {
+  char path[3][512];  // files of A (packed), B and C
+  const float *A;     // read-only mappings
+  const float *B;
+  size_t A_bytes;
+  size_t B_bytes;
+  int C_fd;
+  int panel;  // rows per panel (P)
+} ooc_t;
+
+static ooc_t ooc = {.C_fd = -1};
+
+static double stat_read = 0.0;
+static double stat_written = 0.0;
+
+// rows per panel for the working set budget
+static int panel_rows(int m0, int n0) {
+  double mb = OOC_DEFAULT_MB;
+  if (getenv("TRMM_OOC_MB") != NULL) mb = atof(getenv("TRMM_OOC_MB"));
+  double floats = mb * 1048576.0 / sizeof(float);
+  double rows = floats / (3.0 * n0 + m0);
+  // a single panel needs no alignment: then there are no panel boundaries
+  if (rows >= m0) return m0 > 0 ? m0 : 1;
+  int panel = (int)rows / TRMM_MR * TRMM_MR;
+  return panel < TRMM_MR ? TRMM_MR : panel;
+}
+
+static void ooc_abort(const char *what, const char *path) {
+  int rid;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+  printf("Rank %d: %s failed for %s\n", rid, what, path);
+  MPI_Abort(MPI_COMM_WORLD, 1);
+}
+
+// read-only mapping of a whole file (NULL for an empty one)
+static const float *map_file(const char *path, size_t bytes) {
+  if (bytes == 0) return NULL;
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) ooc_abort("open", path);
+  void *p = mmap(NULL, bytes, PROT_READ, MAP_SHARED, fd, 0);
+  if (p == MAP_FAILED) ooc_abort("mmap", path);
+  close(fd);
+  madvise(p, bytes, MADV_SEQUENTIAL);
+  return (const float *)p;
+}
+
+// madvise the pages holding [p, p + bytes)
+static void advise_range(const float *p, size_t bytes, int advice) {
+  if (p == NULL || bytes == 0) return;
+  uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+  uintptr_t start = (uintptr_t)p / page * page;
+  uintptr_t end = (uintptr_t)p + bytes;
+  madvise((void *)start, end - start, advice);
+}
+
+// pwrite / pread that loop over short transfers
+static void write_all(int fd, const float *buffer, size_t bytes,
+                      size_t offset) {
+  const char *p = (const char *)buffer;
+  while (bytes > 0) {
+    ssize_t done = pwrite(fd, p, bytes, (off_t)offset);
+    if (done <= 0) ooc_abort("pwrite", ooc.path[2]);
+    p += done;
+    bytes -= (size_t)done;
+    offset += (size_t)done;
+  }
+}
+
+static void read_all(int fd, float *buffer, size_t bytes, size_t offset) {
+  char *p = (char *)buffer;
+  while (bytes > 0) {
+    ssize_t done = pread(fd, p, bytes, (off_t)offset);
+    if (done <= 0) ooc_abort("pread", ooc.path[2]);
+    p += done;
+    bytes -= (size_t)done;
+    offset += (size_t)done;
+  }
+}
+
+// C[s:e) += A[s:e, k0:k1) * B[k0:k1, :] respecting the triangle of A, with
+// A_rows the packed rows from row s and C_panel the rows [s, e) of C
+static void panel_update(int s, int e, int k0, int k1, int n0,
+                         const float *A_rows, const float *B,
+                         float *C_panel) {
+  // Row tiles are aligned to multiples of TRMM_MR (except the first one),
+  // so no tile crosses the diagonal of a panel boundary
+  int second = (s / TRMM_MR + 1) * TRMM_MR;
+  int num_tiles = s == e ? 0 : 1;
+  if (e > second) num_tiles += (e - second + TRMM_MR - 1) / TRMM_MR;
+
+#pragma omp parallel for schedule(dynamic)
+  for (int t = 0; t < num_tiles; t++) {
+    int i = t == 0 ? s : second + (t - 1) * TRMM_MR;
+    int next = min(t == 0 ? second : i + TRMM_MR, e);
+    int mr = next - i;
+    if (next <= k0) continue;
+
+    // Rectangular when the whole panel is left of the tile's diagonal,
+    // otherwise the diagonal of the tile lies inside this panel
+    int tri = k1 > i;
+    int kc = tri ? i + mr - k0 : k1 - k0;
+    const float *a[TRMM_MR];
+    for (int r = 0; r < mr; r++) {
+      a[r] = A_rows + TRMM_PACKED_ROW(i + r) - TRMM_PACKED_ROW(s) + k0;
+    }
+    for (int j = 0; j < n0; j += TRMM_NR) {
+      int nr = n0 - j < TRMM_NR ? n0 - j : TRMM_NR;
+      trmm_ukr(mr, nr, kc, tri, a, B + (size_t)k0 * n0 + j, n0,
+               C_panel + (size_t)(i - s) * n0 + j, n0, 1);
+    }
+  }
+}
+
+void COMPUTE_OP(int m0, int n0, float *A, float *B, float *C) {
+  // A and B are read from the mappings, not from the placeholders
+  (void)A;
+  (void)B;
+
+  int num_ranks, rid;
+  MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+
+  int s, e;
+  partition_row_block(m0, num_ranks, rid, &s, &e);
+  int P = ooc.panel;
+  size_t row_B = (size_t)n0 * sizeof(float);
+
+  double bytes_read = 0.0;
+  double bytes_written = 0.0;
+
+  // first row panel of A and first panel of B
+  if (s < e) {
+    int i1 = min(s + P, e);
+    advise_range(ooc.A + TRMM_PACKED_ROW(s),
+                 (TRMM_PACKED_ROW(i1) - TRMM_PACKED_ROW(s)) * sizeof(float),
+                 MADV_WILLNEED);
+    advise_range(ooc.B, (size_t)min(P, i1) * row_B, MADV_WILLNEED);
+  }
+
+  for (int i0 = s; i0 < e; i0 += P) {
+    int i1 = min(i0 + P, e);
+    const float *A_rows = ooc.A + TRMM_PACKED_ROW(i0);
+    size_t A_bytes =
+        (TRMM_PACKED_ROW(i1) - TRMM_PACKED_ROW(i0)) * sizeof(float);
+    memset(C, 0, (size_t)(i1 - i0) * row_B);
+
+    for (int k0 = 0; k0 < i1; k0 += P) {
+      int k1 = min(k0 + P, i1);
+
+      // read ahead the panel needed next
+      if (k1 < i1) {
+        advise_range(ooc.B + (size_t)k1 * n0,
+                     (size_t)(min(k1 + P, i1) - k1) * row_B, MADV_WILLNEED);
+      } else if (i1 < e) {
+        int next = min(i1 + P, e);
+        advise_range(ooc.A + TRMM_PACKED_ROW(i1),
+                     (TRMM_PACKED_ROW(next) - TRMM_PACKED_ROW(i1)) *
+                         sizeof(float),
+                     MADV_WILLNEED);
+        advise_range(ooc.B, (size_t)min(P, next) * row_B, MADV_WILLNEED);
+      }
+
+      panel_update(i0, i1, k0, k1, n0, A_rows, ooc.B, C);
+
+      advise_range(ooc.B + (size_t)k0 * n0, (size_t)(k1 - k0) * row_B,
+                   MADV_DONTNEED);
+      bytes_read += (double)(k1 - k0) * row_B;
+    }
+
+    advise_range(A_rows, A_bytes, MADV_DONTNEED);
+    bytes_read += (double)A_bytes;
+
+    // C is written back one row panel at a time
+    write_all(ooc.C_fd, C, (size_t)(i1 - i0) * row_B, (size_t)i0 * row_B);
+    bytes_written += (double)(i1 - i0) * row_B;
+  }
+
+  stat_read = bytes_read;
+  stat_written = bytes_written;
+}
+
+void DISTRIBUTE_ALLOCATION(int m0, int n0, float **A_dist, float **B_dist,
+                           float **C_dist) {
+  int rid;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+
+  // A and B stay in their files: only the row panel of C is a buffer (A
+  // and B get one element so the rig sees valid pointers)
+  ooc.panel = panel_rows(m0, n0);
+  *A_dist = (float *)trmm_arena_alloc(sizeof(float));
+  *B_dist = (float *)trmm_arena_alloc(sizeof(float));
+  *C_dist = (float *)trmm_arena_alloc(((size_t)ooc.panel * n0 + 1) *
+                                      sizeof(float));
+
+  if (*A_dist == NULL || *B_dist == NULL || *C_dist == NULL) {
+    printf("Rank %d: Memory allocation failed\n", rid);
+    MPI_Abort(MPI_COMM_WORLD, 1);
+  }
+}
+
+// release the mappings and the file of C of the previous DISTRIBUTE_DATA
+static void ooc_unmap(void) {
+  if (ooc.A != NULL) munmap((void *)ooc.A, ooc.A_bytes);
+  if (ooc.B != NULL) munmap((void *)ooc.B, ooc.B_bytes);
+  if (ooc.C_fd >= 0) close(ooc.C_fd);
+  ooc.A = ooc.B = NULL;
+  ooc.C_fd = -1;
+}
+
+// stage the inputs of the root in files, A either row major or (packed
+// set) in packed storage
+static void distribute_inputs(int m0, int n0, const float *A, int packed,
+                              const float *B_seq) {
+  int rid;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+
+  // May be called again on the same buffers (the timer distributes before
+  // every call): the files are staged anew
+  ooc_unmap();
+
+  // File names carry the pid of the root, so concurrent runs sharing
+  // TRMM_OOC_DIR do not collide
+  long pid = (long)getpid();
+  MPI_Bcast(&pid, 1, MPI_LONG, 0, MPI_COMM_WORLD);
+  const char *dir = getenv("TRMM_OOC_DIR") != NULL ? getenv("TRMM_OOC_DIR")
+                                                   : ".";
+  const char *names[3] = {"A", "B", "C"};
+  for (int f = 0; f < 3; f++) {
+    snprintf(ooc.path[f], sizeof(ooc.path[f]), "%s/trmm_ooc_%ld_%s.bin", dir,
+             pid, names[f]);
+  }
+  ooc.A_bytes = TRMM_PACKED_SIZE(m0) * sizeof(float);
+  ooc.B_bytes = (size_t)m0 * n0 * sizeof(float);
+
+  // Root stages packed A and B and sizes the file of C
+  if (rid == 0) {
+    FILE *file = fopen(ooc.path[0], "wb");
+    if (file == NULL) ooc_abort("fopen", ooc.path[0]);
+    for (int i = 0; i < m0; i++) {
+      if (fwrite(A + lower_row_offset(m0, packed, i), sizeof(float),
+                 (size_t)i + 1, file) != (size_t)i + 1) {
+        ooc_abort("fwrite", ooc.path[0]);
+      }
+    }
+    fclose(file);
+
+    file = fopen(ooc.path[1], "wb");
+    if (file == NULL) ooc_abort("fopen", ooc.path[1]);
+    if (fwrite(B_seq, sizeof(float), (size_t)m0 * n0, file) !=
+        (size_t)m0 * n0) {
+      ooc_abort("fwrite", ooc.path[1]);
+    }
+    fclose(file);
+
+    int fd = open(ooc.path[2], O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || ftruncate(fd, (off_t)ooc.B_bytes) != 0) {
+      ooc_abort("create", ooc.path[2]);
+    }
+    close(fd);
+  }
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  ooc.A = map_file(ooc.path[0], ooc.A_bytes);
+  ooc.B = map_file(ooc.path[1], ooc.B_bytes);
+  ooc.C_fd = open(ooc.path[2], O_RDWR);
+  if (ooc.C_fd < 0) ooc_abort("open", ooc.path[2]);
+}
+
+void DISTRIBUTE_DATA(int m0, int n0, float *A_seq, float *B_seq, float *C_seq,
+                     float *A_dist, float *B_dist, float *C_dist) {
+  (void)C_seq;
+  (void)A_dist;
+  (void)B_dist;
+  (void)C_dist;
+  distribute_inputs(m0, n0, A_seq, 0, B_seq);
+}
+
+// DISTRIBUTE_DATA with A already in packed storage on the root
+void DISTRIBUTE_PACKED(int m0, int n0, float *A_packed, float *B_seq,
+                       float *C_seq, float *A_dist, float *B_dist,
+                       float *C_dist) {
+  (void)C_seq;
+  (void)A_dist;
+  (void)B_dist;
+  (void)C_dist;
+  distribute_inputs(m0, n0, A_packed, 1, B_seq);
+}
+
+void COLLECTION(int m0, int n0, float *C_seq, float *C_dist) {
+  int rid;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+  (void)C_dist;
+
+  // Every row panel is already in the file of C
+  fdatasync(ooc.C_fd);
+  MPI_Barrier(MPI_COMM_WORLD);
+  if (rid == 0) {
+    read_all(ooc.C_fd, C_seq, (size_t)m0 * n0 * sizeof(float), 0);
+  }
+}
+
+void FREE_MEMORY(float *A_dist, float *B_dist, float *C_dist) {
+  int rid;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+
+  ooc_unmap();
+
+  // the root removes the files once no rank uses them
+  MPI_Barrier(MPI_COMM_WORLD);
+  if (rid == 0) {
+    for (int f = 0; f < 3; f++) unlink(ooc.path[f]);
+  }
+
+  trmm_arena_free(A_dist);
+  trmm_arena_free(B_dist);
+  trmm_arena_free(C_dist);
+}
+
+double IO_BYTES(int m0, int n0) {
+  (void)m0;
+  (void)n0;
+  return stat_read + stat_written;
+}
+
+void REPORT_STATS(int m0, int n0) {
+  int rid;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+
+  double local[2] = {stat_read, stat_written};
+  double total[2];
+  MPI_Reduce(local, total, 2, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+
+  if (rid == 0) {
+    double working_set =
+        (double)ooc.panel * (3.0 * n0 + m0) * sizeof(float) / 1048576.0;
+    fprintf(stderr,
+            "ooc m0=%d n0=%d panel=%d working_set=%.2f MB read=%.2f MB "
+            "written=%.2f MB\n",
+            m0, n0, ooc.panel, working_set, total[0] / 1048576.0,
+            total[1] / 1048576.0);
+  }
+}
@@ -1,193 +1,365 @@
-#include <mpi.h>
-#include <stdio.h>
-#include <stdlib.h>
-
-#ifndef COMPUTE_OP
-#define COMPUTE_OP baseline_compute
-#endif
-
-#ifndef DISTRIBUTE_ALLOCATION
-#define DISTRIBUTE_ALLOCATION baseline_distribute
-#endif
-
-#ifndef DISTRIBUTE_DATA
-#define DISTRIBUTE_DATA baseline_distribute_data
-#endif
-
-#ifndef COLLECTION
-#define COLLECTION baseline_collect
-#endif
-
-#ifndef FREE_MEMORY
-#define FREE_MEMORY baseline_free
-#endif
-
-#define BLOCK_SIZE 16
-
-#define min(a, b) (((a) < (b)) ? (a) : (b))
-/*
-This operation focuses on Lower Triangular Matrix Multiplication
-The operation is C = A * B
-where A is a Lower Triangular Matrix
-      B is a Matrix
-      C is the result of the operation
-A is a m0 x n0 matrix
-B is a m0 x n0 matrix
-C is a m0 x n0 matrix
-
-
-*/
-
-void COMPUTE_OP(int m0, int n0, float *A, float *B, float *C) {
-  int root_id = 0;
-  int num_ranks;
-  int rid;
-  MPI_Status status;
-  int tag = 0;
-  // query the number of ranks from MPI using the default communicator
-  num_ranks = MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
-  // query the rank of the current process
-  rid = MPI_Comm_rank(MPI_COMM_WORLD, &rid);
-
-  if (rid == root_id) {
-    // Matrices Row and Column Strides
-    // Matrices are stored in Row Major Order
-    int rs_A = m0;
-    int CS_A = 1;
-
-    int rs_B = m0;
-    int CS_B = 1;
-
-    int rs_C = m0;
-    int CS_C = 1;
-
-    int block_size_dist = BLOCK_SIZE * (m0 / BLOCK_SIZE);
-
-    // Blocked matrix multiplication
-    for (int i0 = 0; i0 < m0; i0 += BLOCK_SIZE) {
-      for (int j0 = 0; j0 < n0; j0 += BLOCK_SIZE) {
-        for (int k0 = 0; k0 <= i0; k0 += BLOCK_SIZE) {
-          // Process block
-          for (int i = i0; i < min(i0 + BLOCK_SIZE, m0); i++) {
-            for (int j = j0; j < min(j0 + BLOCK_SIZE, n0); j++) {
-              float sum = 0.0f;
-              for (int k = k0; k < min(k0 + BLOCK_SIZE, i + 1); k++) {
-                sum += A[i * rs_A + k] * B[k * rs_B + j];
-              }
-              C[i * rs_C + j] += sum;
-            }
-          }
-        }
-      }
-    }
-  }
-}
-
-void DISTRIBUTE_ALLOCATION(int m0, int n0, float **A_dist, float **B_dist,
-                           float **C_dist) {
-  int root_id = 0;
-  int num_ranks;
-  int rid;
-  MPI_Status status;
-  int tag = 0;
-  // query the number of ranks from MPI using the default communicator
-  num_ranks = MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
-  // query the rank of the current process
-  rid = MPI_Comm_rank(MPI_COMM_WORLD, &rid);
-
-  if (rid == root_id) {
-    // Allocate memory for the matrices
-    *A_dist = (float *)malloc(m0 * m0 * sizeof(float));
-    *B_dist = (float *)malloc(m0 * n0 * sizeof(float));
-    *C_dist = (float *)malloc(m0 * n0 * sizeof(float));
-    // Check if memory allocation was successful
-    if (*A_dist == NULL || *B_dist == NULL || *C_dist == NULL) {
-      printf("Memory allocation failed\n");
-      exit(1);
-    }
-  }
-}
-
-void DISTRIBUTE_DATA(int m0, int n0, float *A_seq, float *B_seq, float *C_seq,
-                     float *A_dist, float *B_dist, float *C_dist) {
-  int root_id = 0;
-  int num_ranks;
-  int rid;
-  MPI_Status status;
-  int tag = 0;
-  // query the number of ranks from MPI using the default communicator
-  num_ranks = MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
-  // query the rank of the current process
-  rid = MPI_Comm_rank(MPI_COMM_WORLD, &rid);
-
-  // Matrices Row and Column Strides
-  int rs_A = m0;
-  int CS_A = 1;
-
-  int rs_B = m0;
-  int CS_B = 1;
-
-  int rs_C = m0;
-  int CS_C = 1;
-
-  if (rid == root_id) {
-    // Copy the data from the sequential matrices to the distributed matrices
-    for (int i0 = 0; i0 < m0; i0++) {
-      for (int j0 = 0; j0 < n0; j0++) {
-        A_dist[i0 * rs_A + j0 * CS_A] = A_seq[i0 * rs_A + j0 * CS_A];
-      }
-    }
-
-    for (int i0 = 0; i0 < m0; i0++) {
-      for (int j0 = 0; j0 < n0; j0++) {
-        B_dist[i0 * rs_B + j0 * CS_B] = B_seq[i0 * rs_B + j0 * CS_B];
-      }
-    }
-
-    for (int i0 = 0; i0 < m0; i0++) {
-      for (int j0 = 0; j0 < n0; j0++) {
-        C_dist[i0 * rs_C + j0 * CS_C] = C_seq[i0 * rs_C + j0 * CS_C];
-      }
-    }
-  }
-}
-
-void COLLECTION(int m0, int n0, float *C_seq, float *C_dist) {
-  int root_id = 0;
-  int num_ranks;
-  int rid;
-  MPI_Status status;
-  int tag = 0;
-  // query the number of ranks from MPI using the default communicator
-  num_ranks = MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
-  // query the rank of the current process
-  rid = MPI_Comm_rank(MPI_COMM_WORLD, &rid);
-
-  if (rid == root_id) {
-    // Copy the data from the distributed matrix to the sequential matrix
-    for (int i0 = 0; i0 < m0; i0++) {
-      for (int j0 = 0; j0 < n0; j0++) {
-        C_seq[i0 * m0 + j0] = C_dist[i0 * m0 + j0];
-      }
-    }
-  }
-}
-
-void FREE_MEMORY(float *A_dist, float *B_dist, float *C_dist) {
-  int root_id = 0;
-  int num_ranks;
-  int rid;
-  MPI_Status status;
-  int tag = 0;
-  // query the number of ranks from MPI using the default communicator
-  num_ranks = MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
-  // query the rank of the current process
-  rid = MPI_Comm_rank(MPI_COMM_WORLD, &rid);
-
-  if (rid == root_id) {
-    // Free the memory allocated for the matrices
-    free(A_dist);
-    free(B_dist);
-    free(C_dist);
-  }
-}
\ No newline at end of file
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trmm_arena.h"
+#include "trmm_autotune.h"
+#include "trmm_layout.h"
+#include "trmm_worksteal.h"
+
+#ifndef COMPUTE_OP
+#define COMPUTE_OP baseline_compute
+#endif
+
+#ifndef DISTRIBUTE_ALLOCATION
+#define DISTRIBUTE_ALLOCATION baseline_distribute
+#endif
+
+#ifndef DISTRIBUTE_DATA
+#define DISTRIBUTE_DATA baseline_distribute_data
+#endif
+
+#ifndef COLLECTION
+#define COLLECTION baseline_collect
+#endif
+
+#ifndef FREE_MEMORY
+#define FREE_MEMORY baseline_free
+#endif
+
+#ifndef REPORT_STATS
+#define REPORT_STATS baseline_report_stats
+#endif
+
+#ifndef STRIDED_OP
+#define STRIDED_OP baseline_strided
+#endif
+
+#ifndef INPLACE_OP
+#define INPLACE_OP baseline_inplace
+#endif
+
+// default tile size and loop order, used when there is no tuning entry
+#define BLOCK_SIZE 16
+#define LOOP_ORDER TUNE_ORDER_IJK
+
+// columns of B per task of the in-place multiply
+#define INPLACE_STRIP 64
+
+#define min(a, b) (((a) < (b)) ? (a) : (b))
+/*
+This operation focuses on Lower Triangular Matrix Multiplication
+The operation is C = A * B
+where A is a Lower Triangular Matrix
+      B is a Matrix
+      C is the result of the operation
+A is a m0 x m0 matrix
+B is a m0 x n0 matrix
+C is a m0 x n0 matrix
+
+Every BLOCK_SIZE x BLOCK_SIZE tile of C is one task that runs the whole k
+range of its block row. The tasks are executed by the thread team of the
+rank through the work-stealing scheduler of trmm_worksteal.h: the lower
+block rows of C cost more, so threads that finish their share early steal
+tiles from the others. REPORT_STATS prints the number of tasks, steals and
+idle time of the last COMPUTE_OP call.
+
+The tile size and the loop order inside a tile come from the autotuner of
+trmm_autotune.h (BLOCK_SIZE and LOOP_ORDER when the shape was never tuned).
+With TRMM_AUTOTUNE=1 the first call for a shape sweeps the candidates on a
+scratch C and saves the fastest to the tuning file.
+
+STRIDED_OP runs on the caller's matrices in place, in either layout and
+with any leading dimensions (trmm_layout.h); the tiles read and write
+through row and column strides. COMPUTE_OP is the row major case with
+every leading dimension equal to the row length, behind a DISTRIBUTE_DATA
+and COLLECTION that still copy A and B in and C out on the root;
+STRIDED_OP is the zero-copy entry. Only the root computes, but every rank
+takes part in the autotuner's collective lookup.
+
+INPLACE_OP overwrites B with A * B, with no C at all. The columns of B are
+independent, so every INPLACE_STRIP columns are one task for the
+work-stealing scheduler; inside a strip rows are computed bottom-up, since
+row i only reads rows 0..i and those still hold their input.
+*/
+
+typedef struct {
+  int m0;
+  int n0;
+  const float *A;
+  const float *B;
+  float *C;
+  size_t rs_A, cs_A;
+  size_t rs_B, cs_B;
+  size_t rs_C, cs_C;
+  int block;
+  int order;
+} tile_args_t;
+
+static ws_stats_t last_stats;
+
+// C tile (ib, jb) += sum over k0 <= i0 of A block (ib, k0) * B block (k0, jb)
+// with column strides cs_A, cs_B and cs_C (always inlined, so that the unit
+// stride call below is compiled with constant strides)
+static inline __attribute__((always_inline)) void tile_body(
+    const tile_args_t *t, int ib, int jb, size_t cs_A, size_t cs_B,
+    size_t cs_C) {
+  int bs = t->block;
+  int i0 = ib * bs;
+  int j0 = jb * bs;
+  int i_end = min(i0 + bs, t->m0);
+  int j_end = min(j0 + bs, t->n0);
+
+  for (int k0 = 0; k0 <= i0; k0 += bs) {
+    // Process block
+    if (t->order == TUNE_ORDER_IKJ) {
+      for (int i = i0; i < i_end; i++) {
+        float *c_row = t->C + i * t->rs_C;
+        for (int k = k0; k < min(k0 + bs, i + 1); k++) {
+          float a = t->A[i * t->rs_A + k * cs_A];
+          const float *b_row = t->B + k * t->rs_B;
+          for (int j = j0; j < j_end; j++) {
+            c_row[j * cs_C] += a * b_row[j * cs_B];
+          }
+        }
+      }
+    } else {
+      for (int i = i0; i < i_end; i++) {
+        for (int j = j0; j < j_end; j++) {
+          float sum = 0.0f;
+          for (int k = k0; k < min(k0 + bs, i + 1); k++) {
+            sum += t->A[i * t->rs_A + k * cs_A] * t->B[k * t->rs_B + j * cs_B];
+          }
+          t->C[i * t->rs_C + j * cs_C] += sum;
+        }
+      }
+    }
+  }
+}
+
+static void compute_tile(int ib, int jb, void *arg) {
+  const tile_args_t *t = (const tile_args_t *)arg;
+  // row major matrices get a copy with constant unit strides, which the
+  // compiler can vectorize
+  if (t->cs_A == 1 && t->cs_B == 1 && t->cs_C == 1) {
+    tile_body(t, ib, jb, 1, 1, 1);
+  } else {
+    tile_body(t, ib, jb, t->cs_A, t->cs_B, t->cs_C);
+  }
+}
+
+// strip jb of B := A * B in place, last row first, with column strides
+// cs_A and cs_B (B is passed as C of the tile arguments)
+static inline __attribute__((always_inline)) void strip_body(
+    const tile_args_t *t, int jb, size_t cs_A, size_t cs_B) {
+  int j0 = jb * t->block;
+  int j_end = min(j0 + t->block, t->n0);
+
+  for (int i = t->m0 - 1; i >= 0; i--) {
+    float *b_i = t->C + i * t->rs_B;
+    float a_ii = t->A[i * t->rs_A + i * cs_A];
+    for (int j = j0; j < j_end; j++) {
+      b_i[j * cs_B] *= a_ii;
+    }
+    for (int k = 0; k < i; k++) {
+      float a = t->A[i * t->rs_A + k * cs_A];
+      const float *b_k = t->C + k * t->rs_B;
+      for (int j = j0; j < j_end; j++) {
+        b_i[j * cs_B] += a * b_k[j * cs_B];
+      }
+    }
+  }
+}
+
+static void compute_strip(int ib, int jb, void *arg) {
+  const tile_args_t *t = (const tile_args_t *)arg;
+  (void)ib;
+  if (t->cs_A == 1 && t->cs_B == 1) {
+    strip_body(t, jb, 1, 1);
+  } else {
+    strip_body(t, jb, t->cs_A, t->cs_B);
+  }
+}
+
+// all tiles of C through the work-stealing scheduler
+static void run_tiles(tile_args_t *args, ws_stats_t *stats) {
+  ws_run((args->m0 + args->block - 1) / args->block,
+         (args->n0 + args->block - 1) / args->block, compute_tile, args,
+         stats);
+}
+
+// autotuner callback: one run with the candidate parameters on a scratch C
+// (allocated at the first run, so calls that do not tune never touch it)
+static void tune_run(const tune_params_t *params, void *arg) {
+  tile_args_t *scratch = (tile_args_t *)arg;
+  if (scratch->C == NULL) {
+    scratch->C = (float *)calloc((size_t)scratch->m0 * scratch->rs_C +
+                                     (size_t)scratch->n0 * scratch->cs_C + 1,
+                                 sizeof(float));
+  }
+  tile_args_t args = *scratch;
+  args.block = params->block;
+  args.order = params->order;
+  run_tiles(&args, NULL);
+}
+
+static const tune_params_t tune_candidates[] = {
+    {8, TUNE_ORDER_IJK},  {16, TUNE_ORDER_IJK},  {32, TUNE_ORDER_IJK},
+    {64, TUNE_ORDER_IJK}, {8, TUNE_ORDER_IKJ},   {16, TUNE_ORDER_IKJ},
+    {32, TUNE_ORDER_IKJ}, {64, TUNE_ORDER_IKJ},  {128, TUNE_ORDER_IKJ}};
+
+void STRIDED_OP(int layout, int m0, int n0, float *A, int lda, float *B,
+                int ldb, float *C, int ldc) {
+  int root_id = 0;
+  int rid;
+  // query the rank of the current process
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+
+  // Matrices Row and Column Strides
+  size_t rs_A, CS_A, rs_B, CS_B, rs_C, CS_C;
+  trmm_layout_strides(layout, lda, &rs_A, &CS_A);
+  trmm_layout_strides(layout, ldb, &rs_B, &CS_B);
+  trmm_layout_strides(layout, ldc, &rs_C, &CS_C);
+
+  // Tile size and loop order for this shape (candidates are timed on a
+  // scratch C so that C only receives the final product once). The lookup
+  // is collective; off the root the scratch problem is empty
+  tile_args_t args = {m0,   n0,   A,    B,    C,          rs_A,      CS_A,
+                      rs_B, CS_B, rs_C, CS_C, BLOCK_SIZE, LOOP_ORDER};
+  tile_args_t scratch = args;
+  scratch.C = NULL;
+  if (rid != root_id) scratch.m0 = scratch.n0 = 0;
+  tune_params_t fallback = {BLOCK_SIZE, LOOP_ORDER};
+  tune_params_t params = autotune_params(
+      "variant2", m0, n0, tune_candidates,
+      sizeof(tune_candidates) / sizeof(tune_candidates[0]), fallback,
+      tune_run, &scratch);
+  free(scratch.C);
+
+  if (rid == root_id) {
+    args.block = params.block;
+    args.order = params.order;
+
+    // The tiles accumulate into C
+    for (int i0 = 0; i0 < m0; i0++) {
+      for (int j0 = 0; j0 < n0; j0++) {
+        C[i0 * rs_C + j0 * CS_C] = 0.0f;
+      }
+    }
+
+    // Blocked matrix multiplication, one task per tile of C
+    run_tiles(&args, &last_stats);
+  }
+}
+
+void INPLACE_OP(int layout, int m0, int n0, float *A, int lda, float *B,
+                int ldb) {
+  int root_id = 0;
+  int rid;
+  // query the rank of the current process
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+
+  if (rid == root_id) {
+    // Matrices Row and Column Strides
+    size_t rs_A, CS_A, rs_B, CS_B;
+    trmm_layout_strides(layout, lda, &rs_A, &CS_A);
+    trmm_layout_strides(layout, ldb, &rs_B, &CS_B);
+
+    tile_args_t args = {m0,   n0,   A,    B,    B,             rs_A,    CS_A,
+                        rs_B, CS_B, rs_B, CS_B, INPLACE_STRIP, LOOP_ORDER};
+
+    // One task per strip of columns
+    ws_run(1, (n0 + INPLACE_STRIP - 1) / INPLACE_STRIP, compute_strip, &args,
+           &last_stats);
+  }
+}
+
+void COMPUTE_OP(int m0, int n0, float *A, float *B, float *C) {
+  // Matrices are stored in Row Major Order
+  STRIDED_OP(TRMM_ROW_MAJOR, m0, n0, A, m0, B, n0, C, n0);
+}
+
+void DISTRIBUTE_ALLOCATION(int m0, int n0, float **A_dist, float **B_dist,
+                           float **C_dist) {
+  int root_id = 0;
+  int num_ranks;
+  int rid;
+  // query the number of ranks from MPI using the default communicator
+  MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
+  // query the rank of the current process
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+
+  if (rid == root_id) {
+    // Allocate memory for the matrices
+    *A_dist = (float *)trmm_arena_alloc((size_t)m0 * m0 * sizeof(float));
+    *B_dist = (float *)trmm_arena_alloc((size_t)m0 * n0 * sizeof(float));
+    *C_dist = (float *)trmm_arena_alloc((size_t)m0 * n0 * sizeof(float));
+  } else {
+    // Only the root holds data, the other ranks get placeholders
+    *A_dist = (float *)trmm_arena_alloc(sizeof(float));
+    *B_dist = (float *)trmm_arena_alloc(sizeof(float));
+    *C_dist = (float *)trmm_arena_alloc(sizeof(float));
+  }
+  // Check if memory allocation was successful
+  if (*A_dist == NULL || *B_dist == NULL || *C_dist == NULL) {
+    printf("Memory allocation failed\n");
+    exit(1);
+  }
+}
+
+void DISTRIBUTE_DATA(int m0, int n0, float *A_seq, float *B_seq, float *C_seq,
+                     float *A_dist, float *B_dist, float *C_dist) {
+  // C is not an input: COMPUTE_OP overwrites it
+  (void)C_seq;
+  (void)C_dist;
+
+  int root_id = 0;
+  int num_ranks;
+  int rid;
+  // query the number of ranks from MPI using the default communicator
+  MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
+  // query the rank of the current process
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+
+  if (rid == root_id) {
+    // One bulk copy of A and B; C is overwritten by COMPUTE_OP
+    memcpy(A_dist, A_seq, (size_t)m0 * m0 * sizeof(float));
+    memcpy(B_dist, B_seq, (size_t)m0 * n0 * sizeof(float));
+  }
+}
+
+void COLLECTION(int m0, int n0, float *C_seq, float *C_dist) {
+  int root_id = 0;
+  int num_ranks;
+  int rid;
+  // query the number of ranks from MPI using the default communicator
+  MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
+  // query the rank of the current process
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+
+  if (rid == root_id) {
+    // Copy the data from the distributed matrix to the sequential matrix
+    memcpy(C_seq, C_dist, (size_t)m0 * n0 * sizeof(float));
+  }
+}
+
+void FREE_MEMORY(float *A_dist, float *B_dist, float *C_dist) {
+  // Free the memory allocated for the matrices (placeholders off the root)
+  trmm_arena_free(A_dist);
+  trmm_arena_free(B_dist);
+  trmm_arena_free(C_dist);
+}
+
+void REPORT_STATS(int m0, int n0) {
+  int rid;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+
+  if (rid == 0) {
+    fprintf(stderr,
+            "worksteal m0=%d n0=%d threads=%d tasks=%ld steals=%ld "
+            "idle=%.3f ms\n",
+            m0, n0, last_stats.num_threads, last_stats.tasks,
+            last_stats.steals, 1e3 * last_stats.idle_time);
+  }
+}
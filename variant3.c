@@ -1,6 +1,14 @@
 #include <mpi.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#include "trmm_arena.h"
+#include "trmm_layout.h"
+#include "trmm_mpi.h"
+#include "trmm_packed.h"
+#include "trmm_partition.h"
+#include "trmm_plan.h"
 
 #ifndef COMPUTE_OP
 #define COMPUTE_OP baseline_compute
@@ -14,6 +22,10 @@
 #define DISTRIBUTE_DATA baseline_distribute_data
 #endif
 
+#ifndef DISTRIBUTE_PACKED
+#define DISTRIBUTE_PACKED baseline_distribute_packed
+#endif
+
 #ifndef COLLECTION
 #define COLLECTION baseline_collect
 #endif
@@ -22,73 +34,301 @@
 #define FREE_MEMORY baseline_free
 #endif
 
+#ifndef REPORT_STATS
+#define REPORT_STATS baseline_report_stats
+#endif
+
+#ifndef INPLACE_OP
+#define INPLACE_OP baseline_inplace
+#endif
+
 #define BLOCK_SIZE 16
+
+// columns of B per thread work item of the in-place multiply
+#define INPLACE_STRIP 64
 #define min(a, b) (((a) < (b)) ? (a) : (b))
 
-void COMPUTE_OP(int m0, int n0, float *A, float *B, float *C) {
-  int num_ranks, rid;
-  MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
+/*
+Distribution modes (TRMM_DISTRIBUTION) are described in trmm_plan.h.
+
+COMPUTE_OP runs a plan (trmm_plan.h) that is created at the first call for
+a shape and kept until FREE_MEMORY, so repeated calls do no allocation and
+no partitioning.
+*/
+
+static trmm_plan_t cached_plan = NULL;
+
+/*
+Shared distribution (TRMM_DISTRIBUTION=shared)
+
+node_comm holds the ranks of one node and leader_comm the first rank of
+every node (MPI_COMM_NULL on the others); both are created at the first
+use and kept for the whole run. The leader of a node allocates the packed
+A followed by the full B in shared_win, the other ranks of the node
+allocate nothing and read the segment of their leader.
+*/
+static MPI_Comm node_comm = MPI_COMM_NULL;
+static MPI_Comm leader_comm = MPI_COMM_NULL;
+static MPI_Win shared_win = MPI_WIN_NULL;
+static float *shared_base = NULL;
+
+static void node_comms_create(void) {
+  if (node_comm != MPI_COMM_NULL) return;
+  int rid, node_rid;
   MPI_Comm_rank(MPI_COMM_WORLD, &rid);
 
-  // Calculate work distribution with load balancing
-  int rows_per_rank = m0 / num_ranks;
-  int extra_rows = m0 % num_ranks;
-  int start_row = rid * rows_per_rank + (rid < extra_rows ? rid : extra_rows);
-  int end_row = start_row + rows_per_rank + (rid < extra_rows ? 1 : 0);
-
-  // Local computation buffer
-  int local_rows = end_row - start_row;
-  float *local_C = (float *)calloc(local_rows * n0, sizeof(float));
-
-  // Blocked computation with correct triangular bounds
-  for (int i = start_row; i < end_row; i++) {
-    for (int j = 0; j < n0; j++) {
-      float sum = 0.0f;
-      // Only iterate up to current row i
-      for (int k = 0; k <= i; k++) {
-        sum += A[i * m0 + k] * B[k * n0 + j];
+  // keyed by world rank, so rank 0 leads its node and the leaders
+  MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, rid,
+                      MPI_INFO_NULL, &node_comm);
+  MPI_Comm_rank(node_comm, &node_rid);
+  MPI_Comm_split(MPI_COMM_WORLD, node_rid == 0 ? 0 : MPI_UNDEFINED, rid,
+                 &leader_comm);
+}
+
+// one window of size floats per node, collective over MPI_COMM_WORLD
+static void shared_window_allocate(size_t size) {
+  node_comms_create();
+  int node_rid;
+  MPI_Comm_rank(node_comm, &node_rid);
+
+  MPI_Aint bytes = node_rid == 0 ? ((MPI_Aint)size + 1) * sizeof(float) : 0;
+  float *local_base;
+  MPI_Win_allocate_shared(bytes, sizeof(float), MPI_INFO_NULL, node_comm,
+                          &local_base, &shared_win);
+
+  MPI_Aint segment_size;
+  int disp_unit;
+  MPI_Win_shared_query(shared_win, 0, &segment_size, &disp_unit,
+                       &shared_base);
+}
+
+void COMPUTE_OP(int m0, int n0, float *A, float *B, float *C) {
+  if (cached_plan == NULL || cached_plan->m0 != m0 || cached_plan->n0 != n0) {
+    trmm_plan_destroy(cached_plan);
+    cached_plan = trmm_plan_create(m0, n0, MPI_COMM_WORLD);
+  }
+  trmm_execute(cached_plan, A, B, C);
+}
+
+/*
+In-place multiply B := A * B (INPLACE_OP)
+
+The matrices are on the root only, in the layout of trmm_layout.h. Rows
+of the result are split with TRMM_PARTITION as in COMPUTE_OP, and every
+rank receives its working set straight out of the caller's matrices: its
+rows of A and the rows of B above its last row. The row datatypes read
+column major rows with stride lda or ldb, so the other ranks always get
+row major copies. No rank allocates a C. Every rank overwrites its rows
+of its B bottom-up, which is safe because row i only reads rows 0..i and
+those still hold their input when row i is written. The root does this
+straight in the caller's B once its sends are complete, then receives
+the rows of the other ranks into place. TRMM_DISTRIBUTION is not used.
+*/
+
+// rows[0..num_rows) of a matrix with strides (rs, cs), len columns each
+// (len 0: columns 0..row, the lower triangle)
+static MPI_Datatype rows_type(int num_rows, const int *rows, int len,
+                              size_t rs, size_t cs) {
+  MPI_Datatype *types =
+      (MPI_Datatype *)calloc(num_rows + 1, sizeof(MPI_Datatype));
+  int *blocklens = (int *)calloc(num_rows + 1, sizeof(int));
+  MPI_Aint *displs = (MPI_Aint *)calloc(num_rows + 1, sizeof(MPI_Aint));
+  for (int t = 0; t < num_rows; t++) {
+    MPI_Type_vector(len > 0 ? len : rows[t] + 1, 1, (int)cs, MPI_FLOAT,
+                    &types[t]);
+    blocklens[t] = 1;
+    displs[t] = (MPI_Aint)rows[t] * rs * sizeof(float);
+  }
+  MPI_Datatype type;
+  MPI_Type_create_struct(num_rows, blocklens, displs, types, &type);
+  MPI_Type_commit(&type);
+  for (int t = 0; t < num_rows; t++) MPI_Type_free(&types[t]);
+  free(types);
+  free(blocklens);
+  free(displs);
+  return type;
+}
+
+// columns [j0, j_end) of rows[0..num_rows) of B := A * B, last row first;
+// row t of A starts at A + a_offsets[t]
+static inline __attribute__((always_inline)) void inplace_strip(
+    int num_rows, const int *rows, int j0, int j_end, const float *A,
+    const size_t *a_offsets, size_t cs_A, float *B, size_t rs_B,
+    size_t cs_B) {
+  for (int t = num_rows - 1; t >= 0; t--) {
+    int i = rows[t];
+    const float *a_row = A + a_offsets[t];
+    float *b_i = B + i * rs_B;
+    float a_ii = a_row[i * cs_A];
+    for (int j = j0; j < j_end; j++) {
+      b_i[j * cs_B] *= a_ii;
+    }
+    for (int k = 0; k < i; k++) {
+      float a = a_row[k * cs_A];
+      const float *b_k = B + k * rs_B;
+      for (int j = j0; j < j_end; j++) {
+        b_i[j * cs_B] += a * b_k[j * cs_B];
       }
-      local_C[(i - start_row) * n0 + j] = sum;
     }
   }
+}
 
-  // Prepare for flexible gathering
-  int *recv_counts = NULL;
-  int *displs = NULL;
+// the columns are independent: strips of INPLACE_STRIP columns are shared
+// by the threads of the rank
+static void inplace_rows(int num_rows, const int *rows, int n0, const float *A,
+                         const size_t *a_offsets, size_t cs_A, float *B,
+                         size_t rs_B, size_t cs_B) {
+  int num_strips = (n0 + INPLACE_STRIP - 1) / INPLACE_STRIP;
+#pragma omp parallel for schedule(static)
+  for (int jb = 0; jb < num_strips; jb++) {
+    int j0 = jb * INPLACE_STRIP;
+    int j_end = min(j0 + INPLACE_STRIP, n0);
+    // row major matrices get a copy with constant unit strides
+    if (cs_A == 1 && cs_B == 1) {
+      inplace_strip(num_rows, rows, j0, j_end, A, a_offsets, 1, B, rs_B, 1);
+    } else {
+      inplace_strip(num_rows, rows, j0, j_end, A, a_offsets, cs_A, B, rs_B,
+                    cs_B);
+    }
+  }
+}
+
+void INPLACE_OP(int layout, int m0, int n0, float *A, int lda, float *B,
+                int ldb) {
+  int num_ranks, rid;
+  MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+
+  int mode = partition_mode_from_env();
+  int block = partition_block_from_env();
+  int *rows = (int *)malloc((m0 + 1) * sizeof(int));
+  size_t *a_offsets = (size_t *)malloc((m0 + 1) * sizeof(size_t));
+  int local_rows = partition_rows(mode, block, m0, num_ranks, rid, rows);
 
   if (rid == 0) {
-    recv_counts = (int *)malloc(num_ranks * sizeof(int));
-    displs = (int *)malloc(num_ranks * sizeof(int));
+    size_t rs_A, cs_A, rs_B, cs_B;
+    trmm_layout_strides(layout, lda, &rs_A, &cs_A);
+    trmm_layout_strides(layout, ldb, &rs_B, &cs_B);
 
-    int curr_displ = 0;
-    for (int r = 0; r < num_ranks; r++) {
-      int r_rows = (m0 / num_ranks) + (r < (m0 % num_ranks) ? 1 : 0);
-      recv_counts[r] = r_rows * n0;
-      displs[r] = curr_displ;
-      curr_displ += recv_counts[r];
+    MPI_Request *requests =
+        (MPI_Request *)malloc(2 * num_ranks * sizeof(MPI_Request));
+    MPI_Datatype *result_types =
+        (MPI_Datatype *)malloc(num_ranks * sizeof(MPI_Datatype));
+    int *r_rows = (int *)malloc((m0 + 1) * sizeof(int));
+    int *all_rows = (int *)malloc((m0 + 1) * sizeof(int));
+    for (int i = 0; i < m0; i++) all_rows[i] = i;
+
+    // Working set of every other rank, straight out of A and B
+    int num_requests = 0;
+    for (int r = 1; r < num_ranks; r++) {
+      int count = partition_rows(mode, block, m0, num_ranks, r, r_rows);
+      result_types[r] = MPI_DATATYPE_NULL;
+      if (count == 0) continue;
+      MPI_Datatype A_type = rows_type(count, r_rows, 0, rs_A, cs_A);
+      MPI_Datatype B_type = rows_type(rows_of_B_needed(count, r_rows),
+                                      all_rows, n0, rs_B, cs_B);
+      MPI_Isend(A, 1, A_type, r, 0, MPI_COMM_WORLD, &requests[num_requests++]);
+      MPI_Isend(B, 1, B_type, r, 1, MPI_COMM_WORLD, &requests[num_requests++]);
+      MPI_Type_free(&A_type);
+      MPI_Type_free(&B_type);
+      result_types[r] = rows_type(count, r_rows, n0, rs_B, cs_B);
     }
-  }
+    MPI_Waitall(num_requests, requests, MPI_STATUSES_IGNORE);
 
-  // Gather results using MPI_Gatherv
-  MPI_Gatherv(local_C, local_rows * n0, MPI_FLOAT, C, recv_counts, displs,
-              MPI_FLOAT, 0, MPI_COMM_WORLD);
+    // The root's rows, straight in the caller's B
+    for (int t = 0; t < local_rows; t++) a_offsets[t] = rows[t] * rs_A;
+    inplace_rows(local_rows, rows, n0, A, a_offsets, cs_A, B, rs_B, cs_B);
 
-  free(local_C);
-  if (rid == 0) {
-    free(recv_counts);
-    free(displs);
+    // Rows of the other ranks land in place
+    num_requests = 0;
+    for (int r = 1; r < num_ranks; r++) {
+      if (result_types[r] == MPI_DATATYPE_NULL) continue;
+      MPI_Irecv(B, 1, result_types[r], r, 2, MPI_COMM_WORLD,
+                &requests[num_requests++]);
+    }
+    MPI_Waitall(num_requests, requests, MPI_STATUSES_IGNORE);
+
+    for (int r = 1; r < num_ranks; r++) {
+      if (result_types[r] != MPI_DATATYPE_NULL) {
+        MPI_Type_free(&result_types[r]);
+      }
+    }
+    free(requests);
+    free(result_types);
+    free(r_rows);
+    free(all_rows);
+  } else if (local_rows > 0) {
+    // Packed rows of A and the leading rows of B, both row major
+    size_t A_size = (size_t)partition_cost(local_rows, rows);
+    int B_rows = rows_of_B_needed(local_rows, rows);
+    float *A_local = (float *)trmm_arena_alloc((A_size + 1) * sizeof(float));
+    float *B_local =
+        (float *)trmm_arena_alloc(((size_t)B_rows * n0 + 1) * sizeof(float));
+    if (A_local == NULL || B_local == NULL) {
+      printf("Rank %d: Memory allocation failed\n", rid);
+      MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    trmm_mpi_recv(A_local, A_size, MPI_FLOAT, 0, 0, MPI_COMM_WORLD);
+    trmm_mpi_recv(B_local, (size_t)B_rows * n0, MPI_FLOAT, 0, 1,
+                  MPI_COMM_WORLD);
+
+    // the packed rows of A hold columns 0..i, one after the other
+    size_t a_offset = 0;
+    for (int t = 0; t < local_rows; t++) {
+      a_offsets[t] = a_offset;
+      a_offset += rows[t] + 1;
+    }
+    inplace_rows(local_rows, rows, n0, A_local, a_offsets, 1, B_local, n0, 1);
+
+    // Only the rows of this rank go back
+    MPI_Datatype result_type = rows_type(local_rows, rows, n0, n0, 1);
+    MPI_Send(B_local, 1, result_type, 0, 2, MPI_COMM_WORLD);
+    MPI_Type_free(&result_type);
+
+    trmm_arena_free(A_local);
+    trmm_arena_free(B_local);
   }
+
+  free(rows);
+  free(a_offsets);
 }
 
 void DISTRIBUTE_ALLOCATION(int m0, int n0, float **A_dist, float **B_dist,
                            float **C_dist) {
-  int rid;
+  int num_ranks, rid;
+  MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
   MPI_Comm_rank(MPI_COMM_WORLD, &rid);
 
-  // Allocate memory on all ranks
-  *A_dist = (float *)malloc(m0 * m0 * sizeof(float));
-  *B_dist = (float *)malloc(m0 * n0 * sizeof(float));
-  *C_dist = (float *)malloc(m0 * n0 * sizeof(float));
+  // Replicated: packed A, full B and C on all ranks
+  size_t A_size = TRMM_PACKED_SIZE(m0);
+  size_t B_size = (size_t)m0 * n0;
+  size_t C_size = (size_t)m0 * n0;
+
+  // Working set: local rows of A, leading rows of B, C only on the root
+  int dist = distribution_mode_from_env();
+  if (dist == DIST_WORKING_SET) {
+    int *rows = (int *)malloc(m0 * sizeof(int));
+    int local_rows =
+        partition_rows(partition_mode_from_env(), partition_block_from_env(),
+                       m0, num_ranks, rid, rows);
+    A_size = (size_t)partition_cost(local_rows, rows);
+    B_size = (size_t)rows_of_B_needed(local_rows, rows) * n0;
+    if (rid != 0) C_size = 0;
+    free(rows);
+  }
+
+  // Shared: A and B in the window of the node, C only on the root
+  if (dist == DIST_SHARED) {
+    if (rid != 0) C_size = 0;
+    shared_window_allocate(A_size + B_size);
+    *A_dist = shared_base;
+    *B_dist = shared_base + A_size;
+  } else {
+    // (one extra element keeps empty buffers non NULL)
+    *A_dist = (float *)trmm_arena_alloc((A_size + 1) * sizeof(float));
+    *B_dist = (float *)trmm_arena_alloc((B_size + 1) * sizeof(float));
+  }
+  *C_dist = (float *)trmm_arena_alloc((C_size + 1) * sizeof(float));
 
   if (*A_dist == NULL || *B_dist == NULL || *C_dist == NULL) {
     printf("Rank %d: Memory allocation failed\n", rid);
@@ -96,46 +336,200 @@ void DISTRIBUTE_ALLOCATION(int m0, int n0, float **A_dist, float **B_dist,
   }
 }
 
-void DISTRIBUTE_DATA(int m0, int n0, float *A_seq, float *B_seq, float *C_seq,
-                     float *A_dist, float *B_dist, float *C_dist) {
-  int rid;
+// inputs from the root to every rank, A either row major or (packed set)
+// in packed storage
+static void distribute_inputs(int m0, int n0, const float *A, int packed,
+                              float *B_seq, float *A_dist, float *B_dist) {
+  int num_ranks, rid;
+  MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
   MPI_Comm_rank(MPI_COMM_WORLD, &rid);
 
-  // Root copies data to buffers
+  int dist = distribution_mode_from_env();
+  if (dist == DIST_SHARED) {
+    MPI_Win_fence(MPI_MODE_NOPRECEDE, shared_win);
+
+    // Root fills the window of its node, the leaders pass it to theirs
+    if (rid == 0) {
+      copy_lower_triangular(m0, A, packed, A_dist);
+      memcpy(B_dist, B_seq, (size_t)m0 * n0 * sizeof(float));
+    }
+    if (leader_comm != MPI_COMM_NULL) {
+      trmm_mpi_bcast(A_dist, TRMM_PACKED_SIZE(m0), MPI_FLOAT, 0, leader_comm);
+      trmm_mpi_bcast(B_dist, (size_t)m0 * n0, MPI_FLOAT, 0, leader_comm);
+    }
+
+    // Stores of the leader are visible to the node after the fence
+    MPI_Win_fence(MPI_MODE_NOSUCCEED, shared_win);
+    return;
+  }
+
+  if (dist == DIST_REPLICATE) {
+    // Root copies data to buffers
+    if (rid == 0) {
+      // Pack lower triangular part of A
+      copy_lower_triangular(m0, A, packed, A_dist);
+      // Full matrix for B
+      memcpy(B_dist, B_seq, (size_t)m0 * n0 * sizeof(float));
+    }
+
+    // Broadcast data to all ranks
+    trmm_mpi_bcast(A_dist, TRMM_PACKED_SIZE(m0), MPI_FLOAT, 0, MPI_COMM_WORLD);
+    trmm_mpi_bcast(B_dist, (size_t)m0 * n0, MPI_FLOAT, 0, MPI_COMM_WORLD);
+    return;
+  }
+
+  int mode = partition_mode_from_env();
+  int block = partition_block_from_env();
+  int *rows = (int *)malloc(m0 * sizeof(int));
+
+  // Root sends every rank its working set straight out of A and B_seq
+  MPI_Request *requests = NULL;
+  MPI_Datatype *types = NULL;
   if (rid == 0) {
-    // Copy lower triangular part of A
-    for (int i = 0; i < m0; i++) {
-      for (int j = 0; j <= i; j++) {
-        A_dist[i * m0 + j] = A_seq[i * m0 + j];
+    requests = (MPI_Request *)malloc(2 * num_ranks * sizeof(MPI_Request));
+    types = (MPI_Datatype *)malloc(num_ranks * sizeof(MPI_Datatype));
+    int *blocklens = (int *)malloc(m0 * sizeof(int));
+    MPI_Aint *displs = (MPI_Aint *)malloc(m0 * sizeof(MPI_Aint));
+
+    for (int r = 0; r < num_ranks; r++) {
+      int r_rows = partition_rows(mode, block, m0, num_ranks, r, rows);
+
+      // Lower triangular part of the rows of rank r (byte displacements:
+      // element offsets pass 2^31 from m0 = 46341 on)
+      for (int t = 0; t < r_rows; t++) {
+        blocklens[t] = rows[t] + 1;
+        displs[t] =
+            (MPI_Aint)(lower_row_offset(m0, packed, rows[t]) * sizeof(float));
       }
+      MPI_Type_create_hindexed(r_rows, blocklens, displs, MPI_FLOAT,
+                               &types[r]);
+      MPI_Type_commit(&types[r]);
+      MPI_Isend(A, 1, types[r], r, 0, MPI_COMM_WORLD, &requests[2 * r]);
+
+      // Leading rows of B
+      trmm_mpi_isend(B_seq, (size_t)rows_of_B_needed(r_rows, rows) * n0,
+                     MPI_FLOAT, r, 1, MPI_COMM_WORLD, &requests[2 * r + 1]);
     }
-    // Full matrices for B and C
-    for (int i = 0; i < m0 * n0; i++) {
-      B_dist[i] = B_seq[i];
-      C_dist[i] = C_seq[i];
-    }
+
+    free(blocklens);
+    free(displs);
   }
 
-  // Broadcast data to all ranks
-  MPI_Bcast(A_dist, m0 * m0, MPI_FLOAT, 0, MPI_COMM_WORLD);
-  MPI_Bcast(B_dist, m0 * n0, MPI_FLOAT, 0, MPI_COMM_WORLD);
-  MPI_Bcast(C_dist, m0 * n0, MPI_FLOAT, 0, MPI_COMM_WORLD);
+  int local_rows = partition_rows(mode, block, m0, num_ranks, rid, rows);
+  trmm_mpi_recv(A_dist, (size_t)partition_cost(local_rows, rows), MPI_FLOAT,
+                0, 0, MPI_COMM_WORLD);
+  trmm_mpi_recv(B_dist, (size_t)rows_of_B_needed(local_rows, rows) * n0,
+                MPI_FLOAT, 0, 1, MPI_COMM_WORLD);
+
+  if (rid == 0) {
+    MPI_Waitall(2 * num_ranks, requests, MPI_STATUSES_IGNORE);
+    for (int r = 0; r < num_ranks; r++) MPI_Type_free(&types[r]);
+    free(requests);
+    free(types);
+  }
+  free(rows);
+}
+
+void DISTRIBUTE_DATA(int m0, int n0, float *A_seq, float *B_seq, float *C_seq,
+                     float *A_dist, float *B_dist, float *C_dist) {
+  // C is not an input: COMPUTE_OP overwrites it
+  (void)C_seq;
+  (void)C_dist;
+  distribute_inputs(m0, n0, A_seq, 0, B_seq, A_dist, B_dist);
+}
+
+// DISTRIBUTE_DATA with A already in packed storage on the root
+void DISTRIBUTE_PACKED(int m0, int n0, float *A_packed, float *B_seq,
+                       float *C_seq, float *A_dist, float *B_dist,
+                       float *C_dist) {
+  (void)C_seq;
+  (void)C_dist;
+  distribute_inputs(m0, n0, A_packed, 1, B_seq, A_dist, B_dist);
 }
 
 void COLLECTION(int m0, int n0, float *C_seq, float *C_dist) {
   int rid;
   MPI_Comm_rank(MPI_COMM_WORLD, &rid);
 
-  // Root collects final results (already handled in COMPUTE_OP's MPI_Gather)
+  // Root collects final results (rows already placed by COMPUTE_OP)
   if (rid == 0) {
-    for (int i = 0; i < m0 * n0; i++) {
-      C_seq[i] = C_dist[i];
-    }
+    memcpy(C_seq, C_dist, (size_t)m0 * n0 * sizeof(float));
   }
 }
 
 void FREE_MEMORY(float *A_dist, float *B_dist, float *C_dist) {
-  free(A_dist);
-  free(B_dist);
-  free(C_dist);
-}
\ No newline at end of file
+  trmm_plan_destroy(cached_plan);
+  cached_plan = NULL;
+  if (shared_win != MPI_WIN_NULL && A_dist == shared_base) {
+    // collective over the node, like the allocation
+    MPI_Win_free(&shared_win);
+    shared_base = NULL;
+  } else {
+    trmm_arena_free(A_dist);
+    trmm_arena_free(B_dist);
+  }
+  trmm_arena_free(C_dist);
+}
+
+void REPORT_STATS(int m0, int n0) {
+  int num_ranks, rid;
+  MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+
+  int mode = partition_mode_from_env();
+  int block = partition_block_from_env();
+  int *rows = (int *)malloc(m0 * sizeof(int));
+  int local_rows = partition_rows(mode, block, m0, num_ranks, rid, rows);
+
+  // Multiply-adds done by this rank
+  long long local_cost = partition_cost(local_rows, rows) * n0;
+  long long *costs = NULL;
+  if (rid == 0) {
+    costs = (long long *)malloc(num_ranks * sizeof(long long));
+  }
+  MPI_Gather(&local_cost, 1, MPI_LONG_LONG, costs, 1, MPI_LONG_LONG, 0,
+             MPI_COMM_WORLD);
+
+  // Root prints the flop share of every rank to stderr
+  if (rid == 0) {
+    long long total = 0;
+    long long max_cost = 0;
+    for (int r = 0; r < num_ranks; r++) {
+      total += costs[r];
+      if (costs[r] > max_cost) max_cost = costs[r];
+    }
+    fprintf(stderr, "partition=%s m0=%d n0=%d", partition_names[mode], m0,
+            n0);
+    for (int r = 0; r < num_ranks; r++) {
+      fprintf(stderr, " r%d:%.1f%%", r,
+              total > 0 ? 100.0 * costs[r] / total : 0.0);
+    }
+    fprintf(stderr, " max/avg=%.3f",
+            total > 0 ? (double)max_cost * num_ranks / total : 1.0);
+
+    // Floats received by the ranks, relative to broadcasting A, B and C
+    // (shared: only the leaders of the other nodes receive anything)
+    int dist = distribution_mode_from_env();
+    int receivers = num_ranks - 1;
+    if (dist == DIST_SHARED && leader_comm != MPI_COMM_NULL) {
+      MPI_Comm_size(leader_comm, &receivers);
+      receivers -= 1;
+    }
+    double moved = (double)receivers * (TRMM_PACKED_SIZE(m0) + (size_t)m0 * n0);
+    if (dist == DIST_WORKING_SET) {
+      moved = 0.0;
+      for (int r = 1; r < num_ranks; r++) {
+        int r_rows = partition_rows(mode, block, m0, num_ranks, r, rows);
+        moved += partition_cost(r_rows, rows) +
+                 (double)rows_of_B_needed(r_rows, rows) * n0;
+      }
+    }
+    double full = (double)(num_ranks - 1) * ((double)m0 * m0 + 2.0 * m0 * n0);
+    fprintf(stderr, " dist=%s moved=%.0f floats (%.1f%% of A,B,C bcasts)\n",
+            distribution_names[dist], moved,
+            full > 0 ? 100.0 * moved / full : 0.0);
+    free(costs);
+  }
+
+  free(rows);
+}
@@ -0,0 +1,174 @@
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "trmm_arena.h"
+#include "trmm_batch.h"
+#include "trmm_kernels.h"
+#include "trmm_mpi.h"
+#include "trmm_packed.h"
+
+#ifndef COMPUTE_OP
+#define COMPUTE_OP baseline_compute
+#endif
+
+#ifndef DISTRIBUTE_ALLOCATION
+#define DISTRIBUTE_ALLOCATION baseline_distribute
+#endif
+
+#ifndef DISTRIBUTE_DATA
+#define DISTRIBUTE_DATA baseline_distribute_data
+#endif
+
+#ifndef DISTRIBUTE_PACKED
+#define DISTRIBUTE_PACKED baseline_distribute_packed
+#endif
+
+#ifndef COLLECTION
+#define COLLECTION baseline_collect
+#endif
+
+#ifndef FREE_MEMORY
+#define FREE_MEMORY baseline_free
+#endif
+
+#ifndef BATCH_OP
+#define BATCH_OP baseline_batch
+#endif
+
+/*
+Variant 3 data distribution with a hand-vectorized compute kernel
+
+Every rank computes its block of rows of C with the TRMM_MR x TRMM_NR
+register-tiled micro-kernel from trmm_kernels.h: elements of A are
+broadcast, rows of B are streamed and the products are accumulated with
+FMA. Diagonal tiles stop each row at the diagonal and edge tiles use masked
+loads, so there is no scalar cleanup code.
+*/
+
+void COMPUTE_OP(int m0, int n0, float *A, float *B, float *C) {
+  int num_ranks, rid;
+  MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+
+  // Calculate work distribution with load balancing
+  int rows_per_rank = m0 / num_ranks;
+  int extra_rows = m0 % num_ranks;
+  int start_row = rid * rows_per_rank + (rid < extra_rows ? rid : extra_rows);
+  int end_row = start_row + rows_per_rank + (rid < extra_rows ? 1 : 0);
+
+  // Local computation buffer
+  int local_rows = end_row - start_row;
+  float *local_C = (float *)trmm_arena_alloc(
+      ((size_t)local_rows * n0 + 1) * sizeof(float));
+
+  // Register-tiled computation of the local rows
+  trmm_lower_rows_packed(start_row, end_row, n0, A, B, n0, local_C, n0);
+
+  // Gather the row blocks in place on the root (point to point with
+  // size_t counts and offsets: MPI_Gatherv takes int counts and
+  // displacements, which overflow once C passes 2^31 elements)
+  MPI_Request *requests = NULL;
+  if (rid == 0) {
+    requests = (MPI_Request *)malloc(num_ranks * sizeof(MPI_Request));
+
+    size_t curr_displ = 0;
+    for (int r = 0; r < num_ranks; r++) {
+      int r_rows = (m0 / num_ranks) + (r < (m0 % num_ranks) ? 1 : 0);
+      trmm_mpi_irecv(C + curr_displ, (size_t)r_rows * n0, MPI_FLOAT, r, 0,
+                     MPI_COMM_WORLD, &requests[r]);
+      curr_displ += (size_t)r_rows * n0;
+    }
+  }
+
+  trmm_mpi_send(local_C, (size_t)local_rows * n0, MPI_FLOAT, 0, 0,
+                MPI_COMM_WORLD);
+
+  trmm_arena_free(local_C);
+  if (rid == 0) {
+    MPI_Waitall(num_ranks, requests, MPI_STATUSES_IGNORE);
+    free(requests);
+  }
+}
+
+void DISTRIBUTE_ALLOCATION(int m0, int n0, float **A_dist, float **B_dist,
+                           float **C_dist) {
+  int rid;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+
+  // Allocate memory on all ranks
+  // A only keeps its lower triangle in packed storage
+  *A_dist = (float *)trmm_arena_alloc(TRMM_PACKED_SIZE(m0) * sizeof(float));
+  *B_dist = (float *)trmm_arena_alloc((size_t)m0 * n0 * sizeof(float));
+  *C_dist = (float *)trmm_arena_alloc((size_t)m0 * n0 * sizeof(float));
+
+  if (*A_dist == NULL || *B_dist == NULL || *C_dist == NULL) {
+    printf("Rank %d: Memory allocation failed\n", rid);
+    MPI_Abort(MPI_COMM_WORLD, 1);
+  }
+}
+
+// inputs from the root to every rank, A either row major or (packed set)
+// in packed storage
+static void distribute_inputs(int m0, int n0, const float *A, int packed,
+                              float *B_seq, float *C_seq, float *A_dist,
+                              float *B_dist, float *C_dist) {
+  int rid;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+
+  // Root copies data to buffers
+  if (rid == 0) {
+    // Pack lower triangular part of A
+    copy_lower_triangular(m0, A, packed, A_dist);
+    // Full matrices for B and C
+    for (size_t i = 0; i < (size_t)m0 * n0; i++) {
+      B_dist[i] = B_seq[i];
+      C_dist[i] = C_seq[i];
+    }
+  }
+
+  // Broadcast data to all ranks
+  trmm_mpi_bcast(A_dist, TRMM_PACKED_SIZE(m0), MPI_FLOAT, 0, MPI_COMM_WORLD);
+  trmm_mpi_bcast(B_dist, (size_t)m0 * n0, MPI_FLOAT, 0, MPI_COMM_WORLD);
+  trmm_mpi_bcast(C_dist, (size_t)m0 * n0, MPI_FLOAT, 0, MPI_COMM_WORLD);
+}
+
+void DISTRIBUTE_DATA(int m0, int n0, float *A_seq, float *B_seq, float *C_seq,
+                     float *A_dist, float *B_dist, float *C_dist) {
+  distribute_inputs(m0, n0, A_seq, 0, B_seq, C_seq, A_dist, B_dist, C_dist);
+}
+
+// DISTRIBUTE_DATA with A already in packed storage on the root
+void DISTRIBUTE_PACKED(int m0, int n0, float *A_packed, float *B_seq,
+                       float *C_seq, float *A_dist, float *B_dist,
+                       float *C_dist) {
+  distribute_inputs(m0, n0, A_packed, 1, B_seq, C_seq, A_dist, B_dist,
+                    C_dist);
+}
+
+void COLLECTION(int m0, int n0, float *C_seq, float *C_dist) {
+  int rid;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+
+  // Root collects final results (already handled in COMPUTE_OP's MPI_Gather)
+  if (rid == 0) {
+    for (size_t i = 0; i < (size_t)m0 * n0; i++) {
+      C_seq[i] = C_dist[i];
+    }
+  }
+}
+
+void FREE_MEMORY(float *A_dist, float *B_dist, float *C_dist) {
+  trmm_arena_free(A_dist);
+  trmm_arena_free(B_dist);
+  trmm_arena_free(C_dist);
+}
+
+/*
+Batch of count independent m0 x n0 problems stored back to back on the root
+(A matrices m0 x m0, B and C matrices m0 x n0), see trmm_batch.h
+*/
+void BATCH_OP(int count, int m0, int n0, float *A, float *B, float *C) {
+  trmm_batch_strided(count, m0, n0, A, (long)m0 * m0, B, (long)m0 * n0, C,
+                     (long)m0 * n0, MPI_COMM_WORLD);
+}
@@ -0,0 +1,284 @@
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "trmm_arena.h"
+#include "trmm_blas.h"
+#include "trmm_io.h"
+#include "trmm_kernels.h"
+#include "trmm_mpi.h"
+#include "trmm_packed.h"
+#include "trmm_partition.h"
+
+#ifndef COMPUTE_OP
+#define COMPUTE_OP baseline_compute
+#endif
+
+#ifndef DISTRIBUTE_ALLOCATION
+#define DISTRIBUTE_ALLOCATION baseline_distribute
+#endif
+
+#ifndef DISTRIBUTE_DATA
+#define DISTRIBUTE_DATA baseline_distribute_data
+#endif
+
+#ifndef DISTRIBUTE_PACKED
+#define DISTRIBUTE_PACKED baseline_distribute_packed
+#endif
+
+#ifndef COLLECTION
+#define COLLECTION baseline_collect
+#endif
+
+#ifndef FREE_MEMORY
+#define FREE_MEMORY baseline_free
+#endif
+
+#ifndef TRMM_OP
+#define TRMM_OP baseline_trmm
+#endif
+
+#ifndef STRIDED_OP
+#define STRIDED_OP baseline_strided
+#endif
+
+#ifndef DISTRIBUTE_FILE
+#define DISTRIBUTE_FILE baseline_distribute_file
+#endif
+
+#ifndef COLLECTION_FILE
+#define COLLECTION_FILE baseline_collect_file
+#endif
+
+/*
+Column partitioned distribution of B and C
+
+Every column of C = A * B only depends on the same column of B and costs
+the same m0 * (m0 + 1) / 2 multiply-adds, so splitting B and C into blocks
+of columns balances the work with no triangular skew. A is broadcast once
+in packed storage, the column block of B is sent straight out of the
+caller's row major B_seq with a strided MPI datatype (no repacking on the
+root) and COLLECTION gathers the column blocks of C the same way.
+
+On each rank B_dist and C_dist are m0 x local_cols row major matrices.
+*/
+
+void COMPUTE_OP(int m0, int n0, float *A, float *B, float *C) {
+  int num_ranks, rid;
+  MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+
+  int col_start, local_cols;
+  partition_column_block(n0, num_ranks, rid, &col_start, &local_cols);
+
+  // Every column needs the whole triangle of A, no communication required
+  trmm_lower_rows_packed(0, m0, local_cols, A, B, local_cols, C, local_cols);
+}
+
+void DISTRIBUTE_ALLOCATION(int m0, int n0, float **A_dist, float **B_dist,
+                           float **C_dist) {
+  int num_ranks, rid;
+  MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+
+  int col_start, local_cols;
+  partition_column_block(n0, num_ranks, rid, &col_start, &local_cols);
+
+  // Packed A on every rank, only the local column block of B and C
+  // (at least one element so ranks without columns get a valid buffer)
+  size_t local_size = (size_t)m0 * local_cols;
+  if (local_size == 0) local_size = 1;
+  *A_dist = (float *)trmm_arena_alloc(TRMM_PACKED_SIZE(m0) * sizeof(float));
+  *B_dist = (float *)trmm_arena_alloc(local_size * sizeof(float));
+  *C_dist = (float *)trmm_arena_alloc(local_size * sizeof(float));
+
+  if (*A_dist == NULL || *B_dist == NULL || *C_dist == NULL) {
+    printf("Rank %d: Memory allocation failed\n", rid);
+    MPI_Abort(MPI_COMM_WORLD, 1);
+  }
+}
+
+// inputs from the root to every rank, A either row major or (packed set)
+// in packed storage
+static void distribute_inputs(int m0, int n0, const float *A, int packed,
+                              float *B_seq, float *A_dist, float *B_dist) {
+  int num_ranks, rid;
+  MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+
+  int col_start, local_cols;
+  partition_column_block(n0, num_ranks, rid, &col_start, &local_cols);
+
+  // Root packs the lower triangle of A, which is broadcast once
+  if (rid == 0) {
+    copy_lower_triangular(m0, A, packed, A_dist);
+  }
+  trmm_mpi_bcast(A_dist, TRMM_PACKED_SIZE(m0), MPI_FLOAT, 0, MPI_COMM_WORLD);
+
+  // Root sends every rank its column block of B directly from B_seq
+  MPI_Request *requests = NULL;
+  MPI_Datatype *types = NULL;
+  if (rid == 0) {
+    requests = (MPI_Request *)malloc(num_ranks * sizeof(MPI_Request));
+    types = (MPI_Datatype *)malloc(num_ranks * sizeof(MPI_Datatype));
+    for (int r = 0; r < num_ranks; r++) {
+      int r_start, r_cols;
+      partition_column_block(n0, num_ranks, r, &r_start, &r_cols);
+      types[r] = partition_column_type(m0, n0, r_cols, MPI_FLOAT);
+      MPI_Isend(B_seq + r_start, r_cols > 0 ? 1 : 0, types[r], r, 0,
+                MPI_COMM_WORLD, &requests[r]);
+    }
+  }
+
+  trmm_mpi_recv(B_dist, (size_t)m0 * local_cols, MPI_FLOAT, 0, 0,
+                MPI_COMM_WORLD);
+
+  if (rid == 0) {
+    MPI_Waitall(num_ranks, requests, MPI_STATUSES_IGNORE);
+    for (int r = 0; r < num_ranks; r++) MPI_Type_free(&types[r]);
+    free(requests);
+    free(types);
+  }
+}
+
+void DISTRIBUTE_DATA(int m0, int n0, float *A_seq, float *B_seq, float *C_seq,
+                     float *A_dist, float *B_dist, float *C_dist) {
+  (void)C_seq;
+  (void)C_dist;
+  distribute_inputs(m0, n0, A_seq, 0, B_seq, A_dist, B_dist);
+}
+
+// DISTRIBUTE_DATA with A already in packed storage on the root
+void DISTRIBUTE_PACKED(int m0, int n0, float *A_packed, float *B_seq,
+                       float *C_seq, float *A_dist, float *B_dist,
+                       float *C_dist) {
+  (void)C_seq;
+  (void)C_dist;
+  distribute_inputs(m0, n0, A_packed, 1, B_seq, A_dist, B_dist);
+}
+
+void COLLECTION(int m0, int n0, float *C_seq, float *C_dist) {
+  int num_ranks, rid;
+  MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+
+  int col_start, local_cols;
+  partition_column_block(n0, num_ranks, rid, &col_start, &local_cols);
+
+  // Root receives every column block of C straight into place in C_seq
+  MPI_Request *requests = NULL;
+  MPI_Datatype *types = NULL;
+  if (rid == 0) {
+    requests = (MPI_Request *)malloc(num_ranks * sizeof(MPI_Request));
+    types = (MPI_Datatype *)malloc(num_ranks * sizeof(MPI_Datatype));
+    for (int r = 0; r < num_ranks; r++) {
+      int r_start, r_cols;
+      partition_column_block(n0, num_ranks, r, &r_start, &r_cols);
+      types[r] = partition_column_type(m0, n0, r_cols, MPI_FLOAT);
+      MPI_Irecv(C_seq + r_start, r_cols > 0 ? 1 : 0, types[r], r, 0,
+                MPI_COMM_WORLD, &requests[r]);
+    }
+  }
+
+  trmm_mpi_send(C_dist, (size_t)m0 * local_cols, MPI_FLOAT, 0, 0,
+                MPI_COMM_WORLD);
+
+  if (rid == 0) {
+    MPI_Waitall(num_ranks, requests, MPI_STATUSES_IGNORE);
+    for (int r = 0; r < num_ranks; r++) MPI_Type_free(&types[r]);
+    free(requests);
+    free(types);
+  }
+}
+
+void FREE_MEMORY(float *A_dist, float *B_dist, float *C_dist) {
+  trmm_arena_free(A_dist);
+  trmm_arena_free(B_dist);
+  trmm_arena_free(C_dist);
+}
+
+/*
+BLAS-style entry point (trmm_blas.h): the same split as COMPUTE_OP, by
+columns of B and C when A is on the left and by rows when it is on the
+right, with a dedicated kernel for every side/uplo/trans/diag case.
+Matrices on the root only, in the given layout and leading dimensions.
+*/
+void TRMM_OP(int layout, int side, int uplo, int trans, int diag, int m0,
+             int n0, float alpha, float *A, int lda, float *B, int ldb,
+             float *C, int ldc) {
+  trmm_blas(layout, side, uplo, trans, diag, m0, n0, alpha, A, lda, B, ldb, C,
+            ldc, MPI_COMM_WORLD);
+}
+
+/*
+C = A * B straight on the caller's matrices (trmm_layout.h): the columns of
+B and C are split as in COMPUTE_OP, but sent from and received into the
+root's matrices with strided datatypes, with no DISTRIBUTE_DATA or
+COLLECTION copy. Matrices on the root only.
+*/
+void STRIDED_OP(int layout, int m0, int n0, float *A, int lda, float *B,
+                int ldb, float *C, int ldc) {
+  trmm_blas(layout, TRMM_LEFT, TRMM_LOWER, TRMM_NOTRANS, TRMM_NONUNIT, m0, n0,
+            1.0f, A, lda, B, ldb, C, ldc, MPI_COMM_WORLD);
+}
+
+/*
+Inputs straight from matrix files (trmm_io.h): every rank reads the whole
+packed A and its column block of B through a subarray file view, and
+writes its column block of C the same way, so no rank holds more than the
+distributed buffers. B must be a full row major file and A a packed one.
+*/
+void DISTRIBUTE_FILE(int m0, int n0, const char *A_path, const char *B_path,
+                     float *A_dist, float *B_dist, float *C_dist) {
+  (void)C_dist;
+
+  int num_ranks, rid;
+  MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+
+  int col_start, local_cols;
+  partition_column_block(n0, num_ranks, rid, &col_start, &local_cols);
+
+  MPI_File file;
+  trmm_io_header_t header;
+  trmm_io_check(trmm_io_open(MPI_COMM_WORLD, A_path, MPI_MODE_RDONLY,
+                             &header, &file),
+                "open", A_path);
+  if (header.storage != TRMM_IO_PACKED_LOWER || header.rows != m0) {
+    trmm_io_check(-1, "read", A_path);
+  }
+  trmm_io_check(trmm_io_read_rows(file, &header, 0, m0, A_dist), "read",
+                A_path);
+  MPI_File_close(&file);
+
+  trmm_io_check(trmm_io_open(MPI_COMM_WORLD, B_path, MPI_MODE_RDONLY,
+                             &header, &file),
+                "open", B_path);
+  if (header.layout != TRMM_ROW_MAJOR || header.rows != m0 ||
+      header.cols != n0) {
+    trmm_io_check(-1, "read", B_path);
+  }
+  trmm_io_check(trmm_io_read_block(file, &header, 0, m0, col_start,
+                                   local_cols, B_dist),
+                "read", B_path);
+  MPI_File_close(&file);
+}
+
+void COLLECTION_FILE(int m0, int n0, const char *C_path, float *C_dist) {
+  int num_ranks, rid;
+  MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+
+  int col_start, local_cols;
+  partition_column_block(n0, num_ranks, rid, &col_start, &local_cols);
+
+  MPI_File file;
+  trmm_io_header_t header;
+  trmm_io_header_init(&header, m0, n0, TRMM_ROW_MAJOR, TRMM_IO_FULL);
+  trmm_io_check(trmm_io_create(MPI_COMM_WORLD, C_path, &header, &file),
+                "create", C_path);
+  trmm_io_check(trmm_io_write_block(file, &header, 0, m0, col_start,
+                                    local_cols, C_dist),
+                "write", C_path);
+  MPI_File_close(&file);
+}
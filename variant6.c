@@ -0,0 +1,379 @@
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trmm_arena.h"
+#include "trmm_kernels.h"
+#include "trmm_mpi.h"
+
+#ifndef COMPUTE_OP
+#define COMPUTE_OP baseline_compute
+#endif
+
+#ifndef DISTRIBUTE_ALLOCATION
+#define DISTRIBUTE_ALLOCATION baseline_distribute
+#endif
+
+#ifndef DISTRIBUTE_DATA
+#define DISTRIBUTE_DATA baseline_distribute_data
+#endif
+
+#ifndef COLLECTION
+#define COLLECTION baseline_collect
+#endif
+
+#ifndef FREE_MEMORY
+#define FREE_MEMORY baseline_free
+#endif
+
+#ifndef REPORT_STATS
+#define REPORT_STATS baseline_report_stats
+#endif
+
+#define BLOCK_SIZE 64
+#define min(a, b) (((a) < (b)) ? (a) : (b))
+
+/*
+2D block-cyclic distributed TRMM (SUMMA-style)
+
+The ranks form a p_rows x p_cols process grid (row major rank order, as
+chosen by MPI_Dims_create) and every matrix is cut into BLOCK_SIZE x
+BLOCK_SIZE blocks dealt out block-cyclically: block (ib, jb) lives on
+process (ib % p_rows, jb % p_cols). No rank ever holds a full matrix, so
+the memory per rank shrinks as ranks are added.
+
+  B, C  local row major matrices holding the rows of the local row blocks
+        and the columns of the local column blocks (ScaLAPACK layout)
+  A     lower triangle only: for every local column block kb, the tiles
+        (ib, kb) with ib >= kb of the local row blocks, each stored as a
+        padded BLOCK_SIZE x BLOCK_SIZE tile. Diagonal tiles have their
+        upper part zeroed.
+
+Step kb of the multiply broadcasts block column kb of A along the process
+rows and block row kb of B along the process columns, then every rank adds
+A(ib, kb) * B(kb, :) into its C(ib, :) for its row blocks ib >= kb. Since A
+is stored panel by panel the owner broadcasts straight from A_dist, and
+panels with no tile below the diagonal are skipped entirely.
+*/
+
+typedef struct {
+  int p_rows, p_cols;
+  int my_row, my_col;
+  MPI_Comm row_comm;  // ranks of the same process row, ordered by column
+  MPI_Comm col_comm;  // ranks of the same process column, ordered by row
+} grid_t;
+
+// process grid of MPI_COMM_WORLD (communicators are created once)
+static grid_t *get_grid(void) {
+  static grid_t grid;
+  static int initialized = 0;
+
+  if (!initialized) {
+    int num_ranks, rid;
+    MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+
+    int dims[2] = {0, 0};
+    MPI_Dims_create(num_ranks, 2, dims);
+    grid.p_rows = dims[0];
+    grid.p_cols = dims[1];
+    grid.my_row = rid / grid.p_cols;
+    grid.my_col = rid % grid.p_cols;
+
+    MPI_Comm_split(MPI_COMM_WORLD, grid.my_row, grid.my_col, &grid.row_comm);
+    MPI_Comm_split(MPI_COMM_WORLD, grid.my_col, grid.my_row, &grid.col_comm);
+    initialized = 1;
+  }
+  return &grid;
+}
+
+static int num_blocks(int n) { return (n + BLOCK_SIZE - 1) / BLOCK_SIZE; }
+
+// rows (or columns) in block b of a dimension of length n
+static int block_extent(int n, int b) {
+  return min(BLOCK_SIZE, n - b * BLOCK_SIZE);
+}
+
+// rows (or columns) of a dimension of length n owned by process p of np
+static int local_extent(int n, int p, int np) {
+  int extent = 0;
+  for (int b = p; b < num_blocks(n); b += np) extent += block_extent(n, b);
+  return extent;
+}
+
+// index (among the local row blocks of process row p) of the first ib >= kb
+static int first_local_block(int kb, int p, int np) {
+  return kb <= p ? 0 : (kb - p + np - 1) / np;
+}
+
+// number of row blocks ib >= kb owned by process row p
+static int tiles_below(int m0, int kb, int p, int np) {
+  int total = (num_blocks(m0) - p + np - 1) / np;
+  if (total < 0) total = 0;
+  int count = total - first_local_block(kb, p, np);
+  return count > 0 ? count : 0;
+}
+
+// number of A tiles stored by process (p_row, p_col) before panel kb
+static int tiles_before_panel(int m0, int kb, int p_row, int p_col,
+                              grid_t *g) {
+  int tiles = 0;
+  for (int jb = p_col; jb < kb; jb += g->p_cols)
+    tiles += tiles_below(m0, jb, p_row, g->p_rows);
+  return tiles;
+}
+
+// block-cyclic datatype selecting the local part of rank r in an
+// m x n row major matrix
+static MPI_Datatype block_cyclic_type(int m, int n, int r, grid_t *g) {
+  int gsizes[2] = {m, n};
+  int distribs[2] = {MPI_DISTRIBUTE_CYCLIC, MPI_DISTRIBUTE_CYCLIC};
+  int dargs[2] = {BLOCK_SIZE, BLOCK_SIZE};
+  int psizes[2] = {g->p_rows, g->p_cols};
+  MPI_Datatype type;
+  MPI_Type_create_darray(g->p_rows * g->p_cols, r, 2, gsizes, distribs, dargs,
+                         psizes, MPI_ORDER_C, MPI_FLOAT, &type);
+  MPI_Type_commit(&type);
+  return type;
+}
+
+void COMPUTE_OP(int m0, int n0, float *A, float *B, float *C) {
+  grid_t *g = get_grid();
+  int tile = BLOCK_SIZE * BLOCK_SIZE;
+
+  int local_rows = local_extent(m0, g->my_row, g->p_rows);
+  int local_cols = local_extent(n0, g->my_col, g->p_cols);
+
+  memset(C, 0, (size_t)local_rows * local_cols * sizeof(float));
+
+  // Receive buffers for the panels owned by other ranks (from the arena, so
+  // repeated calls reuse them)
+  int max_tiles = tiles_below(m0, 0, g->my_row, g->p_rows);
+  float *panel_A =
+      (float *)trmm_arena_alloc(((size_t)max_tiles * tile + 1) * sizeof(float));
+  float *panel_B =
+      (float *)trmm_arena_alloc(((size_t)BLOCK_SIZE * local_cols + 1) *
+                                sizeof(float));
+
+  for (int kb = 0; kb < num_blocks(m0); kb++) {
+    int kbs = block_extent(m0, kb);
+    int a_owner = kb % g->p_cols;
+    int b_owner = kb % g->p_rows;
+    int num_tiles = tiles_below(m0, kb, g->my_row, g->p_rows);
+
+    // Block column kb of A along the process row (skipped when this process
+    // row has no row block on or below the diagonal)
+    float *a_panel = panel_A;
+    if (num_tiles > 0) {
+      if (g->my_col == a_owner) {
+        a_panel = A + (size_t)tiles_before_panel(m0, kb, g->my_row,
+                                                 g->my_col, g) *
+                          tile;
+      }
+      trmm_mpi_bcast(a_panel, (size_t)num_tiles * tile, MPI_FLOAT, a_owner,
+                     g->row_comm);
+    }
+
+    // Block row kb of B along the process column
+    float *b_panel = panel_B;
+    if (g->my_row == b_owner) {
+      b_panel = B + (size_t)(kb / g->p_rows) * BLOCK_SIZE * local_cols;
+    }
+    trmm_mpi_bcast(b_panel, (size_t)kbs * local_cols, MPI_FLOAT, b_owner,
+                   g->col_comm);
+
+    // C(ib, :) += A(ib, kb) * B(kb, :) for the local row blocks ib >= kb
+    int t0 = first_local_block(kb, g->my_row, g->p_rows);
+    for (int t = 0; t < num_tiles; t++) {
+      int ib = g->my_row + (t0 + t) * g->p_rows;
+      float *C_block = C + (size_t)(t0 + t) * BLOCK_SIZE * local_cols;
+      trmm_block_acc(block_extent(m0, ib), local_cols, kbs, ib == kb,
+                     a_panel + (size_t)t * tile, BLOCK_SIZE, b_panel,
+                     local_cols, C_block, local_cols);
+    }
+  }
+
+  trmm_arena_free(panel_A);
+  trmm_arena_free(panel_B);
+}
+
+void DISTRIBUTE_ALLOCATION(int m0, int n0, float **A_dist, float **B_dist,
+                           float **C_dist) {
+  int rid;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+  grid_t *g = get_grid();
+
+  int local_rows = local_extent(m0, g->my_row, g->p_rows);
+  int local_cols = local_extent(n0, g->my_col, g->p_cols);
+  int num_tiles = tiles_before_panel(m0, num_blocks(m0), g->my_row,
+                                     g->my_col, g);
+
+  // Only the local blocks (one extra element keeps empty parts non NULL)
+  *A_dist = (float *)trmm_arena_alloc(
+      ((size_t)num_tiles * BLOCK_SIZE * BLOCK_SIZE + 1) * sizeof(float));
+  size_t local_size = (size_t)local_rows * local_cols + 1;
+  *B_dist = (float *)trmm_arena_alloc(local_size * sizeof(float));
+  *C_dist = (float *)trmm_arena_alloc(local_size * sizeof(float));
+
+  if (*A_dist == NULL || *B_dist == NULL || *C_dist == NULL) {
+    printf("Rank %d: Memory allocation failed\n", rid);
+    MPI_Abort(MPI_COMM_WORLD, 1);
+  }
+}
+
+void DISTRIBUTE_DATA(int m0, int n0, float *A_seq, float *B_seq, float *C_seq,
+                     float *A_dist, float *B_dist, float *C_dist) {
+  (void)C_seq;
+  (void)C_dist;
+
+  int num_ranks, rid;
+  MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+  grid_t *g = get_grid();
+  int tile = BLOCK_SIZE * BLOCK_SIZE;
+
+  int local_rows = local_extent(m0, g->my_row, g->p_rows);
+  int local_cols = local_extent(n0, g->my_col, g->p_cols);
+  int num_tiles = tiles_before_panel(m0, num_blocks(m0), g->my_row,
+                                     g->my_col, g);
+
+  MPI_Request *requests = NULL;
+  MPI_Datatype *types = NULL;
+
+  if (rid == 0) {
+    requests = (MPI_Request *)malloc(num_ranks * sizeof(MPI_Request));
+    types = (MPI_Datatype *)malloc(num_ranks * sizeof(MPI_Datatype));
+
+    // B goes out of B_seq directly with a block-cyclic datatype
+    for (int r = 0; r < num_ranks; r++) {
+      types[r] = block_cyclic_type(m0, n0, r, g);
+      MPI_Isend(B_seq, 1, types[r], r, 1, MPI_COMM_WORLD, &requests[r]);
+    }
+
+    // Root packs the lower triangular tiles of one rank at a time, panel by
+    // panel, into a buffer reused for every rank (its own go to A_dist)
+    int max_tiles = 0;
+    for (int r = 1; r < num_ranks; r++) {
+      int r_tiles = tiles_before_panel(m0, num_blocks(m0), r / g->p_cols,
+                                       r % g->p_cols, g);
+      if (r_tiles > max_tiles) max_tiles = r_tiles;
+    }
+    float *tiles = (float *)malloc(((size_t)max_tiles * tile + 1) *
+                                   sizeof(float));
+    if (tiles == NULL) {
+      printf("Rank %d: Memory allocation failed\n", rid);
+      MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    for (int r = 0; r < num_ranks; r++) {
+      int r_row = r / g->p_cols;
+      int r_col = r % g->p_cols;
+      int r_tiles = tiles_before_panel(m0, num_blocks(m0), r_row, r_col, g);
+      float *packed = r == 0 ? A_dist : tiles;
+      memset(packed, 0, (size_t)r_tiles * tile * sizeof(float));
+
+      float *t_ptr = packed;
+      for (int kb = r_col; kb < num_blocks(m0); kb += g->p_cols) {
+        int t0 = first_local_block(kb, r_row, g->p_rows);
+        int r_panel = tiles_below(m0, kb, r_row, g->p_rows);
+        for (int t = 0; t < r_panel; t++) {
+          int ib = r_row + (t0 + t) * g->p_rows;
+          for (int i = 0; i < block_extent(m0, ib); i++) {
+            int row = ib * BLOCK_SIZE + i;
+            for (int k = 0; k < block_extent(m0, kb); k++) {
+              int col = kb * BLOCK_SIZE + k;
+              if (col <= row)
+                t_ptr[i * BLOCK_SIZE + k] = A_seq[(size_t)row * m0 + col];
+            }
+          }
+          t_ptr += tile;
+        }
+      }
+      if (r != 0) {
+        trmm_mpi_send(tiles, (size_t)r_tiles * tile, MPI_FLOAT, r, 0,
+                      MPI_COMM_WORLD);
+      }
+    }
+    free(tiles);
+  } else {
+    trmm_mpi_recv(A_dist, (size_t)num_tiles * tile, MPI_FLOAT, 0, 0,
+                  MPI_COMM_WORLD);
+  }
+
+  trmm_mpi_recv(B_dist, (size_t)local_rows * local_cols, MPI_FLOAT, 0, 1,
+                MPI_COMM_WORLD);
+
+  if (rid == 0) {
+    MPI_Waitall(num_ranks, requests, MPI_STATUSES_IGNORE);
+    for (int r = 0; r < num_ranks; r++) MPI_Type_free(&types[r]);
+    free(requests);
+    free(types);
+  }
+}
+
+void COLLECTION(int m0, int n0, float *C_seq, float *C_dist) {
+  int num_ranks, rid;
+  MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+  grid_t *g = get_grid();
+
+  int local_rows = local_extent(m0, g->my_row, g->p_rows);
+  int local_cols = local_extent(n0, g->my_col, g->p_cols);
+
+  // Root receives the local blocks of every rank straight into C_seq
+  MPI_Request *requests = NULL;
+  MPI_Datatype *types = NULL;
+  if (rid == 0) {
+    requests = (MPI_Request *)malloc(num_ranks * sizeof(MPI_Request));
+    types = (MPI_Datatype *)malloc(num_ranks * sizeof(MPI_Datatype));
+    for (int r = 0; r < num_ranks; r++) {
+      types[r] = block_cyclic_type(m0, n0, r, g);
+      MPI_Irecv(C_seq, 1, types[r], r, 0, MPI_COMM_WORLD, &requests[r]);
+    }
+  }
+
+  trmm_mpi_send(C_dist, (size_t)local_rows * local_cols, MPI_FLOAT, 0, 0,
+                MPI_COMM_WORLD);
+
+  if (rid == 0) {
+    MPI_Waitall(num_ranks, requests, MPI_STATUSES_IGNORE);
+    for (int r = 0; r < num_ranks; r++) MPI_Type_free(&types[r]);
+    free(requests);
+    free(types);
+  }
+}
+
+void FREE_MEMORY(float *A_dist, float *B_dist, float *C_dist) {
+  trmm_arena_free(A_dist);
+  trmm_arena_free(B_dist);
+  trmm_arena_free(C_dist);
+}
+
+void REPORT_STATS(int m0, int n0) {
+  int num_ranks, rid;
+  MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+  grid_t *g = get_grid();
+
+  // Elements stored by this rank for A, B and C
+  long local_rows = local_extent(m0, g->my_row, g->p_rows);
+  long local_cols = local_extent(n0, g->my_col, g->p_cols);
+  long local_elems = (long)tiles_before_panel(m0, num_blocks(m0), g->my_row,
+                                              g->my_col, g) *
+                         BLOCK_SIZE * BLOCK_SIZE +
+                     2 * local_rows * local_cols;
+  long max_elems;
+  MPI_Reduce(&local_elems, &max_elems, 1, MPI_LONG, MPI_MAX, 0,
+             MPI_COMM_WORLD);
+
+  // Root compares it with a full copy of A, B and C
+  if (rid == 0) {
+    long full_elems = (long)m0 * m0 + 2L * m0 * n0;
+    fprintf(stderr,
+            "grid=%dx%d block=%d m0=%d n0=%d max_elems_per_rank=%ld "
+            "(%.1f%% of a replicated copy)\n",
+            g->p_rows, g->p_cols, BLOCK_SIZE, m0, n0, max_elems,
+            100.0 * max_elems / full_elems);
+  }
+}
@@ -0,0 +1,339 @@
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trmm_arena.h"
+#include "trmm_kernels.h"
+#include "trmm_mpi.h"
+#include "trmm_packed.h"
+#include "trmm_partition.h"
+
+#ifndef COMPUTE_OP
+#define COMPUTE_OP baseline_compute
+#endif
+
+#ifndef DISTRIBUTE_ALLOCATION
+#define DISTRIBUTE_ALLOCATION baseline_distribute
+#endif
+
+#ifndef DISTRIBUTE_DATA
+#define DISTRIBUTE_DATA baseline_distribute_data
+#endif
+
+#ifndef DISTRIBUTE_PACKED
+#define DISTRIBUTE_PACKED baseline_distribute_packed
+#endif
+
+#ifndef COLLECTION
+#define COLLECTION baseline_collect
+#endif
+
+#ifndef FREE_MEMORY
+#define FREE_MEMORY baseline_free
+#endif
+
+#ifndef REPORT_STATS
+#define REPORT_STATS baseline_report_stats
+#endif
+
+// rows of B per pipeline stage (multiple of TRMM_MR so that no register
+// tile of C crosses a panel boundary on the diagonal)
+#define PANEL_SIZE 96
+#define min(a, b) (((a) < (b)) ? (a) : (b))
+
+#if PANEL_SIZE % TRMM_MR != 0
+#error "PANEL_SIZE must be a multiple of TRMM_MR"
+#endif
+
+/*
+Pipelined variant: communication of B and C overlaps the computation
+
+Rows of C are split in flop-balanced contiguous blocks [s, e) and each
+rank keeps its rows of A (packed, scattered once by DISTRIBUTE_DATA). B
+stays on the root and is streamed by COMPUTE_OP in panels of PANEL_SIZE
+rows: every rank preposts an MPI_Irecv for each panel it needs (the panels
+below row e), so while it updates its rows of C with panel k the following
+panels are already in flight. Rows of C are final once the panel holding
+their diagonal has been applied, and those rows are sent to the root with
+MPI_Isend right away.
+
+The panels go point to point rather than through MPI_Ibcast because rank
+r only needs the panels above its row e: a broadcast would move all of B
+to every rank. The root posts the sends panel by panel across the ranks
+and calls MPI_Testall between its own panel updates, so that rendezvous
+sized panels keep progressing while it computes.
+
+Each receiving rank records, per panel, the time from posting the receive
+to having the data (in flight) and the time it actually waited for it
+(exposed). The final wait for the C sends, and on the root for the C row
+blocks, is timed separately as the drain. REPORT_STATS prints the sum over
+ranks of the three and the hidden fraction 1 - exposed / in flight for
+the last COMPUTE_OP call.
+*/
+
+static double stat_in_flight = 0.0;
+static double stat_exposed = 0.0;
+static double stat_drain = 0.0;
+
+static int num_panels(int rows) { return (rows + PANEL_SIZE - 1) / PANEL_SIZE; }
+
+// C[s:e) += A[s:e, k0:k1) * B[k0:k1, :] respecting the triangle of A
+static void panel_update(int s, int e, int k0, int k1, int n0,
+                         const float *A_local, const float *B, float *C_local) {
+  const float *a[TRMM_MR];
+
+  // Row tiles are aligned to multiples of TRMM_MR (except the first one)
+  for (int i = s; i < e;) {
+    int next = (i / TRMM_MR + 1) * TRMM_MR;
+    if (next > e) next = e;
+    int mr = next - i;
+
+    if (next > k0) {
+      // Rectangular when the whole panel is left of the tile's diagonal,
+      // otherwise the diagonal of the tile lies inside this panel
+      int tri = k1 > i;
+      int kc = tri ? i + mr - k0 : k1 - k0;
+      for (int r = 0; r < mr; r++) {
+        a[r] = A_local + TRMM_PACKED_ROW(i + r) - TRMM_PACKED_ROW(s) + k0;
+      }
+      for (int j = 0; j < n0; j += TRMM_NR) {
+        int nr = n0 - j < TRMM_NR ? n0 - j : TRMM_NR;
+        trmm_ukr(mr, nr, kc, tri, a, B + (size_t)k0 * n0 + j, n0,
+                 C_local + (size_t)(i - s) * n0 + j, n0, 1);
+      }
+    }
+    i = next;
+  }
+}
+
+void COMPUTE_OP(int m0, int n0, float *A, float *B, float *C) {
+  int num_ranks, rid;
+  MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+
+  int s, e;
+  partition_row_block(m0, num_ranks, rid, &s, &e);
+  int panels = num_panels(m0);
+  int my_panels = num_panels(e);
+
+  // Root: panel sends and row block receives for every other rank
+  // Others: panel receives and row block sends
+  int max_requests = rid == 0 ? 2 * panels * num_ranks : 2 * panels;
+  MPI_Request *requests =
+      (MPI_Request *)malloc((max_requests + 1) * sizeof(MPI_Request));
+  double *posted = (double *)malloc((panels + 1) * sizeof(double));
+  int num_requests = 0;
+
+  if (rid == 0) {
+    // panel major, so the first panels of every rank are posted first
+    for (int p = 0; p < panels; p++) {
+      int k0 = p * PANEL_SIZE;
+      int k1 = min(k0 + PANEL_SIZE, m0);
+      for (int r = 1; r < num_ranks; r++) {
+        int r_s, r_e;
+        partition_row_block(m0, num_ranks, r, &r_s, &r_e);
+        if (p >= num_panels(r_e)) continue;
+        trmm_mpi_isend(B + (size_t)k0 * n0, (size_t)(k1 - k0) * n0, MPI_FLOAT,
+                       r, p, MPI_COMM_WORLD, &requests[num_requests++]);
+
+        int lo = r_s > k0 ? r_s : k0;
+        int hi = r_e < k1 ? r_e : k1;
+        if (lo < hi) {
+          trmm_mpi_irecv(C + (size_t)lo * n0, (size_t)(hi - lo) * n0,
+                         MPI_FLOAT, r, panels + p, MPI_COMM_WORLD,
+                         &requests[num_requests++]);
+        }
+      }
+    }
+  } else {
+    for (int p = 0; p < my_panels; p++) {
+      int k0 = p * PANEL_SIZE;
+      int k1 = min(k0 + PANEL_SIZE, m0);
+      posted[p] = MPI_Wtime();
+      trmm_mpi_irecv(B + (size_t)k0 * n0, (size_t)(k1 - k0) * n0, MPI_FLOAT,
+                     0, p, MPI_COMM_WORLD, &requests[p]);
+    }
+    num_requests = my_panels;
+  }
+
+  // The root computes straight into its rows of C
+  float *C_local = rid == 0 ? C + (size_t)s * n0 : C;
+  memset(C_local, 0, (size_t)(e - s) * n0 * sizeof(float));
+
+  double in_flight = 0.0;
+  double exposed = 0.0;
+
+  for (int p = 0; p < my_panels; p++) {
+    int k0 = p * PANEL_SIZE;
+    int k1 = min(k0 + PANEL_SIZE, m0);
+
+    // Wait for panel p while the following ones keep arriving
+    if (rid != 0) {
+      double t0 = MPI_Wtime();
+      MPI_Wait(&requests[p], MPI_STATUS_IGNORE);
+      double t1 = MPI_Wtime();
+      exposed += t1 - t0;
+      in_flight += t1 - posted[p];
+    }
+
+    panel_update(s, e, k0, k1, n0, A, B, C_local);
+
+    // The root makes no other MPI call while it computes, so this is what
+    // moves its panel sends along
+    if (rid == 0) {
+      int done;
+      MPI_Testall(num_requests, requests, &done, MPI_STATUSES_IGNORE);
+    }
+
+    // Rows [lo, hi) just received their last contribution
+    int lo = s > k0 ? s : k0;
+    int hi = e < k1 ? e : k1;
+    if (rid != 0 && lo < hi) {
+      trmm_mpi_isend(C_local + (size_t)(lo - s) * n0, (size_t)(hi - lo) * n0,
+                     MPI_FLOAT, 0, panels + p, MPI_COMM_WORLD,
+                     &requests[num_requests++]);
+    }
+  }
+
+  // Drain outstanding sends (and on the root the row blocks of C)
+  double t0 = MPI_Wtime();
+  MPI_Waitall(num_requests, requests, MPI_STATUSES_IGNORE);
+
+  stat_in_flight = in_flight;
+  stat_exposed = exposed;
+  stat_drain = MPI_Wtime() - t0;
+
+  free(requests);
+  free(posted);
+}
+
+void DISTRIBUTE_ALLOCATION(int m0, int n0, float **A_dist, float **B_dist,
+                           float **C_dist) {
+  int num_ranks, rid;
+  MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+
+  int s, e;
+  partition_row_block(m0, num_ranks, rid, &s, &e);
+
+  // Local rows of A; the root keeps full B and C, the others the panels of
+  // B they need (whole panels, the last one may reach past row e) and their
+  // own rows of C
+  size_t A_size = TRMM_PACKED_ROW(e) - TRMM_PACKED_ROW(s);
+  int B_rows = rid == 0 ? m0 : min(num_panels(e) * PANEL_SIZE, m0);
+  size_t B_size = (size_t)B_rows * n0;
+  size_t C_size = (size_t)(rid == 0 ? m0 : e - s) * n0;
+
+  *A_dist = (float *)trmm_arena_alloc((A_size + 1) * sizeof(float));
+  *B_dist = (float *)trmm_arena_alloc((B_size + 1) * sizeof(float));
+  *C_dist = (float *)trmm_arena_alloc((C_size + 1) * sizeof(float));
+
+  if (*A_dist == NULL || *B_dist == NULL || *C_dist == NULL) {
+    printf("Rank %d: Memory allocation failed\n", rid);
+    MPI_Abort(MPI_COMM_WORLD, 1);
+  }
+}
+
+// inputs from the root to every rank, A either row major or (packed set)
+// in packed storage
+static void distribute_inputs(int m0, int n0, const float *A, int packed,
+                              float *B_seq, float *A_dist, float *B_dist) {
+  int num_ranks, rid;
+  MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+
+  int s, e;
+  partition_row_block(m0, num_ranks, rid, &s, &e);
+
+  // Packed rows of a contiguous row block are contiguous too; point to
+  // point instead of MPI_Scatterv, whose int displacements stop at 2^31
+  const float *A_packed = A;
+  float *A_copy = NULL;
+  MPI_Request *requests = NULL;
+
+  if (rid == 0) {
+    requests = (MPI_Request *)malloc(num_ranks * sizeof(MPI_Request));
+
+    // a row major A is packed first, a packed one is sent as it is
+    if (!packed) {
+      A_copy = (float *)malloc(TRMM_PACKED_SIZE(m0) * sizeof(float));
+      if (A_copy == NULL) {
+        printf("Rank %d: Memory allocation failed\n", rid);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+      }
+      pack_lower_triangular(m0, A, m0, A_copy);
+      A_packed = A_copy;
+    }
+    for (int r = 0; r < num_ranks; r++) {
+      int r_s, r_e;
+      partition_row_block(m0, num_ranks, r, &r_s, &r_e);
+      trmm_mpi_isend(A_packed + TRMM_PACKED_ROW(r_s),
+                     TRMM_PACKED_ROW(r_e) - TRMM_PACKED_ROW(r_s), MPI_FLOAT,
+                     r, 0, MPI_COMM_WORLD, &requests[r]);
+    }
+
+    // B is streamed from the root by COMPUTE_OP
+    memcpy(B_dist, B_seq, (size_t)m0 * n0 * sizeof(float));
+  }
+
+  trmm_mpi_recv(A_dist, TRMM_PACKED_ROW(e) - TRMM_PACKED_ROW(s), MPI_FLOAT, 0,
+                0, MPI_COMM_WORLD);
+
+  if (rid == 0) {
+    MPI_Waitall(num_ranks, requests, MPI_STATUSES_IGNORE);
+    free(A_copy);
+    free(requests);
+  }
+}
+
+void DISTRIBUTE_DATA(int m0, int n0, float *A_seq, float *B_seq, float *C_seq,
+                     float *A_dist, float *B_dist, float *C_dist) {
+  (void)C_seq;
+  (void)C_dist;
+  distribute_inputs(m0, n0, A_seq, 0, B_seq, A_dist, B_dist);
+}
+
+// DISTRIBUTE_DATA with A already in packed storage on the root
+void DISTRIBUTE_PACKED(int m0, int n0, float *A_packed, float *B_seq,
+                       float *C_seq, float *A_dist, float *B_dist,
+                       float *C_dist) {
+  (void)C_seq;
+  (void)C_dist;
+  distribute_inputs(m0, n0, A_packed, 1, B_seq, A_dist, B_dist);
+}
+
+void COLLECTION(int m0, int n0, float *C_seq, float *C_dist) {
+  int rid;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+
+  // Row blocks already arrived on the root during COMPUTE_OP
+  if (rid == 0) {
+    memcpy(C_seq, C_dist, (size_t)m0 * n0 * sizeof(float));
+  }
+}
+
+void FREE_MEMORY(float *A_dist, float *B_dist, float *C_dist) {
+  trmm_arena_free(A_dist);
+  trmm_arena_free(B_dist);
+  trmm_arena_free(C_dist);
+}
+
+void REPORT_STATS(int m0, int n0) {
+  int rid;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+
+  double local[3] = {stat_in_flight, stat_exposed, stat_drain};
+  double total[3];
+  MPI_Reduce(local, total, 3, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+
+  if (rid == 0) {
+    double hidden = total[0] > 0.0 ? 1.0 - total[1] / total[0] : 0.0;
+    if (hidden < 0.0) hidden = 0.0;
+    fprintf(stderr,
+            "pipeline m0=%d n0=%d panel=%d comm_in_flight=%.3f ms "
+            "exposed=%.3f ms hidden=%.1f%% drain=%.3f ms\n",
+            m0, n0, PANEL_SIZE, 1e3 * total[0], 1e3 * total[1],
+            100.0 * hidden, 1e3 * total[2]);
+  }
+}
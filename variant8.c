@@ -0,0 +1,405 @@
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "trmm_arena.h"
+#include "trmm_io.h"
+#include "trmm_kernels.h"
+#include "trmm_mpi.h"
+#include "trmm_packed.h"
+#include "trmm_partition.h"
+
+#ifndef COMPUTE_OP
+#define COMPUTE_OP baseline_compute
+#endif
+
+#ifndef DISTRIBUTE_ALLOCATION
+#define DISTRIBUTE_ALLOCATION baseline_distribute
+#endif
+
+#ifndef DISTRIBUTE_DATA
+#define DISTRIBUTE_DATA baseline_distribute_data
+#endif
+
+#ifndef DISTRIBUTE_PACKED
+#define DISTRIBUTE_PACKED baseline_distribute_packed
+#endif
+
+#ifndef COLLECTION
+#define COLLECTION baseline_collect
+#endif
+
+#ifndef FREE_MEMORY
+#define FREE_MEMORY baseline_free
+#endif
+
+#ifndef DISTRIBUTE_FILE
+#define DISTRIBUTE_FILE baseline_distribute_file
+#endif
+
+#ifndef COLLECTION_FILE
+#define COLLECTION_FILE baseline_collect_file
+#endif
+
+// cache blocking: an MC x KC block of A stays in L2, a KC x NC panel of B
+// in L3 and a KC x TRMM_NR micro-panel of B in L1
+#define MC 96
+#define KC 256
+#define NC 2048
+
+#define min(a, b) (((a) < (b)) ? (a) : (b))
+
+#if MC % TRMM_MR != 0 || NC % TRMM_NR != 0
+#error "MC and NC must be multiples of TRMM_MR and TRMM_NR"
+#endif
+
+/*
+BLIS-style variant with multi-level cache blocking
+
+Rows of C are split in flop-balanced contiguous blocks [s, e); each rank
+receives its rows of A (packed) and the rows of B above e, and sends its
+rows of C back in COLLECTION. The local product runs the five loop BLIS
+nest:
+
+  jc: NC columns of B and C
+    pc: KC rows of B (only k < e is ever needed) -> packed into B_panel
+      ic: MC rows of C, skipped when entirely above the diagonal
+        -> the MC x KC block of A is packed into A_block
+        jr, ir: TRMM_MR x TRMM_NR micro-kernel on the packed panels
+
+Both packed buffers are contiguous, 64-byte aligned and reused for the
+whole loop nest, so the micro-kernel only streams unit-stride memory.
+Elements of A above the diagonal are packed as zeros and every micro-panel
+stops at the diagonal of its last row, so the triangle costs no extra
+flops beyond the padding of the diagonal tiles. With OpenMP the threads of
+a rank pack B_panel together and share the ic blocks, each with its own
+A_block.
+*/
+
+// packing buffers come from the arena, so they are reused across calls
+static float *aligned_buffer(size_t count) {
+  float *buffer = (float *)trmm_arena_alloc((count + 1) * sizeof(float));
+  if (buffer == NULL) {
+    printf("Memory allocation failed\n");
+    MPI_Abort(MPI_COMM_WORLD, 1);
+  }
+  return buffer;
+}
+
+// B[pc:pc+kc, jc:jc+nc] -> micro-panels of TRMM_NR columns, zero padded
+static void pack_B_panel(int kc, int nc, const float *B, int rs_B,
+                         float *B_panel) {
+#pragma omp for
+  for (int jr = 0; jr < nc; jr += TRMM_NR) {
+    int nr = min(TRMM_NR, nc - jr);
+    float *dst = B_panel + jr * kc;
+    for (int k = 0; k < kc; k++) {
+      const float *src = B + (size_t)k * rs_B + jr;
+      int j = 0;
+      for (; j < nr; j++) dst[k * TRMM_NR + j] = src[j];
+      for (; j < TRMM_NR; j++) dst[k * TRMM_NR + j] = 0.0f;
+    }
+  }
+}
+
+// A[ic:ic+mc, pc:pc+kc] -> micro-panels of TRMM_MR rows, zero above the
+// diagonal and below row ic + mc (A_local holds packed rows from row s)
+static void pack_A_block(int ic, int mc, int pc, int kc, int s,
+                         const float *A_local, float *A_block) {
+  for (int ir = 0; ir < mc; ir += TRMM_MR) {
+    float *dst = A_block + ir * kc;
+    for (int r = 0; r < TRMM_MR; r++) {
+      int i = ic + ir + r;
+      const float *a_row =
+          A_local + TRMM_PACKED_ROW(i) - TRMM_PACKED_ROW(s) + pc;
+      // columns pc + k <= i are on or below the diagonal
+      int k_end = ir + r < mc ? min(kc, i - pc + 1) : 0;
+      int k = 0;
+      for (; k < k_end; k++) dst[k * TRMM_MR + r] = a_row[k];
+      for (; k < kc; k++) dst[k * TRMM_MR + r] = 0.0f;
+    }
+  }
+}
+
+// C[s:e) = A[s:e, 0:e) * B[0:e, :] with A in packed rows starting at row s
+static void blis_lower_rows(int s, int e, int n0, const float *A_local,
+                            const float *B, float *C_local) {
+  memset(C_local, 0, (size_t)(e - s) * n0 * sizeof(float));
+  if (s == e) return;
+
+  int nc_max = min(NC, (n0 + TRMM_NR - 1) / TRMM_NR * TRMM_NR);
+  float *B_panel = aligned_buffer((size_t)min(KC, e) * nc_max);
+
+  // one A_block per thread, all carved from a single buffer (MC * KC floats
+  // keep every slice 64-byte aligned)
+  int num_threads = 1;
+#ifdef _OPENMP
+  num_threads = omp_get_max_threads();
+#endif
+  float *A_blocks = aligned_buffer((size_t)num_threads * MC * KC);
+
+#pragma omp parallel
+  {
+    int tid = 0;
+#ifdef _OPENMP
+    tid = omp_get_thread_num();
+#endif
+    float *A_block = A_blocks + (size_t)tid * MC * KC;
+
+    for (int jc = 0; jc < n0; jc += NC) {
+      int nc = min(NC, n0 - jc);
+
+      for (int pc = 0; pc < e; pc += KC) {
+        int kc = min(KC, e - pc);
+
+        pack_B_panel(kc, nc, B + (size_t)pc * n0 + jc, n0, B_panel);
+
+        // rows i < pc only see zeros of A in this panel
+        int ic_first = s;
+        while (ic_first + MC <= pc) ic_first += MC;
+
+#pragma omp for schedule(dynamic)
+        for (int ic = ic_first; ic < e; ic += MC) {
+          int mc = min(MC, e - ic);
+          pack_A_block(ic, mc, pc, kc, s, A_local, A_block);
+
+          for (int jr = 0; jr < nc; jr += TRMM_NR) {
+            int nr = min(TRMM_NR, nc - jr);
+            for (int ir = 0; ir < mc; ir += TRMM_MR) {
+              int mr = min(TRMM_MR, mc - ir);
+              // stop at the diagonal of the last row of the micro-panel
+              int kc_tile = min(kc, ic + ir + mr - pc);
+              if (kc_tile <= 0) continue;
+              trmm_ukr_packed(mr, nr, kc_tile, A_block + ir * kc,
+                              B_panel + jr * kc,
+                              C_local + (size_t)(ic + ir - s) * n0 + jc + jr,
+                              n0);
+            }
+          }
+        }
+      }
+    }
+
+  }
+
+  trmm_arena_free(A_blocks);
+  trmm_arena_free(B_panel);
+}
+
+void COMPUTE_OP(int m0, int n0, float *A, float *B, float *C) {
+  int num_ranks, rid;
+  MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+
+  int s, e;
+  partition_row_block(m0, num_ranks, rid, &s, &e);
+
+  // The root computes straight into its rows of the full C
+  float *C_local = rid == 0 ? C + (size_t)s * n0 : C;
+  blis_lower_rows(s, e, n0, A, B, C_local);
+}
+
+void DISTRIBUTE_ALLOCATION(int m0, int n0, float **A_dist, float **B_dist,
+                           float **C_dist) {
+  int num_ranks, rid;
+  MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+
+  int s, e;
+  partition_row_block(m0, num_ranks, rid, &s, &e);
+
+  // Local rows of A, rows of B above e and local rows of C; the root keeps
+  // full B and C
+  size_t A_size = TRMM_PACKED_ROW(e) - TRMM_PACKED_ROW(s);
+  size_t B_size = (size_t)(rid == 0 ? m0 : e) * n0;
+  size_t C_size = (size_t)(rid == 0 ? m0 : e - s) * n0;
+
+  *A_dist = (float *)trmm_arena_alloc((A_size + 1) * sizeof(float));
+  *B_dist = (float *)trmm_arena_alloc((B_size + 1) * sizeof(float));
+  *C_dist = (float *)trmm_arena_alloc((C_size + 1) * sizeof(float));
+
+  if (*A_dist == NULL || *B_dist == NULL || *C_dist == NULL) {
+    printf("Rank %d: Memory allocation failed\n", rid);
+    MPI_Abort(MPI_COMM_WORLD, 1);
+  }
+}
+
+// inputs from the root to every rank, A either row major or (packed set)
+// in packed storage
+static void distribute_inputs(int m0, int n0, const float *A, int packed,
+                              float *B_seq, float *A_dist, float *B_dist) {
+  int num_ranks, rid;
+  MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+
+  int s, e;
+  partition_row_block(m0, num_ranks, rid, &s, &e);
+
+  // Packed rows of a contiguous row block are contiguous too (sent point
+  // to point: MPI_Scatterv displacements are int)
+  const float *A_packed = A;
+  float *A_copy = NULL;
+  MPI_Request *requests = NULL;
+
+  if (rid == 0) {
+    requests = (MPI_Request *)malloc(2 * num_ranks * sizeof(MPI_Request));
+
+    // a row major A is packed first, a packed one is sent as it is
+    if (!packed) {
+      A_copy = (float *)malloc(TRMM_PACKED_SIZE(m0) * sizeof(float));
+      if (A_copy == NULL) {
+        printf("Rank %d: Memory allocation failed\n", rid);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+      }
+      pack_lower_triangular(m0, A, m0, A_copy);
+      A_packed = A_copy;
+    }
+    for (int r = 0; r < num_ranks; r++) {
+      int r_s, r_e;
+      partition_row_block(m0, num_ranks, r, &r_s, &r_e);
+      trmm_mpi_isend(A_packed + TRMM_PACKED_ROW(r_s),
+                     TRMM_PACKED_ROW(r_e) - TRMM_PACKED_ROW(r_s), MPI_FLOAT,
+                     r, 1, MPI_COMM_WORLD, &requests[num_ranks + r]);
+
+      // Rows 0..r_e of B straight from the input
+      if (r != 0) {
+        trmm_mpi_isend(B_seq, (size_t)r_e * n0, MPI_FLOAT, r, 0,
+                       MPI_COMM_WORLD, &requests[r - 1]);
+      }
+    }
+    requests[num_ranks - 1] = MPI_REQUEST_NULL;
+
+    memcpy(B_dist, B_seq, (size_t)m0 * n0 * sizeof(float));
+  } else {
+    trmm_mpi_recv(B_dist, (size_t)e * n0, MPI_FLOAT, 0, 0, MPI_COMM_WORLD);
+  }
+
+  trmm_mpi_recv(A_dist, TRMM_PACKED_ROW(e) - TRMM_PACKED_ROW(s), MPI_FLOAT, 0,
+                1, MPI_COMM_WORLD);
+
+  if (rid == 0) {
+    MPI_Waitall(2 * num_ranks, requests, MPI_STATUSES_IGNORE);
+    free(A_copy);
+    free(requests);
+  }
+}
+
+void DISTRIBUTE_DATA(int m0, int n0, float *A_seq, float *B_seq, float *C_seq,
+                     float *A_dist, float *B_dist, float *C_dist) {
+  (void)C_seq;
+  (void)C_dist;
+  distribute_inputs(m0, n0, A_seq, 0, B_seq, A_dist, B_dist);
+}
+
+// DISTRIBUTE_DATA with A already in packed storage on the root
+void DISTRIBUTE_PACKED(int m0, int n0, float *A_packed, float *B_seq,
+                       float *C_seq, float *A_dist, float *B_dist,
+                       float *C_dist) {
+  (void)C_seq;
+  (void)C_dist;
+  distribute_inputs(m0, n0, A_packed, 1, B_seq, A_dist, B_dist);
+}
+
+void COLLECTION(int m0, int n0, float *C_seq, float *C_dist) {
+  int num_ranks, rid;
+  MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+
+  int s, e;
+  partition_row_block(m0, num_ranks, rid, &s, &e);
+
+  // Row blocks of C are contiguous in C_seq (received point to point:
+  // MPI_Gatherv displacements are int)
+  MPI_Request *requests = NULL;
+  if (rid == 0) {
+    requests = (MPI_Request *)malloc(num_ranks * sizeof(MPI_Request));
+    for (int r = 0; r < num_ranks; r++) {
+      int r_s, r_e;
+      partition_row_block(m0, num_ranks, r, &r_s, &r_e);
+      trmm_mpi_irecv(C_seq + (size_t)r_s * n0, (size_t)(r_e - r_s) * n0,
+                     MPI_FLOAT, r, 0, MPI_COMM_WORLD, &requests[r]);
+    }
+  }
+
+  float *C_local = rid == 0 ? C_dist + (size_t)s * n0 : C_dist;
+  trmm_mpi_send(C_local, (size_t)(e - s) * n0, MPI_FLOAT, 0, 0,
+                MPI_COMM_WORLD);
+
+  if (rid == 0) {
+    MPI_Waitall(num_ranks, requests, MPI_STATUSES_IGNORE);
+    free(requests);
+  }
+}
+
+void FREE_MEMORY(float *A_dist, float *B_dist, float *C_dist) {
+  trmm_arena_free(A_dist);
+  trmm_arena_free(B_dist);
+  trmm_arena_free(C_dist);
+}
+
+/*
+Inputs straight from matrix files (trmm_io.h): every rank reads its packed
+rows of A and the rows of B above e with MPI_File_read_at_all, and writes
+its rows of C with MPI_File_write_at_all; the contiguous row blocks map to
+contiguous ranges of a packed or row major file. A must be packed, B row
+major.
+*/
+void DISTRIBUTE_FILE(int m0, int n0, const char *A_path, const char *B_path,
+                     float *A_dist, float *B_dist, float *C_dist) {
+  (void)C_dist;
+
+  int num_ranks, rid;
+  MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+
+  int s, e;
+  partition_row_block(m0, num_ranks, rid, &s, &e);
+
+  MPI_File file;
+  trmm_io_header_t header;
+  trmm_io_check(trmm_io_open(MPI_COMM_WORLD, A_path, MPI_MODE_RDONLY,
+                             &header, &file),
+                "open", A_path);
+  if (header.storage != TRMM_IO_PACKED_LOWER || header.rows != m0) {
+    trmm_io_check(-1, "read", A_path);
+  }
+  trmm_io_check(trmm_io_read_rows(file, &header, s, e - s, A_dist), "read",
+                A_path);
+  MPI_File_close(&file);
+
+  trmm_io_check(trmm_io_open(MPI_COMM_WORLD, B_path, MPI_MODE_RDONLY,
+                             &header, &file),
+                "open", B_path);
+  // rows of B are read straight into B_dist, so only full row major will do
+  if (header.storage != TRMM_IO_FULL || header.layout != TRMM_ROW_MAJOR ||
+      header.rows != m0 || header.cols != n0) {
+    trmm_io_check(-1, "read", B_path);
+  }
+  trmm_io_check(trmm_io_read_rows(file, &header, 0, e, B_dist), "read",
+                B_path);
+  MPI_File_close(&file);
+}
+
+void COLLECTION_FILE(int m0, int n0, const char *C_path, float *C_dist) {
+  int num_ranks, rid;
+  MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+
+  int s, e;
+  partition_row_block(m0, num_ranks, rid, &s, &e);
+
+  MPI_File file;
+  trmm_io_header_t header;
+  trmm_io_header_init(&header, m0, n0, TRMM_ROW_MAJOR, TRMM_IO_FULL);
+  trmm_io_check(trmm_io_create(MPI_COMM_WORLD, C_path, &header, &file),
+                "create", C_path);
+  float *C_local = rid == 0 ? C_dist + (size_t)s * n0 : C_dist;
+  trmm_io_check(trmm_io_write_rows(file, &header, s, e - s, C_local),
+                "write", C_path);
+  MPI_File_close(&file);
+}
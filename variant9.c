@@ -0,0 +1,266 @@
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trmm_arena.h"
+#include "trmm_kernels.h"
+#include "trmm_mpi.h"
+#include "trmm_partition.h"
+
+#ifndef COMPUTE_OP
+#define COMPUTE_OP baseline_compute
+#endif
+
+#ifndef DISTRIBUTE_ALLOCATION
+#define DISTRIBUTE_ALLOCATION baseline_distribute
+#endif
+
+#ifndef DISTRIBUTE_DATA
+#define DISTRIBUTE_DATA baseline_distribute_data
+#endif
+
+#ifndef COLLECTION
+#define COLLECTION baseline_collect
+#endif
+
+#ifndef FREE_MEMORY
+#define FREE_MEMORY baseline_free
+#endif
+
+// recursion stops once every dimension fits one kernel call; this is the
+// granularity of the micro-kernel, not a cache blocking parameter
+#define BASE_SIZE 48
+
+// subproblems below this many multiply-adds run on the spawning thread
+#define TASK_MIN_FLOPS (128.0 * 128.0 * 128.0)
+
+#define max(a, b) (((a) > (b)) ? (a) : (b))
+
+/*
+Recursive (cache-oblivious) variant
+
+Rows of C are split in flop-balanced contiguous blocks [s, e), as in
+Variant 8. Each rank receives rows s..e of A (columns 0..e, row major with
+row stride e) and rows 0..e of B, and computes
+
+  C[s:e) = A[s:e, 0:s) * B[0:s)  +  L * B[s:e)
+
+where L = A[s:e, s:e) is lower triangular. The dense part goes through
+rec_gemm, which halves the largest of m, n and k until every dimension is
+at most BASE_SIZE. The triangle goes through rec_trmm, which splits L into
+two half-size triangles and the dense block below them:
+
+  | L11     |   | B1 |     C1 += L11 * B1
+  | L21 L22 | * | B2 |     C2 += L21 * B1 (rec_gemm) + L22 * B2
+
+At some depth every subproblem fits each cache level, so no block size has
+to be tuned per machine. With OpenMP, halves that write disjoint parts of C
+(splits in m or n, and L11 next to the L21/L22 pair) run as tasks.
+*/
+
+// split point of a dimension, rounded to full tiles of the micro-kernel
+static int split_half(int size, int tile) {
+  int half = (size / 2 + tile - 1) / tile * tile;
+  return half < size ? half : size / 2;
+}
+
+// C (m x n) += A (m x k) * B (k x n)
+static void rec_gemm(int m, int n, int k, const float *A, int rs_A,
+                     const float *B, int rs_B, float *C, int rs_C) {
+  if (m == 0 || n == 0 || k == 0) return;
+  if (m <= BASE_SIZE && n <= BASE_SIZE && k <= BASE_SIZE) {
+    trmm_block_acc(m, n, k, 0, A, rs_A, B, rs_B, C, rs_C);
+    return;
+  }
+
+  int spawn = (double)m * n * k >= TASK_MIN_FLOPS;
+  int largest = max(m, max(n, k));
+
+  if (largest == k) {
+    // both halves update the same C: one after the other
+    int k1 = split_half(k, 1);
+    rec_gemm(m, n, k1, A, rs_A, B, rs_B, C, rs_C);
+    rec_gemm(m, n, k - k1, A + k1, rs_A, B + (size_t)k1 * rs_B, rs_B, C,
+             rs_C);
+  } else if (largest == m) {
+    int m1 = split_half(m, TRMM_MR);
+#pragma omp task if (spawn)
+    rec_gemm(m1, n, k, A, rs_A, B, rs_B, C, rs_C);
+    rec_gemm(m - m1, n, k, A + (size_t)m1 * rs_A, rs_A, B, rs_B,
+             C + (size_t)m1 * rs_C, rs_C);
+#pragma omp taskwait
+  } else {
+    int n1 = split_half(n, TRMM_NR);
+#pragma omp task if (spawn)
+    rec_gemm(m, n1, k, A, rs_A, B, rs_B, C, rs_C);
+    rec_gemm(m, n - n1, k, A, rs_A, B + n1, rs_B, C + n1, rs_C);
+#pragma omp taskwait
+  }
+}
+
+// C (m x n) += L (m x m, lower triangular) * B (m x n)
+static void rec_trmm(int m, int n, const float *L, int rs_L, const float *B,
+                     int rs_B, float *C, int rs_C) {
+  if (m == 0 || n == 0) return;
+
+  int spawn = (double)m * m * n / 2 >= TASK_MIN_FLOPS;
+
+  // wide right-hand sides are split first, so B and C tiles stay square
+  if (n > max(m, BASE_SIZE)) {
+    int n1 = split_half(n, TRMM_NR);
+#pragma omp task if (spawn)
+    rec_trmm(m, n1, L, rs_L, B, rs_B, C, rs_C);
+    rec_trmm(m, n - n1, L, rs_L, B + n1, rs_B, C + n1, rs_C);
+#pragma omp taskwait
+    return;
+  }
+
+  if (m <= BASE_SIZE) {
+    trmm_block_acc(m, n, m, 1, L, rs_L, B, rs_B, C, rs_C);
+    return;
+  }
+
+  int m1 = split_half(m, TRMM_MR);
+  const float *L21 = L + (size_t)m1 * rs_L;
+  const float *L22 = L21 + m1;
+  float *C2 = C + (size_t)m1 * rs_C;
+
+  // C1 only depends on L11; C2 on L21 and L22
+#pragma omp task if (spawn)
+  rec_trmm(m1, n, L, rs_L, B, rs_B, C, rs_C);
+  rec_gemm(m - m1, n, m1, L21, rs_L, B, rs_B, C2, rs_C);
+  rec_trmm(m - m1, n, L22, rs_L, B + (size_t)m1 * rs_B, rs_B, C2, rs_C);
+#pragma omp taskwait
+}
+
+void COMPUTE_OP(int m0, int n0, float *A, float *B, float *C) {
+  int num_ranks, rid;
+  MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+
+  int s, e;
+  partition_row_block(m0, num_ranks, rid, &s, &e);
+
+  // The root computes straight into its rows of the full C
+  float *C_local = rid == 0 ? C + (size_t)s * n0 : C;
+  memset(C_local, 0, (size_t)(e - s) * n0 * sizeof(float));
+
+  // A holds rows s..e with row stride e: the dense block starts at column
+  // 0 and the triangle at column s
+#pragma omp parallel
+#pragma omp single
+  {
+    rec_gemm(e - s, n0, s, A, e, B, n0, C_local, n0);
+    rec_trmm(e - s, n0, A + s, e, B + (size_t)s * n0, n0, C_local, n0);
+  }
+}
+
+void DISTRIBUTE_ALLOCATION(int m0, int n0, float **A_dist, float **B_dist,
+                           float **C_dist) {
+  int num_ranks, rid;
+  MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+
+  int s, e;
+  partition_row_block(m0, num_ranks, rid, &s, &e);
+
+  // Rows s..e of A up to column e, rows of B above e and local rows of C;
+  // the root keeps full B and C
+  size_t A_size = (size_t)(e - s) * e;
+  size_t B_size = (size_t)(rid == 0 ? m0 : e) * n0;
+  size_t C_size = (size_t)(rid == 0 ? m0 : e - s) * n0;
+
+  *A_dist = (float *)trmm_arena_alloc((A_size + 1) * sizeof(float));
+  *B_dist = (float *)trmm_arena_alloc((B_size + 1) * sizeof(float));
+  *C_dist = (float *)trmm_arena_alloc((C_size + 1) * sizeof(float));
+
+  if (*A_dist == NULL || *B_dist == NULL || *C_dist == NULL) {
+    printf("Rank %d: Memory allocation failed\n", rid);
+    MPI_Abort(MPI_COMM_WORLD, 1);
+  }
+}
+
+void DISTRIBUTE_DATA(int m0, int n0, float *A_seq, float *B_seq, float *C_seq,
+                     float *A_dist, float *B_dist, float *C_dist) {
+  (void)C_seq;
+  (void)C_dist;
+
+  int num_ranks, rid;
+  MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+
+  int s, e;
+  partition_row_block(m0, num_ranks, rid, &s, &e);
+
+  // Root sends every rank its block of A (a strided vector straight out of
+  // A_seq) and the leading rows of B; it keeps the full B itself
+  MPI_Request *requests = NULL;
+  MPI_Datatype *types = NULL;
+  if (rid == 0) {
+    requests = (MPI_Request *)malloc(2 * num_ranks * sizeof(MPI_Request));
+    types = (MPI_Datatype *)malloc(num_ranks * sizeof(MPI_Datatype));
+    for (int r = 0; r < num_ranks; r++) {
+      int r_s, r_e;
+      partition_row_block(m0, num_ranks, r, &r_s, &r_e);
+      MPI_Type_vector(r_e - r_s, r_e, m0, MPI_FLOAT, &types[r]);
+      MPI_Type_commit(&types[r]);
+      MPI_Isend(A_seq + (size_t)r_s * m0, 1, types[r], r, 0, MPI_COMM_WORLD,
+                &requests[2 * r]);
+      requests[2 * r + 1] = MPI_REQUEST_NULL;
+      if (r != 0) {
+        trmm_mpi_isend(B_seq, (size_t)r_e * n0, MPI_FLOAT, r, 1,
+                       MPI_COMM_WORLD, &requests[2 * r + 1]);
+      }
+    }
+    memcpy(B_dist, B_seq, (size_t)m0 * n0 * sizeof(float));
+  } else {
+    trmm_mpi_recv(B_dist, (size_t)e * n0, MPI_FLOAT, 0, 1, MPI_COMM_WORLD);
+  }
+
+  trmm_mpi_recv(A_dist, (size_t)(e - s) * e, MPI_FLOAT, 0, 0, MPI_COMM_WORLD);
+
+  if (rid == 0) {
+    MPI_Waitall(2 * num_ranks, requests, MPI_STATUSES_IGNORE);
+    for (int r = 0; r < num_ranks; r++) MPI_Type_free(&types[r]);
+    free(requests);
+    free(types);
+  }
+}
+
+void COLLECTION(int m0, int n0, float *C_seq, float *C_dist) {
+  int num_ranks, rid;
+  MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+
+  int s, e;
+  partition_row_block(m0, num_ranks, rid, &s, &e);
+
+  // Row blocks of C are contiguous in C_seq (received point to point:
+  // MPI_Gatherv displacements are int)
+  MPI_Request *requests = NULL;
+  if (rid == 0) {
+    requests = (MPI_Request *)malloc(num_ranks * sizeof(MPI_Request));
+    for (int r = 0; r < num_ranks; r++) {
+      int r_s, r_e;
+      partition_row_block(m0, num_ranks, r, &r_s, &r_e);
+      trmm_mpi_irecv(C_seq + (size_t)r_s * n0, (size_t)(r_e - r_s) * n0,
+                     MPI_FLOAT, r, 0, MPI_COMM_WORLD, &requests[r]);
+    }
+  }
+
+  float *C_local = rid == 0 ? C_dist + (size_t)s * n0 : C_dist;
+  trmm_mpi_send(C_local, (size_t)(e - s) * n0, MPI_FLOAT, 0, 0,
+                MPI_COMM_WORLD);
+
+  if (rid == 0) {
+    MPI_Waitall(num_ranks, requests, MPI_STATUSES_IGNORE);
+    free(requests);
+  }
+}
+
+void FREE_MEMORY(float *A_dist, float *B_dist, float *C_dist) {
+  trmm_arena_free(A_dist);
+  trmm_arena_free(B_dist);
+  trmm_arena_free(C_dist);
+}
@@ -3,6 +3,16 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "trmm_batch.h"
+#include "trmm_io.h"
+#include "trmm_layout.h"
+#include "trmm_packed.h"
 
 // define the error threshold
 #define ERROR_THRESHOLD 1.0e-3
@@ -28,6 +38,13 @@ extern void DISTRIBUTE_DATA_REF(int m0, int n0, float *A_seq, float *B_seq,
                                 float *C_seq, float *A_dist, float *B_dist,
                                 float *C_dist);
 
+// optional: DISTRIBUTE_DATA with A_seq already in packed storage
+// (trmm_packed.h), verified instead of DISTRIBUTE_DATA when defined
+extern void DISTRIBUTE_PACKED_TEST(int m0, int n0, float *A_packed,
+                                   float *B_seq, float *C_seq, float *A_dist,
+                                   float *B_dist, float *C_dist)
+    __attribute__((weak));
+
 extern void COLLECTION_TEST(int m0, int n0, float *C_seq, float *C_dist);
 
 extern void COLLECTION_REF(int m0, int n0, float *C_seq, float *C_dist);
@@ -36,28 +53,105 @@ extern void FREE_MEMORY_TEST(float *A_dist, float *B_dist, float *C_dist);
 
 extern void FREE_MEMORY_REF(float *A_dist, float *B_dist, float *C_dist);
 
+// optional: count problems stored back to back, matrices on the root
+// (verified instead of COMPUTE_OP when TRMM_BATCH is set)
+extern void BATCH_OP_TEST(int count, int m0, int n0, float *A, float *B,
+                          float *C) __attribute__((weak));
+
+// optional: BLAS-style multiply with the full ?trmm parameter set, matrices
+// on the root (verified instead of COMPUTE_OP when TRMM_BLAS is set)
+extern void TRMM_OP_TEST(int layout, int side, int uplo, int trans, int diag,
+                         int m0, int n0, float alpha, float *A, int lda,
+                         float *B, int ldb, float *C, int ldc)
+    __attribute__((weak));
+
+extern void TRMM_OP_REF(int layout, int side, int uplo, int trans, int diag,
+                        int m0, int n0, float alpha, float *A, int lda,
+                        float *B, int ldb, float *C, int ldc)
+    __attribute__((weak));
+
+// optional: C = A * B on the caller's matrices with leading dimensions,
+// matrices on the root (verified instead of COMPUTE_OP when TRMM_LAYOUT is
+// set)
+extern void STRIDED_OP_TEST(int layout, int m0, int n0, float *A, int lda,
+                            float *B, int ldb, float *C, int ldc)
+    __attribute__((weak));
+
+extern void STRIDED_OP_REF(int layout, int m0, int n0, float *A, int lda,
+                           float *B, int ldb, float *C, int ldc)
+    __attribute__((weak));
+
+// optional: B := A * B in place, matrices on the root (verified instead of
+// COMPUTE_OP when TRMM_INPLACE is set, in the layout of TRMM_LAYOUT)
+extern void INPLACE_OP_TEST(int layout, int m0, int n0, float *A, int lda,
+                            float *B, int ldb) __attribute__((weak));
+
+extern void INPLACE_OP_REF(int layout, int m0, int n0, float *A, int lda,
+                           float *B, int ldb) __attribute__((weak));
+
+// optional: unit roundoff of the storage format of the inputs, for variants
+// that round A and B to a narrower type than float (fp32 when absent)
+extern double INPUT_EPSILON_TEST(void) __attribute__((weak));
+
+// optional: inputs straight from matrix files (trmm_io.h), verified instead
+// of DISTRIBUTE_DATA and COLLECTION when TRMM_IO_DIR is set
+extern void DISTRIBUTE_FILE_TEST(int m0, int n0, const char *A_path,
+                                 const char *B_path, float *A_dist,
+                                 float *B_dist, float *C_dist)
+    __attribute__((weak));
+
+extern void COLLECTION_FILE_TEST(int m0, int n0, const char *C_path,
+                                 float *C_dist) __attribute__((weak));
+
+// alpha used by the BLAS-style checks
+#define BLAS_ALPHA 0.5f
+
+// the BLAS-style, strided and in-place checks pass submatrices: every leading
+// dimension is this much larger than the matrix
+#define LD_PAD 3
+
+// parse a TRMM_BLAS case: side (L/R), uplo (L/U), trans (N/T), diag (N/U)
+int parse_blas_case(const char *name, int *side, int *uplo, int *trans,
+                    int *diag) {
+  if (strlen(name) != 4) return -1;
+  const char *letters[4] = {"LR", "LU", "NT", "NU"};
+  int *fields[4] = {side, uplo, trans, diag};
+  for (int f = 0; f < 4; f++) {
+    const char *match = strchr(letters[f], name[f]);
+    if (name[f] == '\0' || match == NULL) return -1;
+    *fields[f] = (int)(match - letters[f]);
+  }
+  return 0;
+}
+
+// largest pairwise difference accepted for inputs stored with unit roundoff
+// eps: the inputs are non-negative, so every product, and therefore every
+// element of C, carries at most 2 * eps relative error from the rounding of
+// A and B (fp32 accumulation adds to ERROR_THRESHOLD only)
+double error_threshold(double eps) { return ERROR_THRESHOLD + 2.0 * eps; }
+
 // fill created memory buffer with random values
-void fill_buffer_with_random_values(float *buffer, int num_elements) {
-  for (int i = 0; i < num_elements; i++) {
+void fill_buffer_with_random_values(float *buffer, size_t num_elements) {
+  for (size_t i = 0; i < num_elements; i++) {
     buffer[i] = (float)rand() / (float)(RAND_MAX);
   }
 }
 
 // fill a memory buffer with a specified value
-void fill_buffer_with_specified_value(float *buffer, int num_elements,
+void fill_buffer_with_specified_value(float *buffer, size_t num_elements,
                                       float value) {
-  for (int i = 0; i < num_elements; i++) {
+  for (size_t i = 0; i < num_elements; i++) {
     buffer[i] = value;
   }
 }
 
 // pick max pairwise difference in the buffers
-float max_pairwise_difference(float *A, float *B, int m, int n, int rs,
-                              int cs) {
+float max_pairwise_difference(float *A, float *B, size_t m, size_t n,
+                              size_t rs, size_t cs) {
   float max_diff = 0.0;
   float res = 0.0;
-  for (int i = 0; i < m; i++) {
-    for (int j = 0; j < n; j++) {
+  for (size_t i = 0; i < m; i++) {
+    for (size_t j = 0; j < n; j++) {
       float diff = fabs(A[i * rs + j * cs] - B[i * rs + j * cs]);
       float sum = fabs(A[i * rs + j * cs]) + fabs(B[i * rs + j * cs]);
 
@@ -82,22 +176,157 @@ int scale_steps(int step, int dim) {
   }
 }
 
+// reference of the batch checks: C = A * B on the root, A lower triangular
+// m0 x m0, B and C m0 x n0, all row major
+void reference_trmm(int m0, int n0, const float *A, const float *B,
+                    float *C) {
+  for (int i = 0; i < m0; i++) {
+    for (int j = 0; j < n0; j++) {
+      float result = 0.0f;
+      for (int k = 0; k <= i; k++) {
+        result += A[(size_t)i * m0 + k] * B[(size_t)k * n0 + j];
+      }
+      C[(size_t)i * n0 + j] = result;
+    }
+  }
+}
+
+// batch mode: count m0 x n0 problems through BATCH_OP_TEST, then count
+// problems of uneven shapes (up to m0 x n0) through trmm_batch; every
+// problem is compared on the root with the reference, and the largest
+// difference of both batches is returned there
+float verify_batch(int count, int m0, int n0, int root_id) {
+  int rid;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+
+  int *rows = (int *)malloc((count + 1) * sizeof(int));
+  int *cols = (int *)malloc((count + 1) * sizeof(int));
+  size_t *a_offsets = (size_t *)malloc((count + 1) * sizeof(size_t));
+  size_t *b_offsets = (size_t *)malloc((count + 1) * sizeof(size_t));
+  float max_diff = 0.0f;
+
+  for (int uneven = 0; uneven < 2; uneven++) {
+    // uneven shapes cover tails of every tile size
+    a_offsets[0] = b_offsets[0] = 0;
+    for (int p = 0; p < count; p++) {
+      rows[p] = uneven && m0 > 0 ? 1 + (p * 7) % m0 : m0;
+      cols[p] = uneven && n0 > 0 ? 1 + (p * 5) % n0 : n0;
+      a_offsets[p + 1] = a_offsets[p] + (size_t)rows[p] * rows[p];
+      b_offsets[p + 1] = b_offsets[p] + (size_t)rows[p] * cols[p];
+    }
+
+    float *A = NULL;
+    float *B = NULL;
+    float *C = NULL;
+    float *C_ref = NULL;
+    const float **As = NULL;
+    const float **Bs = NULL;
+    float **Cs = NULL;
+
+    if (rid == root_id) {
+      A = (float *)malloc((a_offsets[count] + 1) * sizeof(float));
+      B = (float *)malloc((b_offsets[count] + 1) * sizeof(float));
+      C = (float *)calloc(b_offsets[count] + 1, sizeof(float));
+      C_ref = (float *)calloc(b_offsets[count] + 1, sizeof(float));
+      As = (const float **)malloc((count + 1) * sizeof(float *));
+      Bs = (const float **)malloc((count + 1) * sizeof(float *));
+      Cs = (float **)malloc((count + 1) * sizeof(float *));
+      if (A == NULL || B == NULL || C == NULL || C_ref == NULL) {
+        printf("Verifier: batch buffer allocation failed\n");
+        exit(1);
+      }
+      fill_buffer_with_random_values(A, a_offsets[count]);
+      fill_buffer_with_random_values(B, b_offsets[count]);
+      for (int p = 0; p < count; p++) {
+        As[p] = A + a_offsets[p];
+        Bs[p] = B + b_offsets[p];
+        Cs[p] = C + b_offsets[p];
+      }
+    }
+
+    if (uneven) {
+      trmm_batch(count, rows, cols, As, Bs, Cs, MPI_COMM_WORLD);
+    } else {
+      BATCH_OP_TEST(count, m0, n0, A, B, C);
+    }
+
+    if (rid == root_id) {
+      for (int p = 0; p < count; p++) {
+        reference_trmm(rows[p], cols[p], A + a_offsets[p], B + b_offsets[p],
+                       C_ref + b_offsets[p]);
+      }
+      float diff = max_pairwise_difference(C_ref, C, 1, b_offsets[count],
+                                           b_offsets[count], 1);
+      if (diff > max_diff) max_diff = diff;
+    }
+
+    free(A);
+    free(B);
+    free(C);
+    free(C_ref);
+    free(As);
+    free(Bs);
+    free(Cs);
+  }
+
+  free(rows);
+  free(cols);
+  free(a_offsets);
+  free(b_offsets);
+  return max_diff;
+}
+
+// read a whole matrix file into a full row major rows x cols matrix on the
+// root (packed files are expanded with zeros above the diagonal); the other
+// ranks take part in the collective reads with nothing
+void read_matrix_file(const char *path, int root_id, int rows, int cols,
+                      float *M) {
+  int rid;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rid);
+
+  MPI_File file;
+  trmm_io_header_t header;
+  trmm_io_check(trmm_io_open(MPI_COMM_WORLD, path, MPI_MODE_RDONLY, &header,
+                             &file),
+                "open", path);
+  if (header.rows != rows || header.cols != cols) {
+    trmm_io_check(-1, "read", path);
+  }
+  int packed = header.storage == TRMM_IO_PACKED_LOWER;
+  float *buffer = M;
+  if (rid == root_id && packed) {
+    buffer = (float *)malloc(TRMM_PACKED_SIZE(rows) * sizeof(float));
+  }
+  trmm_io_check(
+      trmm_io_read_rows(file, &header, 0, rid == root_id ? rows : 0, buffer),
+      "read", path);
+  MPI_File_close(&file);
+
+  if (rid == root_id && packed) {
+    for (int i = 0; i < rows; i++) {
+      for (int j = 0; j < cols; j++) {
+        M[(size_t)i * cols + j] =
+            j <= i ? buffer[TRMM_PACKED_ROW(i) + j] : 0.0f;
+      }
+    }
+    free(buffer);
+  }
+}
+
 int main(int argc, char *argv[]) {
   int rid;
   int num_ranks;
-  int tag = 0;
   int root_id = 0;
 
-  MPI_Init(&argc, &argv);
+  // threads of a rank only run inside the compute kernels
+  int thread_support;
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &thread_support);
 
   MPI_Comm_rank(MPI_COMM_WORLD, &rid);
   MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
 
   FILE *csv_file;
 
-  int num_trials = 10;
-  int num_runs = 1;
-
   // Parameters for the test
   int min_size;
   int max_size;
@@ -115,7 +344,7 @@ int main(int argc, char *argv[]) {
     input_n0 = 3;
 
     csv_file = stdout;
-  } else if (argc == 5 + 1 || argc == 6 + 1) {
+  } else if (argc == 5 + 1 || argc == 6 + 1 || argc == 7 + 1) {
     min_size = atoi(argv[1]);
     max_size = atoi(argv[2]);
     step_size = atoi(argv[3]);
@@ -126,18 +355,116 @@ int main(int argc, char *argv[]) {
     // print to stdout if no file is specified
     csv_file = stdout;
 
-    // if file specified then use the file
-    if (argc == 6 + 1) {
+    // if file specified then use the file (opened on the root only: a rank
+    // that opens it late would truncate what the root already wrote)
+    if (argc >= 6 + 1 && rid == root_id) {
       csv_file = fopen(argv[6], "w");
-    } else {
-      csv_file = NULL;
+    }
+
+    // threads per rank for the hybrid MPI + OpenMP kernels
+    if (argc == 7 + 1) {
+#ifdef _OPENMP
+      omp_set_num_threads(atoi(argv[7]));
+#endif
     }
   } else {
     printf(
-        "Usage: %s [min_size] [max_size] [step_size] [m0] [n0] [output_file]\n",
+        "Usage: %s [min_size] [max_size] [step_size] [m0] [n0] [output_file] "
+        "[num_threads]\n",
         argv[0]);
     exit(1);
   }
+  // BLAS mode: TRMM_BLAS=<side><uplo><trans><diag>, e.g. RUTN
+  int blas_mode = getenv("TRMM_BLAS") != NULL;
+  int side = 0, uplo = 0, trans = 0, diag = 0;
+  if (blas_mode) {
+    if (parse_blas_case(getenv("TRMM_BLAS"), &side, &uplo, &trans, &diag) !=
+            0 ||
+        TRMM_OP_TEST == NULL || TRMM_OP_REF == NULL) {
+      if (rid == root_id) {
+        printf("Verifier: TRMM_BLAS needs a case like LLNN and a variant "
+               "with a BLAS-style entry\n");
+      }
+      MPI_Finalize();
+      exit(1);
+    }
+  }
+
+  // In-place mode: TRMM_INPLACE=1, B is overwritten with A * B
+  int inplace_mode = getenv("TRMM_INPLACE") != NULL &&
+                     atoi(getenv("TRMM_INPLACE")) != 0 && !blas_mode;
+  if (inplace_mode && (INPLACE_OP_TEST == NULL || INPLACE_OP_REF == NULL)) {
+    if (rid == root_id) {
+      printf("Verifier: TRMM_INPLACE needs a variant with an in-place "
+             "entry\n");
+    }
+    MPI_Finalize();
+    exit(1);
+  }
+
+  // Variants with 16-bit inputs are checked against the error of their
+  // storage format instead of the fp32 one
+  double input_epsilon = INPUT_EPSILON_TEST != NULL ? INPUT_EPSILON_TEST()
+                                                    : 1.0 / 16777216.0;
+  double threshold = error_threshold(input_epsilon);
+
+  // Layout of the BLAS-style or in-place check, or strided mode:
+  // TRMM_LAYOUT=row|col
+  int layout = TRMM_ROW_MAJOR;
+  int strided_mode = 0;
+  if (getenv("TRMM_LAYOUT") != NULL) {
+    layout = trmm_layout_from_env();
+    strided_mode = !blas_mode && !inplace_mode;
+    if (layout < 0 ||
+        (strided_mode && (STRIDED_OP_TEST == NULL || STRIDED_OP_REF == NULL))) {
+      if (rid == root_id) {
+        printf("Verifier: TRMM_LAYOUT needs row or col and a variant with a "
+               "strided entry\n");
+      }
+      MPI_Finalize();
+      exit(1);
+    }
+  }
+
+  // File mode: TRMM_IO_DIR=<dir shared by all ranks>, A (packed) and B are
+  // written to matrix files in parallel, the variant reads its slices and
+  // writes C to a file that the root reads back
+  const char *io_dir = getenv("TRMM_IO_DIR");
+  int io_mode = io_dir != NULL && !blas_mode && !inplace_mode && !strided_mode;
+  if (io_mode &&
+      (DISTRIBUTE_FILE_TEST == NULL || COLLECTION_FILE_TEST == NULL)) {
+    if (rid == root_id) {
+      printf("Verifier: TRMM_IO_DIR needs a variant with a file entry\n");
+    }
+    MPI_Finalize();
+    exit(1);
+  }
+
+  // Batch mode: TRMM_BATCH=<problems per batch>
+  int batch_count = 0;
+  if (getenv("TRMM_BATCH") != NULL && !blas_mode && !inplace_mode &&
+      !strided_mode && !io_mode) {
+    batch_count = atoi(getenv("TRMM_BATCH"));
+  }
+  if (batch_count > 0 && BATCH_OP_TEST == NULL) {
+    if (rid == root_id) {
+      printf("Verifier: TRMM_BATCH needs a variant with a batch entry\n");
+    }
+    MPI_Finalize();
+    exit(1);
+  }
+
+  char io_paths[3][512];
+  if (io_mode) {
+    long pid = (long)getpid();
+    MPI_Bcast(&pid, 1, MPI_LONG, root_id, MPI_COMM_WORLD);
+    const char *names[3] = {"A", "B", "C"};
+    for (int f = 0; f < 3; f++) {
+      snprintf(io_paths[f], sizeof(io_paths[f]), "%s/trmm_io_%ld_%s.bin",
+               io_dir, pid, names[f]);
+    }
+  }
+
   // use the root id to print the header on CSV file (dont want multiple
   // headers)
   if (rid == root_id) {
@@ -150,86 +477,186 @@ int main(int argc, char *argv[]) {
     int n0 = scale_steps(size, input_n0);
 
     // allocate memory for sequential buffers
-    int A_seq_size = m0 * m0;
-    int B_seq_size = m0 * n0;
-    int C_seq_size = m0 * n0;
+    // (A is n0 x n0 when it multiplies B from the right)
+    int k_dim = blas_mode && side == 1 ? n0 : m0;
+    int pad = blas_mode || strided_mode || inplace_mode ? LD_PAD : 0;
+    int lda = k_dim + pad;
+    int ldb = trmm_layout_min_ld(layout, m0, n0) + pad;
+    int ldc = ldb;
+
+    size_t A_seq_size = (size_t)k_dim * lda;
+    size_t B_seq_size = (size_t)(layout == TRMM_COL_MAJOR ? n0 : m0) * ldb;
+    size_t C_seq_size = B_seq_size;
+
+    // sequential buffers live on the root only: every entry point takes
+    // them from, and returns them to, the root
+    float *A_seq = NULL;
+    float *B_seq = NULL;
+    float *C_seq = NULL;
+    float *C_seq_ref = NULL;
 
-    float *A_seq = (float *)malloc(A_seq_size * sizeof(float));
-    float *B_seq = (float *)malloc(B_seq_size * sizeof(float));
-    float *C_seq = (float *)malloc(C_seq_size * sizeof(float));
-
-    // verify memory allocation
-    if (A_seq == NULL || B_seq == NULL || C_seq == NULL) {
-      printf("Sequential Memory buffer allocation failed\n");
-      exit(1);
-    }
-
-    // fill the buffers with random values(only done once with root id rank)
     if (rid == root_id) {
+      A_seq = (float *)malloc(A_seq_size * sizeof(float));
+      B_seq = (float *)malloc(B_seq_size * sizeof(float));
+      C_seq = (float *)malloc(C_seq_size * sizeof(float));
+      C_seq_ref = (float *)malloc(C_seq_size * sizeof(float));
+
+      // verify memory allocation
+      if (A_seq == NULL || B_seq == NULL || C_seq == NULL ||
+          C_seq_ref == NULL) {
+        printf("Sequential Memory buffer allocation failed\n");
+        exit(1);
+      }
+
+      // fill the buffers with random values
       fill_buffer_with_random_values(A_seq, A_seq_size);
       fill_buffer_with_random_values(B_seq, B_seq_size);
       fill_buffer_with_specified_value(C_seq, C_seq_size, 0.0);
+      fill_buffer_with_specified_value(C_seq_ref, C_seq_size, 0.0);
     }
 
-    /*
-     Verifier section for the test
-    */
+    // file mode: the inputs come from the files, and the root reads them
+    // back for the reference
+    if (io_mode) {
+      trmm_io_header_t header;
+      trmm_io_header_init(&header, m0, m0, TRMM_ROW_MAJOR,
+                          TRMM_IO_PACKED_LOWER);
+      trmm_io_check(
+          trmm_io_write_random(MPI_COMM_WORLD, io_paths[0], &header, 1),
+          "write", io_paths[0]);
+      trmm_io_header_init(&header, m0, n0, TRMM_ROW_MAJOR, TRMM_IO_FULL);
+      trmm_io_check(
+          trmm_io_write_random(MPI_COMM_WORLD, io_paths[1], &header, 2),
+          "write", io_paths[1]);
+      read_matrix_file(io_paths[0], root_id, m0, m0, A_seq);
+      read_matrix_file(io_paths[1], root_id, m0, n0, B_seq);
+    }
 
-    // allocate pointers for distributed buffers for verifier
-    float *A_dist_ref;
-    float *B_dist_ref;
-    float *C_dist_ref;
+    float batch_diff = 0.0f;
+    if (batch_count > 0) {
+      batch_diff = verify_batch(batch_count, m0, n0, root_id);
+    } else if (blas_mode) {
+      TRMM_OP_REF(layout, side, uplo, trans, diag, m0, n0, BLAS_ALPHA, A_seq,
+                  lda, B_seq, ldb, C_seq_ref, ldc);
+      TRMM_OP_TEST(layout, side, uplo, trans, diag, m0, n0, BLAS_ALPHA, A_seq,
+                   lda, B_seq, ldb, C_seq, ldc);
+    } else if (inplace_mode) {
+      // both results start from B (padding included)
+      if (rid == root_id) {
+        memcpy(C_seq_ref, B_seq, C_seq_size * sizeof(float));
+        memcpy(C_seq, B_seq, C_seq_size * sizeof(float));
+      }
+      INPLACE_OP_REF(layout, m0, n0, A_seq, lda, C_seq_ref, ldb);
+      INPLACE_OP_TEST(layout, m0, n0, A_seq, lda, C_seq, ldb);
+    } else if (strided_mode) {
+      STRIDED_OP_REF(layout, m0, n0, A_seq, lda, B_seq, ldb, C_seq_ref, ldc);
+      STRIDED_OP_TEST(layout, m0, n0, A_seq, lda, B_seq, ldb, C_seq, ldc);
+    } else {
+      /*
+       Verifier section for the test
+      */
+
+      // allocate pointers for distributed buffers for verifier
+      float *A_dist_ref;
+      float *B_dist_ref;
+      float *C_dist_ref;
+
+      // allocate memory for distributed buffers for verifier
+      DISTRIBUTE_ALLOCATION_REF(m0, n0, &A_dist_ref, &B_dist_ref,
+                                &C_dist_ref);
+
+      // verify memory allocation
+      if (A_dist_ref == NULL || B_dist_ref == NULL || C_dist_ref == NULL) {
+        printf("Verifier: Distributed Memory buffer allocation failed\n");
+        exit(1);
+      }
 
-    // allocate memory for distributed buffers for verifier
-    DISTRIBUTE_ALLOCATION_REF(m0, n0, &A_dist_ref, &B_dist_ref, &C_dist_ref);
+      // distribute data for verifier
+      DISTRIBUTE_DATA_REF(m0, n0, A_seq, B_seq, C_seq, A_dist_ref, B_dist_ref,
+                          C_dist_ref);
 
-    // verify memory allocation
-    if (A_dist_ref == NULL || B_dist_ref == NULL || C_dist_ref == NULL) {
-      printf("Verifier: Distributed Memory buffer allocation failed\n");
-      exit(1);
-    }
+      // compute the reference output
+      COMPUTE_OP_REF(m0, n0, A_dist_ref, B_dist_ref, C_dist_ref);
 
-    // distribute data for verifier
-    DISTRIBUTE_DATA_REF(m0, n0, A_seq, B_seq, C_seq, A_dist_ref, B_dist_ref,
-                        C_dist_ref);
+      // collect the reference output on the root
+      COLLECTION_REF(m0, n0, C_seq_ref, C_dist_ref);
 
-    // compute the reference output
-    COMPUTE_OP_REF(m0, n0, A_dist_ref, B_dist_ref, C_dist_ref);
+      /*
+       Section for operation under verification
+      */
 
-    /*
-     Section for operation under verification
-    */
+      // allocate pointers for distributed buffers
+      float *A_dist_test;
+      float *B_dist_test;
+      float *C_dist_test;
 
-    // allocate pointers for distributed buffers
-    float *A_dist_test;
-    float *B_dist_test;
-    float *C_dist_test;
+      // distribute memory allocation
+      DISTRIBUTE_ALLOCATION_TEST(m0, n0, &A_dist_test, &B_dist_test,
+                                 &C_dist_test);
 
-    // distribute memory allocation
-    DISTRIBUTE_ALLOCATION_TEST(m0, n0, &A_dist_test, &B_dist_test,
-                               &C_dist_test);
+      // verify memory allocation
+      if (A_dist_test == NULL || B_dist_test == NULL || C_dist_test == NULL) {
+        printf("Distributed Memory buffer allocation failed\n");
+        exit(1);
+      }
 
-    // verify memory allocation
-    if (A_dist_test == NULL || B_dist_test == NULL || C_dist_test == NULL) {
-      printf("Distributed Memory buffer allocation failed\n");
-      exit(1);
-    }
+      // distribute data (each rank reads its own slices in file mode)
+      if (io_mode) {
+        DISTRIBUTE_FILE_TEST(m0, n0, io_paths[0], io_paths[1], A_dist_test,
+                             B_dist_test, C_dist_test);
+      } else if (DISTRIBUTE_PACKED_TEST != NULL) {
+        // the variant takes A packed (the reference above keeps the full A)
+        float *A_packed = NULL;
+        if (rid == root_id) {
+          A_packed = (float *)malloc(TRMM_PACKED_SIZE(m0) * sizeof(float));
+          if (A_packed == NULL) {
+            printf("Sequential Memory buffer allocation failed\n");
+            exit(1);
+          }
+          pack_lower_triangular(m0, A_seq, m0, A_packed);
+        }
+        DISTRIBUTE_PACKED_TEST(m0, n0, A_packed, B_seq, C_seq, A_dist_test,
+                               B_dist_test, C_dist_test);
+        free(A_packed);
+      } else {
+        DISTRIBUTE_DATA_TEST(m0, n0, A_seq, B_seq, C_seq, A_dist_test,
+                             B_dist_test, C_dist_test);
+      }
 
-    // distribute data
-    DISTRIBUTE_DATA_TEST(m0, n0, A_seq, B_seq, C_seq, A_dist_test, B_dist_test,
-                         C_dist_test);
+      // compute the test output
+      COMPUTE_OP_TEST(m0, n0, A_dist_test, B_dist_test, C_dist_test);
+
+      // collect the test output on the root (variants may keep C distributed)
+      if (io_mode) {
+        COLLECTION_FILE_TEST(m0, n0, io_paths[2], C_dist_test);
+        read_matrix_file(io_paths[2], root_id, m0, n0, C_seq);
+        MPI_Barrier(MPI_COMM_WORLD);
+        if (rid == root_id) {
+          for (int f = 0; f < 3; f++) {
+            MPI_File_delete(io_paths[f], MPI_INFO_NULL);
+          }
+        }
+      } else {
+        COLLECTION_TEST(m0, n0, C_seq, C_dist_test);
+      }
 
-    // compute the test output
-    COMPUTE_OP_TEST(m0, n0, A_dist_test, B_dist_test, C_dist_test);
+      // free the memory allocated for the buffers
+      FREE_MEMORY_TEST(A_dist_test, B_dist_test, C_dist_test);
+      FREE_MEMORY_REF(A_dist_ref, B_dist_ref, C_dist_ref);
+    }
 
     if (root_id == rid) {
-      // verify the results
+      // verify the results (the whole storage of C, so that writes into the
+      // padding of a submatrix fail as well)
       float max_diff =
-          max_pairwise_difference(C_dist_ref, C_dist_test, m0, n0, m0, 1);
+          batch_count > 0
+              ? batch_diff
+              : max_pairwise_difference(C_seq_ref, C_seq, 1, C_seq_size,
+                                        C_seq_size, 1);
 
       // print the results to the CSV file
       if (csv_file != NULL) {
-        if (max_diff > ERROR_THRESHOLD) {
+        if (max_diff > threshold) {
           fprintf(csv_file, "%d,%d,%d,FAIL\n", num_ranks, m0, n0);
         } else {
           fprintf(csv_file, "%d,%d,%d,PASS\n", num_ranks, m0, n0);
@@ -237,19 +664,17 @@ int main(int argc, char *argv[]) {
       }
     }
 
-    // free the memory allocated for the buffers
-    FREE_MEMORY_TEST(A_dist_test, B_dist_test, C_dist_test);
-    FREE_MEMORY_REF(A_dist_ref, B_dist_ref, C_dist_ref);
-
     // free the memory allocated for the sequential buffers
     free(A_seq);
     free(B_seq);
     free(C_seq);
+    free(C_seq_ref);
 
     // set the pointers to NULL to avoid dangling pointers
     A_seq = NULL;
     B_seq = NULL;
     C_seq = NULL;
+    C_seq_ref = NULL;
   }
 
   // close the file if opened